@@ -0,0 +1,79 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "Bench.h"
+
+#include "fmt/format.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+
+/** Allocations made through the global operator new, for reporting allocations/op */
+static size_t _allocations = 0;
+
+void *operator new(size_t size) {
+	_allocations++;
+	if (void *ptr = malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+	free(ptr);
+}
+
+namespace slib {
+namespace bench {
+
+/** Minimum measured run time for a result to be reported */
+static const double MIN_TIME_NS = 2e8;
+
+std::vector<Benchmark>& Registry::benchmarks() {
+	static std::vector<Benchmark> benchmarks;
+	return benchmarks;
+}
+
+int Registry::add(const char *name, BenchmarkFunction function) {
+	benchmarks().push_back({name, function});
+	return 0;
+}
+
+static double run(BenchmarkFunction function, size_t iterations, size_t &allocations) {
+	State state(iterations);
+	size_t startAllocations = _allocations;
+	auto start = std::chrono::steady_clock::now();
+	function(state);
+	auto end = std::chrono::steady_clock::now();
+	allocations = _allocations - startAllocations;
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+int Registry::runAll(const char *filter) {
+	fmt::print("{:<48} {:>12} {:>12} {:>10}\n", "Benchmark", "Iterations", "ns/op", "allocs/op");
+	for (Benchmark const& b : benchmarks()) {
+		if (filter && !strstr(b._name, filter))
+			continue;
+
+		size_t iterations = 1;
+		size_t allocations;
+		double elapsed = run(b._function, iterations, allocations);
+		while (elapsed < MIN_TIME_NS) {
+			// aim for 1.2 x MIN_TIME_NS, growing by at most 100x per round
+			double scale = (elapsed > 0) ? (MIN_TIME_NS * 1.2 / elapsed) : 100;
+			if (scale > 100)
+				scale = 100;
+			iterations = (size_t)((double)iterations * scale) + 1;
+			elapsed = run(b._function, iterations, allocations);
+		}
+
+		fmt::print("{:<48} {:>12} {:>12.2f} {:>10.2f}\n", b._name, iterations, elapsed / (double)iterations,
+				   (double)allocations / (double)iterations);
+	}
+	return 0;
+}
+
+} // namespace bench
+} // namespace slib
@@ -0,0 +1,65 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_BENCH_BENCH_H
+#define H_SLIB_BENCH_BENCH_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace slib {
+namespace bench {
+
+/** Iteration control passed to benchmark functions */
+class State {
+private:
+	size_t _iterations;
+	size_t _remaining;
+public:
+	State(size_t iterations)
+	:_iterations(iterations)
+	,_remaining(iterations) {}
+
+	bool keepRunning() {
+		if (_remaining == 0)
+			return false;
+		_remaining--;
+		return true;
+	}
+
+	size_t iterations() const {
+		return _iterations;
+	}
+};
+
+typedef void (*BenchmarkFunction)(State &state);
+
+struct Benchmark {
+	const char *_name;
+	BenchmarkFunction _function;
+};
+
+class Registry {
+private:
+	static std::vector<Benchmark>& benchmarks();
+public:
+	static int add(const char *name, BenchmarkFunction function);
+
+	/** Runs all benchmarks whose name contains the filter (if not null) */
+	static int runAll(const char *filter);
+};
+
+/** Prevents the compiler from optimizing away the computation of a value */
+template <class T>
+inline void doNotOptimize(T const& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace bench
+} // namespace slib
+
+#define BENCHMARK(fn) \
+	static int _benchmark_##fn = slib::bench::Registry::add(#fn, fn)
+
+#endif // H_SLIB_BENCH_BENCH_H
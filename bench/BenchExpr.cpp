@@ -0,0 +1,143 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "Bench.h"
+
+#include "slib/collections/ArrayList.h"
+#include "slib/collections/HashMap.h"
+#include "slib/util/expr/ExpressionEvaluator.h"
+#include "slib/util/expr/ExpressionFormatter.h"
+#include "slib/util/expr/Function.h"
+
+using namespace slib;
+using namespace slib::expr;
+using namespace slib::bench;
+
+/** Variables of a typical request-routing rule set */
+static SPtr<Map<String, Object>> newVars() {
+	SPtr<Map<String, Object>> vars = std::make_shared<HashMap<String, Object>>();
+	vars->emplace<Integer>("status", 404);
+	vars->emplace<String>("method", "GET");
+	vars->emplace<String>("host", "www.example.com");
+	vars->emplace<Integer>("size", 1200);
+	vars->emplace<Double>("latency", 12.5);
+	SPtr<ArrayList<Object>> tags = std::make_shared<ArrayList<Object>>();
+	tags->emplace<String>("edge");
+	tags->emplace<String>("cached");
+	tags->emplace<String>("eu-west");
+	vars->put("tags", std::dynamic_pointer_cast<Object>(tags));
+	return vars;
+}
+
+static Resolver const& resolver() {
+	static MapResolver resolver(newVars());
+	return resolver;
+}
+
+static void expressionValue(State &state, const char *expr) {
+	SPtr<String> text = std::make_shared<String>(expr);
+	while (state.keepRunning())
+		doNotOptimize(ExpressionEvaluator::expressionValue(text, resolver()));
+}
+
+static void BM_ExpressionValue_Arithmetic(State &state) {
+	expressionValue(state, "size * 8 / (latency + 1) - status % 100");
+}
+BENCHMARK(BM_ExpressionValue_Arithmetic);
+
+static void BM_ExpressionValue_Compare(State &state) {
+	expressionValue(state, "(status >= 400) & (method == 'GET') | (host == 'localhost')");
+}
+BENCHMARK(BM_ExpressionValue_Compare);
+
+static void BM_ExpressionValue_Call(State &state) {
+	expressionValue(state, "math.ceil(size / 7) + math.abs(latency - 20)");
+}
+BENCHMARK(BM_ExpressionValue_Call);
+
+static void BM_ExpressionValue_Index(State &state) {
+	expressionValue(state, "tags[1] + ':' + tags[2]");
+}
+BENCHMARK(BM_ExpressionValue_Index);
+
+/**
+ * Texts evaluated only once (such as most config values), which are interpreted instead of
+ * compiled. Includes building each distinct text.
+ */
+static void BM_ExpressionValue_FirstSeen(State &state) {
+	static uint64_t serial = 0;
+	while (state.keepRunning()) {
+		SPtr<String> text = std::make_shared<String>(fmt::format("size * 8 / (latency + 1) - status % {}", ++serial + 100).c_str());
+		doNotOptimize(ExpressionEvaluator::expressionValue(text, resolver()));
+	}
+}
+BENCHMARK(BM_ExpressionValue_FirstSeen);
+
+/** Interpreter only, as used for expressions that fail to compile */
+static void BM_ExpressionValue_Interpreted(State &state) {
+	SPtr<String> text = std::make_shared<String>("size * 8 / (latency + 1) - status % 100");
+	while (state.keepRunning())
+		doNotOptimize(ExpressionEvaluator::expressionValue(std::make_shared<ExpressionInputStream>(text), resolver()));
+}
+BENCHMARK(BM_ExpressionValue_Interpreted);
+
+static void BM_If(State &state) {
+	expressionValue(state, "if(status >= 500, 'error', if(status >= 400, 'client', 'ok'))");
+}
+BENCHMARK(BM_If);
+
+static void BM_For_Classic(State &state) {
+	expressionValue(state, "for('i', 0, i < 20, i + 1, i * 2)");
+}
+BENCHMARK(BM_For_Classic);
+
+static void BM_For_Collection(State &state) {
+	expressionValue(state, "for('t', tags, t + ',')");
+}
+BENCHMARK(BM_For_Collection);
+
+static void BM_Interpolate(State &state) {
+	String pattern("${method} http://${host}/status/${status} (${size} bytes, ${latency} ms)");
+	while (state.keepRunning())
+		doNotOptimize(ExpressionEvaluator::interpolate(pattern, resolver(), false));
+}
+BENCHMARK(BM_Interpolate);
+
+static void BM_SmartInterpolate_Single(State &state) {
+	String pattern("${size * 2}");
+	while (state.keepRunning())
+		doNotOptimize(ExpressionEvaluator::smartInterpolate(pattern, resolver(), false));
+}
+BENCHMARK(BM_SmartInterpolate_Single);
+
+static void BM_SmartInterpolate_Mixed(State &state) {
+	String pattern("${method}:${status}");
+	while (state.keepRunning())
+		doNotOptimize(ExpressionEvaluator::smartInterpolate(pattern, resolver(), false));
+}
+BENCHMARK(BM_SmartInterpolate_Mixed);
+
+static void BM_Format(State &state) {
+	SPtr<Function> function = Function::impl<>([](Resolver const& /* resolver */, ArgList const& /* args */) {
+		return Value::Nil();
+	});
+	FunctionArgs args(function, std::make_shared<String>("format"));
+	args.add(std::make_shared<String>("%s %s -> %d (%.2f ms, %x)"));
+	args.add(std::make_shared<String>("GET"));
+	args.add(std::make_shared<String>("www.example.com"));
+	args.add(std::make_shared<Integer>(404));
+	args.add(std::make_shared<Double>(12.5));
+	args.add(std::make_shared<Integer>(1200));
+	while (state.keepRunning()) {
+		StringBuilder out;
+		ExpressionFormatter::format(out, args, resolver());
+		doNotOptimize(out.length());
+	}
+}
+BENCHMARK(BM_Format);
+
+static void BM_Format_Builtin(State &state) {
+	expressionValue(state, "format('%s %s -> %d', method, host, status)");
+}
+BENCHMARK(BM_Format_Builtin);
@@ -0,0 +1,9 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "Bench.h"
+
+int main(int argc, char **argv) {
+	return slib::bench::Registry::runAll(argc > 1 ? argv[1] : nullptr);
+}
@@ -0,0 +1,166 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "Bench.h"
+
+#include "slib/lang/ASCII.h"
+#include "slib/lang/String.h"
+#include "slib/lang/StringBuilder.h"
+#include "slib/lang/ChunkedStringBuilder.h"
+
+#include <strings.h>
+#include <ctype.h>
+
+using namespace slib;
+using namespace slib::bench;
+
+static const char *_shortKey = "Content-Type";
+static const char *_shortKeyUpper = "CONTENT-TYPE";
+static const char *_longKey = "X-Forwarded-For-Original-Client-Address-Header-Name";
+static const char *_longKeyUpper = "X-FORWARDED-FOR-ORIGINAL-CLIENT-ADDRESS-HEADER-NAME";
+
+// Table-driven loops previously used by ASCIICaseInsensitiveString and BasicString, as baseline
+
+struct LowerTable {
+	unsigned char _table[256];
+
+	LowerTable() {
+		for (int i = 0; i < 256; i++)
+			_table[i] = (unsigned char)((i >= 'A' && i <= 'Z') ? i + ('a' - 'A') : i);
+	}
+};
+
+static const LowerTable _toLower;
+
+static int32_t tableHash(const char *str, size_t len) {
+	int h = 0;
+	for (size_t i = 0; i < len; i++)
+		h = 31 * h + _toLower._table[(unsigned char)str[i]];
+	return h;
+}
+
+static void tableToLower(char *dst, const char *src, size_t len) {
+	for (size_t i = 0; i < len; i++)
+		dst[i] = (char)tolower(src[i]);
+}
+
+static void BM_HashIgnoreCaseShort_Table(State &state) {
+	size_t len = strlen(_shortKey);
+	while (state.keepRunning())
+		doNotOptimize(tableHash(_shortKey, len));
+}
+BENCHMARK(BM_HashIgnoreCaseShort_Table);
+
+static void BM_HashIgnoreCaseShort_ASCII(State &state) {
+	size_t len = strlen(_shortKey);
+	while (state.keepRunning())
+		doNotOptimize(ASCII::hashCodeIgnoreCase(_shortKey, len));
+}
+BENCHMARK(BM_HashIgnoreCaseShort_ASCII);
+
+static void BM_HashIgnoreCaseLong_Table(State &state) {
+	size_t len = strlen(_longKey);
+	while (state.keepRunning())
+		doNotOptimize(tableHash(_longKey, len));
+}
+BENCHMARK(BM_HashIgnoreCaseLong_Table);
+
+static void BM_HashIgnoreCaseLong_ASCII(State &state) {
+	size_t len = strlen(_longKey);
+	while (state.keepRunning())
+		doNotOptimize(ASCII::hashCodeIgnoreCase(_longKey, len));
+}
+BENCHMARK(BM_HashIgnoreCaseLong_ASCII);
+
+static void BM_EqualsIgnoreCaseShort_strcasecmp(State &state) {
+	while (state.keepRunning())
+		doNotOptimize(strcasecmp(_shortKey, _shortKeyUpper));
+}
+BENCHMARK(BM_EqualsIgnoreCaseShort_strcasecmp);
+
+static void BM_EqualsIgnoreCaseShort_ASCII(State &state) {
+	size_t len = strlen(_shortKey);
+	while (state.keepRunning())
+		doNotOptimize(ASCII::equalsIgnoreCase(_shortKey, _shortKeyUpper, len));
+}
+BENCHMARK(BM_EqualsIgnoreCaseShort_ASCII);
+
+static void BM_EqualsIgnoreCaseLong_strcasecmp(State &state) {
+	while (state.keepRunning())
+		doNotOptimize(strcasecmp(_longKey, _longKeyUpper));
+}
+BENCHMARK(BM_EqualsIgnoreCaseLong_strcasecmp);
+
+static void BM_EqualsIgnoreCaseLong_ASCII(State &state) {
+	size_t len = strlen(_longKey);
+	while (state.keepRunning())
+		doNotOptimize(ASCII::equalsIgnoreCase(_longKey, _longKeyUpper, len));
+}
+BENCHMARK(BM_EqualsIgnoreCaseLong_ASCII);
+
+static void BM_ToLowerCase4K_Table(State &state) {
+	std::string src(4096, 'X');
+	std::string dst(4096, ' ');
+	while (state.keepRunning()) {
+		tableToLower(&dst[0], src.c_str(), src.length());
+		doNotOptimize(dst[0]);
+	}
+}
+BENCHMARK(BM_ToLowerCase4K_Table);
+
+static void BM_ToLowerCase4K_ASCII(State &state) {
+	std::string src(4096, 'X');
+	std::string dst(4096, ' ');
+	while (state.keepRunning()) {
+		ASCII::toLowerCase(&dst[0], src.c_str(), src.length());
+		doNotOptimize(dst[0]);
+	}
+}
+BENCHMARK(BM_ToLowerCase4K_ASCII);
+
+static void BM_CaseInsensitiveStringHash(State &state) {
+	while (state.keepRunning()) {
+		ASCIICaseInsensitiveString key(_longKey);
+		doNotOptimize(key.hashCode());
+	}
+}
+BENCHMARK(BM_CaseInsensitiveStringHash);
+
+// Large outputs: 16 MiB built from 64-byte lines
+
+static const size_t _LARGE_LINES = 256 * 1024;
+static const char *_line = "key.name.with.some.depth = some moderately long value string\n";
+
+static void BM_LargeOutput_StringBuilder(State &state) {
+	size_t len = strlen(_line);
+	while (state.keepRunning()) {
+		StringBuilder sb;
+		for (size_t i = 0; i < _LARGE_LINES; i++)
+			sb.add(_line, (std::ptrdiff_t)len);
+		doNotOptimize(sb.length());
+	}
+}
+BENCHMARK(BM_LargeOutput_StringBuilder);
+
+static void BM_LargeOutput_Chunked(State &state) {
+	size_t len = strlen(_line);
+	while (state.keepRunning()) {
+		ChunkedStringBuilder sb;
+		for (size_t i = 0; i < _LARGE_LINES; i++)
+			sb.add(_line, (std::ptrdiff_t)len);
+		doNotOptimize(sb.length());
+	}
+}
+BENCHMARK(BM_LargeOutput_Chunked);
+
+static void BM_LargeOutput_ChunkedFlatten(State &state) {
+	size_t len = strlen(_line);
+	while (state.keepRunning()) {
+		ChunkedStringBuilder sb;
+		for (size_t i = 0; i < _LARGE_LINES; i++)
+			sb.add(_line, (std::ptrdiff_t)len);
+		doNotOptimize(sb.toString()->length());
+	}
+}
+BENCHMARK(BM_LargeOutput_ChunkedFlatten);
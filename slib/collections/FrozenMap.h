@@ -0,0 +1,262 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_COLLECTIONS_FROZENMAP_H
+#define H_SLIB_COLLECTIONS_FROZENMAP_H
+
+#include "slib/collections/Map.h"
+#include "slib/exception/UnsupportedOperationException.h"
+#include "slib/lang/StringView.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace slib {
+
+/**
+ * Immutable map, built once from another map and laid out as a perfect hash table: each
+ * lookup hashes the key once (for Strings, the cached hash code), multiplies, and compares
+ * a single entry. Keys with equal hash codes, which no perfect hash can separate, share a
+ * slot and are compared in turn. Being immutable, a FrozenMap can be read concurrently
+ * without synchronization; all modifying methods throw UnsupportedOperationException.
+ */
+template <class K, class V, class Pred = std::equal_to<K>>
+class FrozenMap : public Map<K, V, Pred> {
+public:
+	class Entry : public Map<K, V, Pred>::Entry {
+	friend class FrozenMap;
+	private:
+		K _key;
+		SPtr<V> _value;
+		size_t _hash;
+		/** next entry with the same slot, or -1 */
+		int32_t _next;
+	public:
+		Entry(K const& key, SPtr<V> const& value, size_t hash)
+		:_key(key)
+		,_value(value)
+		,_hash(hash)
+		,_next(-1) {}
+
+		virtual const K& getKey() const override {
+			return _key;
+		}
+
+		virtual const SPtr<V> getValue() const override {
+			return _value;
+		}
+
+		/** @return the value, without copying the pointer */
+		SPtr<V> const& value() const {
+			return _value;
+		}
+	};
+private:
+	class ConstEntryIterator : public ConstIterator<typename Map<K, V, Pred>::Entry>::ConstIteratorImpl {
+	private:
+		std::vector<Entry> const& _entries;
+		size_t _index;
+	public:
+		ConstEntryIterator(std::vector<Entry> const& entries, size_t index)
+		:_entries(entries)
+		,_index(index) {}
+
+		virtual bool hasNext() override {
+			return _index < _entries.size();
+		}
+
+		virtual const typename Map<K, V, Pred>::Entry& next() override {
+			if (_index >= _entries.size())
+				throw NoSuchElementException(_HERE_);
+			return _entries[_index++];
+		}
+
+		virtual typename ConstIterator<typename Map<K, V, Pred>::Entry>::ConstIteratorImpl *clone() override {
+			return new ConstEntryIterator(_entries, _index);
+		}
+	};
+
+	/** entries, in the iteration order of the source map */
+	std::vector<Entry> _entries;
+	/** first entry of each slot, or -1 */
+	std::vector<int32_t> _table;
+	uint64_t _multiplier;
+	unsigned _shift;
+
+	size_t slotOf(size_t hash) const {
+		return (size_t)(((uint64_t)hash * _multiplier) >> _shift);
+	}
+
+	/**
+	 * Tries a multiplier for a table of 2^<i>bits</i> slots
+	 * @return <i>true</i> if entries with different hash codes all land in different slots
+	 */
+	bool tryLayout(unsigned bits, uint64_t multiplier) {
+		_multiplier = multiplier;
+		_shift = 64 - bits;
+		_table.assign((size_t)1 << bits, -1);
+		for (size_t i = 0; i < _entries.size(); i++) {
+			Entry &entry = _entries[i];
+			int32_t &first = _table[slotOf(entry._hash)];
+			if ((first >= 0) && (_entries[first]._hash != entry._hash))
+				return false;
+			entry._next = first;
+			first = (int32_t)i;
+		}
+		return true;
+	}
+
+	void layout() {
+		if (_entries.empty())
+			return;
+
+		unsigned bits = 1;
+		while (((size_t)1 << bits) < _entries.size())
+			bits++;
+
+		// odd multipliers from a fixed sequence, so the layout is the same on every run;
+		// small tables are tried first, up to 8 slots per entry
+		uint64_t state = 0x9E3779B97F4A7C15ULL;
+		for (unsigned extra = 0; extra <= 3; extra++) {
+			for (int attempt = 0; attempt < 256; attempt++) {
+				state += 0x9E3779B97F4A7C15ULL;
+				uint64_t z = state;
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+				if (tryLayout(bits + extra, (z ^ (z >> 31)) | 1))
+					return;
+			}
+		}
+
+		// no perfect layout found; colliding entries are chained
+		_table.assign((size_t)1 << (bits + 3), -1);
+		for (size_t i = 0; i < _entries.size(); i++) {
+			int32_t &first = _table[slotOf(_entries[i]._hash)];
+			_entries[i]._next = first;
+			first = (int32_t)i;
+		}
+	}
+public:
+	/** Freezes the current contents of a map */
+	FrozenMap(Map<K, V, Pred> const& source)
+	:_multiplier(1)
+	,_shift(63) {
+		_entries.reserve(source.size());
+		ConstIterator<typename Map<K, V, Pred>::Entry> i = source.constIterator();
+		while (i.hasNext()) {
+			typename Map<K, V, Pred>::Entry const& entry = i.next();
+			_entries.emplace_back(entry.getKey(), entry.getValue(), std::hash<K>()(entry.getKey()));
+		}
+		layout();
+	}
+
+	FrozenMap(std::initializer_list<std::pair<K, SPtr<V>>> args)
+	:_multiplier(1)
+	,_shift(63) {
+		_entries.reserve(args.size());
+		for (auto const& arg : args)
+			_entries.emplace_back(arg.first, arg.second, std::hash<K>()(arg.first));
+		layout();
+	}
+
+	virtual ~FrozenMap() override {}
+
+	static constexpr Class _class = FROZENMAPCLASS;
+
+	virtual Class const& getClass() const override {
+		return FROZENMAPCLASS;
+	}
+
+	/**
+	 * Looks up an entry without copying the value pointer
+	 * @return the entry, or <code>nullptr</code> if the key is not mapped
+	 */
+	Entry const* find(K const& key) const {
+		if (_entries.empty())
+			return nullptr;
+		size_t hash = std::hash<K>()(key);
+		Pred eq;
+		for (int32_t i = _table[slotOf(hash)]; i >= 0; i = _entries[i]._next) {
+			Entry const& entry = _entries[i];
+			if ((entry._hash == hash) && eq(entry._key, key))
+				return &entry;
+		}
+		return nullptr;
+	}
+
+	/**
+	 * Looks up a String key given as a hashed literal, without hashing it or
+	 * constructing a temporary String
+	 * @return the entry, or <code>nullptr</code> if the key is not mapped
+	 */
+	Entry const* find(HashedStringView const& key) const {
+		if (_entries.empty())
+			return nullptr;
+		size_t hash = (size_t)key.hashCode();
+		for (int32_t i = _table[slotOf(hash)]; i >= 0; i = _entries[i]._next) {
+			Entry const& entry = _entries[i];
+			if ((entry._hash == hash) && key.equals(entry._key))
+				return &entry;
+		}
+		return nullptr;
+	}
+
+	virtual SPtr<V> get(K const& key) const override {
+		Entry const* entry = find(key);
+		return entry ? entry->_value : nullptr;
+	}
+
+	SPtr<V> get(HashedStringView const& key) const {
+		Entry const* entry = find(key);
+		return entry ? entry->_value : nullptr;
+	}
+
+	virtual const typename Map<K, V, Pred>::Entry *getEntry(K const& key) const override {
+		return find(key);
+	}
+
+	virtual bool containsKey(K const& key) const override {
+		return find(key) != nullptr;
+	}
+
+	virtual size_t size() const override {
+		return _entries.size();
+	}
+
+	virtual bool isEmpty() const override {
+		return _entries.empty();
+	}
+
+	/** @return number of slots in the hash table */
+	size_t tableSize() const {
+		return _table.size();
+	}
+
+	virtual ConstIterator<typename Map<K, V, Pred>::Entry> constIterator() const override {
+		return ConstIterator<typename Map<K, V, Pred>::Entry>(new ConstEntryIterator(_entries, 0));
+	}
+
+	/** @throws UnsupportedOperationException */
+	virtual SPtr<V> put(K const& /* key */, SPtr<V> const& /* value */) override {
+		throw UnsupportedOperationException(_HERE_, "FrozenMap::put()");
+	}
+
+	/** @throws UnsupportedOperationException */
+	virtual SPtr<V> remove(K const& /* key */) override {
+		throw UnsupportedOperationException(_HERE_, "FrozenMap::remove()");
+	}
+
+	/** @throws UnsupportedOperationException */
+	virtual void clear() override {
+		throw UnsupportedOperationException(_HERE_, "FrozenMap::clear()");
+	}
+};
+
+template <class K, class V, class Pred>
+constexpr Class FrozenMap<K, V, Pred>::_class;
+
+} // namespace slib
+
+#endif // H_SLIB_COLLECTIONS_FROZENMAP_H
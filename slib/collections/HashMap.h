@@ -9,6 +9,7 @@
 
 #include "slib/collections/Map.h"
 #include "slib/lang/Numeric.h"
+#include "slib/lang/StringView.h"
 #include "slib/exception/IllegalStateException.h"
 
 #include <inttypes.h>
@@ -311,6 +312,19 @@ public:
 		return nullptr;
 	}
 
+	/**
+	 * Same as get(const K&) for a String key given as a hashed literal, without
+	 * hashing it or constructing a temporary String
+	 */
+	SPtr<V> get(HashedStringView const& key) const {
+		int32_t hash = _smudge(sizeTHash((size_t)key.hashCode()));
+		for (Entry *e = _table[indexFor(hash, _tableLength)]; e != nullptr; e = e->_next) {
+			if ((e->_keyHash == hash) && key.equals(e->_key))
+				return e->_value;
+		}
+		return nullptr;
+	}
+
 	const typename Map<K, V>::Entry *getEntry(const K& key) const {
 		int32_t hash = _smudge(sizeTHash(std::hash<K>()(key)));
 		Pred eq;
@@ -572,6 +586,14 @@ public:
 		return _internalMap->get(key);
 	}
 
+	/**
+	 * Same as get(const K&) for a String key given as a hashed literal, without
+	 * hashing it or constructing a temporary String
+	 */
+	SPtr<V> get(HashedStringView const& key) const {
+		return _internalMap->get(key);
+	}
+
 	virtual const typename Map<K, V>::Entry *getEntry(const K& key) const override {
 		return _internalMap->getEntry(key);
 	}
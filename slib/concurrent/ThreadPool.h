@@ -0,0 +1,104 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_CONCURRENT_THREADPOOL_H
+#define H_SLIB_CONCURRENT_THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace slib {
+
+/**
+ * Fixed set of worker threads running submitted tasks, in submission order. Tasks may
+ * submit further tasks. Tasks must not throw: exceptions have to be caught and passed
+ * on by the task itself.
+ */
+class ThreadPool {
+private:
+	std::mutex _lock;
+	std::condition_variable _work;
+	std::condition_variable _done;
+	std::deque<std::function<void()>> _tasks;
+	/** tasks submitted and not finished yet */
+	size_t _pending;
+	bool _stopping;
+	std::vector<std::thread> _threads;
+
+	void work() {
+		std::unique_lock<std::mutex> lock(_lock);
+		while (true) {
+			_work.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+			if (_tasks.empty())
+				return;
+			std::function<void()> task = std::move(_tasks.front());
+			_tasks.pop_front();
+			lock.unlock();
+			task();
+			lock.lock();
+			if (--_pending == 0)
+				_done.notify_all();
+		}
+	}
+
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_stopping = true;
+		}
+		_work.notify_all();
+		for (std::thread &thread : _threads)
+			thread.join();
+		_threads.clear();
+	}
+public:
+	/** @throws std::system_error if a thread cannot be started */
+	ThreadPool(size_t threads)
+	:_pending(0)
+	,_stopping(false) {
+		_threads.reserve(threads);
+		try {
+			for (size_t i = 0; i < threads; i++)
+				_threads.emplace_back(&ThreadPool::work, this);
+		} catch (...) {
+			stop();
+			throw;
+		}
+	}
+
+	/** Runs the tasks still queued, then stops the threads */
+	~ThreadPool() {
+		stop();
+	}
+
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+	size_t size() const {
+		return _threads.size();
+	}
+
+	void submit(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_tasks.push_back(std::move(task));
+			_pending++;
+		}
+		_work.notify_one();
+	}
+
+	/** Waits until all submitted tasks, including those submitted meanwhile by other tasks, have run */
+	void wait() {
+		std::unique_lock<std::mutex> lock(_lock);
+		_done.wait(lock, [this] { return _pending == 0; });
+	}
+};
+
+} // namespace slib
+
+#endif // H_SLIB_CONCURRENT_THREADPOOL_H
@@ -1,6 +1,11 @@
 #include "slib/io/FileOutputStream.h"
 #include "slib/util/StringUtils.h"
 
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
 namespace slib {
 
 FileOutputStream::FileOutputStream(const std::string &fileName, bool append /* = false */) {
@@ -22,6 +27,41 @@ void FileOutputStream::write(unsigned char *buffer, size_t length) {
 		throw IOException(_HERE_, fmt::format("File I/O error, errno='{}'", StringUtils::formatErrno()).c_str());
 }
 
+void FileOutputStream::writev(struct iovec const* iov, int iovcnt) {
+	if (!_f)
+		throw IOException(_HERE_, "Stream closed");
+	// anything already buffered by stdio must go out first
+	if (fflush(_f) != 0)
+		throw IOException(_HERE_, fmt::format("File I/O error, errno='{}'", StringUtils::formatErrno()).c_str());
+
+	int fd = fileno(_f);
+	struct iovec local[IOV_MAX];
+	while (iovcnt > 0) {
+		int n = (iovcnt > IOV_MAX) ? IOV_MAX : iovcnt;
+		memcpy(local, iov, n * sizeof(struct iovec));
+		int first = 0;
+		while (first < n) {
+			ssize_t nWritten = ::writev(fd, local + first, n - first);
+			if (nWritten < 0) {
+				if (errno == EINTR)
+					continue;
+				throw IOException(_HERE_, fmt::format("File I/O error, errno='{}'", StringUtils::formatErrno()).c_str());
+			}
+			// skip fully written buffers, adjust a partially written one
+			while (first < n && (size_t)nWritten >= local[first].iov_len) {
+				nWritten -= local[first].iov_len;
+				first++;
+			}
+			if (first < n) {
+				local[first].iov_base = (char *)local[first].iov_base + nWritten;
+				local[first].iov_len -= nWritten;
+			}
+		}
+		iov += n;
+		iovcnt -= n;
+	}
+}
+
 void FileOutputStream::close() {
 	if (_f)
 		fclose(_f);
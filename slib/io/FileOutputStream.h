@@ -13,6 +13,7 @@ public:
 	virtual ~FileOutputStream();
 
 	virtual void write(unsigned char *buffer, size_t length) override;
+	virtual void writev(struct iovec const* iov, int iovcnt) override;
 	virtual void close() override;
 };
 
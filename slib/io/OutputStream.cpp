@@ -4,4 +4,9 @@ namespace slib {
 
 OutputStream::~OutputStream() {}
 
+void OutputStream::writev(struct iovec const* iov, int iovcnt) {
+	for (int i = 0; i < iovcnt; i++)
+		write((unsigned char *)iov[i].iov_base, iov[i].iov_len);
+}
+
 } // namespace slib
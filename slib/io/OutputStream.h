@@ -3,6 +3,8 @@
 
 #include "slib/io/IO.h"
 
+#include <sys/uio.h>
+
 namespace slib {
 
 class OutputStream {
@@ -10,6 +12,14 @@ public:
 	virtual ~OutputStream();
 
 	virtual void write(unsigned char *buffer, size_t length) = 0;
+
+	/**
+	 * Gathering write: writes <i>iovcnt</i> buffers, in order. The default implementation
+	 * calls write() for each buffer; streams backed by a file descriptor can do better.
+	 * @throws IOException
+	 */
+	virtual void writev(struct iovec const* iov, int iovcnt);
+
 	virtual void close() = 0;
 };
 
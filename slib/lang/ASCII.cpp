@@ -0,0 +1,277 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "slib/lang/ASCII.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace slib {
+
+const uint8_t ASCII::SPACE;
+const uint8_t ASCII::DIGIT;
+const uint8_t ASCII::ALPHA;
+const uint8_t ASCII::WORD;
+
+namespace {
+const uint8_t S = ASCII::SPACE;
+const uint8_t D = ASCII::DIGIT | ASCII::WORD;
+const uint8_t A = ASCII::ALPHA | ASCII::WORD;
+const uint8_t W = ASCII::WORD;
+}
+
+const uint8_t ASCII::CLASSES[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0,		// 0x00
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,		// 0x10
+	S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,		// 0x20 ' '
+	D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,		// 0x30 '0'-'9'
+	0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,		// 0x40 'A'-'O'
+	A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, W,		// 0x50 'P'-'Z', '_'
+	0, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,		// 0x60 'a'-'o'
+	A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0		// 0x70 'p'-'z'
+	// non-ASCII: none
+};
+
+/** Length of the run of characters of the given classes, one character at a time */
+static inline size_t spanTail(const char *str, size_t len, uint8_t classes) {
+	size_t i = 0;
+	while ((i < len) && (ASCII::CLASSES[(unsigned char)str[i]] & classes))
+		i++;
+	return i;
+}
+
+/** Lower-cases the ASCII letters in 8 bytes at once */
+static inline uint64_t foldLower8(uint64_t v) {
+	const uint64_t heptets = v & 0x7F7F7F7F7F7F7F7FULL;
+	const uint64_t geA = heptets + 0x3F3F3F3F3F3F3F3FULL;	// high bit set if >= 'A'
+	const uint64_t gtZ = heptets + 0x2525252525252525ULL;	// high bit set if > 'Z'
+	const uint64_t isUpper = (geA ^ gtZ) & ~v & 0x8080808080808080ULL;
+	return v | (isUpper >> 2);
+}
+
+static inline bool equalsIgnoreCase8(const char *a, const char *b) {
+	uint64_t va, vb;
+	memcpy(&va, a, 8);
+	memcpy(&vb, b, 8);
+	return foldLower8(va) == foldLower8(vb);
+}
+
+static inline bool equalsIgnoreCase4(const char *a, const char *b) {
+	uint32_t va, vb;
+	memcpy(&va, a, 4);
+	memcpy(&vb, b, 4);
+	return foldLower8(va) == foldLower8(vb);
+}
+
+/**
+ * Compares up to 16 bytes ignoring case, with two (possibly overlapping) loads
+ * covering the first and last 8 or 4 bytes instead of a byte-by-byte tail
+ */
+static inline bool equalsIgnoreCaseTail(const char *a, const char *b, size_t len) {
+	if (len >= 8)
+		return equalsIgnoreCase8(a, b) && equalsIgnoreCase8(a + len - 8, b + len - 8);
+	if (len >= 4)
+		return equalsIgnoreCase4(a, b) && equalsIgnoreCase4(a + len - 4, b + len - 4);
+	for (size_t i = 0; i < len; i++) {
+		if (ASCII::toLowerCase(a[i]) != ASCII::toLowerCase(b[i]))
+			return false;
+	}
+	return true;
+}
+
+/** Hashes characters 4 at a time, to shorten the multiply dependency chain */
+static inline uint32_t hashIgnoreCaseTail(uint32_t h, const char *str, size_t len) {
+	size_t i = 0;
+	for (; i + 4 <= len; i += 4) {
+		h = h * 923521 +	// 31^4
+			(unsigned char)ASCII::toLowerCase(str[i]) * 29791U +
+			(unsigned char)ASCII::toLowerCase(str[i + 1]) * 961U +
+			(unsigned char)ASCII::toLowerCase(str[i + 2]) * 31U +
+			(unsigned char)ASCII::toLowerCase(str[i + 3]);
+	}
+	for (; i < len; i++)
+		h = 31 * h + (unsigned char)ASCII::toLowerCase(str[i]);
+	return h;
+}
+
+#ifdef __SSE2__
+
+/**
+ * Selects the bytes of v that lie in [first, first + n). The range check is done
+ * with a single signed compare by biasing the bytes so that <code>first</code>
+ * maps to -128.
+ */
+static inline __m128i inRange(__m128i v, char first, char n) {
+	__m128i biased = _mm_sub_epi8(v, _mm_set1_epi8((char)(first + 128)));
+	return _mm_cmplt_epi8(biased, _mm_set1_epi8((char)(-128 + n)));
+}
+
+/** Adds <code>delta</code> to the bytes of v that lie in [first, first + 26) */
+static inline __m128i foldRange(__m128i v, char first, char delta) {
+	return _mm_add_epi8(v, _mm_and_si128(inRange(v, first, 26), _mm_set1_epi8(delta)));
+}
+
+static inline __m128i foldLower(__m128i v) {
+	return foldRange(v, 'A', 'a' - 'A');
+}
+
+static void convert(char *dst, const char *src, size_t len, char first, char delta) {
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dst + i), foldRange(v, first, delta));
+	}
+	for (; i < len; i++) {
+		char ch = src[i];
+		dst[i] = ((unsigned char)(ch - first) < 26) ? (char)(ch + delta) : ch;
+	}
+}
+
+void ASCII::toLowerCase(char *dst, const char *src, size_t len) {
+	convert(dst, src, len, 'A', 'a' - 'A');
+}
+
+void ASCII::toUpperCase(char *dst, const char *src, size_t len) {
+	convert(dst, src, len, 'a', 'A' - 'a');
+}
+
+static inline bool equalsIgnoreCase16(const char *a, const char *b) {
+	__m128i va = foldLower(_mm_loadu_si128((const __m128i *)a));
+	__m128i vb = foldLower(_mm_loadu_si128((const __m128i *)b));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) == 0xFFFF;
+}
+
+bool ASCII::equalsIgnoreCase(const char *a, const char *b, size_t len) {
+	if (len <= 16)
+		return equalsIgnoreCaseTail(a, b, len);
+	for (size_t i = 0; i + 16 < len; i += 16) {
+		if (!equalsIgnoreCase16(a + i, b + i))
+			return false;
+	}
+	// the last 16 bytes, overlapping the blocks already compared
+	return equalsIgnoreCase16(a + len - 16, b + len - 16);
+}
+
+// 31^(15 - i) mod 2^32, split into 16-bit halves
+static const uint16_t _powLo[16] __attribute__((aligned(16))) = {
+	0xdddf, 0x6a41, 0xc99f, 0x0681, 0xa55f, 0xb2c1, 0x711f, 0x6f01,
+	0x2cdf, 0x3b41, 0xd89f, 0x1781, 0x745f, 0x03c1, 0x001f, 0x0001
+};
+static const uint16_t _powHi[16] __attribute__((aligned(16))) = {
+	0xe191, 0x59db, 0xe1dd, 0xee83, 0x07b1, 0x94e4, 0xf449, 0x9444,
+	0x67e1, 0x34e6, 0x01b4, 0x000e, 0x0000, 0x0000, 0x0000, 0x0000
+};
+static const uint32_t _pow31x16 = 0x50a9de01;	// 31^16 mod 2^32
+static const uint32_t _pow31x8 = 0x94446f01;	// 31^8 mod 2^32
+
+/** Sum of c[i] * p[i] mod 2^32 over 8 16-bit lanes, as 4 32-bit partial sums */
+static inline __m128i dot8(__m128i c, __m128i pLo, __m128i pHi) {
+	// c * p = c * pLo + ((c * pHi) << 16), with 16x16->32 products assembled from halves
+	__m128i lo = _mm_mullo_epi16(c, pLo);
+	__m128i hi = _mm_add_epi16(_mm_mulhi_epu16(c, pLo), _mm_mullo_epi16(c, pHi));
+	return _mm_add_epi32(_mm_unpacklo_epi16(lo, hi), _mm_unpackhi_epi16(lo, hi));
+}
+
+static inline uint32_t horizontalSum(__m128i v) {
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (uint32_t)_mm_cvtsi128_si32(v);
+}
+
+static inline __m128i spaces(__m128i v) {
+	return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), inRange(v, '\t', 5));
+}
+
+static inline __m128i wordChars(__m128i v) {
+	// setting bit 5 maps upper to lower case letters, and no other byte to a letter
+	__m128i letters = inRange(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 26);
+	return _mm_or_si128(_mm_or_si128(letters, inRange(v, '0', 10)), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+}
+
+/** Length of the run of characters selected by <code>select</code> (of the given classes) */
+template <__m128i (*select)(__m128i)>
+static size_t span(const char *str, size_t len, uint8_t classes) {
+	size_t i = 0;
+	for (; i + 16 <= len; i += 16) {
+		unsigned mask = (unsigned)_mm_movemask_epi8(select(_mm_loadu_si128((const __m128i *)(str + i))));
+		if (mask != 0xFFFF)
+			return i + (size_t)__builtin_ctz(~mask);
+	}
+	return i + spanTail(str + i, len - i, classes);
+}
+
+size_t ASCII::spanSpaces(const char *str, size_t len) {
+	return span<spaces>(str, len, SPACE);
+}
+
+size_t ASCII::spanWordChars(const char *str, size_t len) {
+	return span<wordChars>(str, len, WORD);
+}
+
+int32_t ASCII::hashCodeIgnoreCase(const char *str, size_t len) {
+	uint32_t h = 0;
+	size_t i = 0;
+	if (len >= 8) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i pLo0 = _mm_load_si128((const __m128i *)_powLo);
+		const __m128i pLo1 = _mm_load_si128((const __m128i *)(_powLo + 8));
+		const __m128i pHi0 = _mm_load_si128((const __m128i *)_powHi);
+		const __m128i pHi1 = _mm_load_si128((const __m128i *)(_powHi + 8));
+		for (; i + 16 <= len; i += 16) {
+			__m128i v = foldLower(_mm_loadu_si128((const __m128i *)(str + i)));
+			__m128i sum = _mm_add_epi32(dot8(_mm_unpacklo_epi8(v, zero), pLo0, pHi0),
+										dot8(_mm_unpackhi_epi8(v, zero), pLo1, pHi1));
+			h = h * _pow31x16 + horizontalSum(sum);
+		}
+		if (i + 8 <= len) {
+			// the last 8 powers are 31^7 ... 31^0
+			__m128i v = foldLower(_mm_loadl_epi64((const __m128i *)(str + i)));
+			h = h * _pow31x8 + horizontalSum(dot8(_mm_unpacklo_epi8(v, zero), pLo1, pHi1));
+			i += 8;
+		}
+	}
+	return (int32_t)hashIgnoreCaseTail(h, str + i, len - i);
+}
+
+#else // !__SSE2__
+
+void ASCII::toLowerCase(char *dst, const char *src, size_t len) {
+	for (size_t i = 0; i < len; i++)
+		dst[i] = toLowerCase(src[i]);
+}
+
+void ASCII::toUpperCase(char *dst, const char *src, size_t len) {
+	for (size_t i = 0; i < len; i++)
+		dst[i] = toUpperCase(src[i]);
+}
+
+bool ASCII::equalsIgnoreCase(const char *a, const char *b, size_t len) {
+	if (len <= 16)
+		return equalsIgnoreCaseTail(a, b, len);
+	for (size_t i = 0; i + 8 < len; i += 8) {
+		if (!equalsIgnoreCase8(a + i, b + i))
+			return false;
+	}
+	// the last 8 bytes, overlapping the blocks already compared
+	return equalsIgnoreCase8(a + len - 8, b + len - 8);
+}
+
+size_t ASCII::spanSpaces(const char *str, size_t len) {
+	return spanTail(str, len, SPACE);
+}
+
+size_t ASCII::spanWordChars(const char *str, size_t len) {
+	return spanTail(str, len, WORD);
+}
+
+int32_t ASCII::hashCodeIgnoreCase(const char *str, size_t len) {
+	return (int32_t)hashIgnoreCaseTail(0, str, len);
+}
+
+#endif // __SSE2__
+
+} // namespace slib
@@ -0,0 +1,88 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_LANG_ASCII_H
+#define H_SLIB_LANG_ASCII_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace slib {
+
+/**
+ * ASCII classification and case folding kernels. Only 'A'-'Z' and 'a'-'z' are
+ * letters (and folded), all other bytes (including non-ASCII) are left unchanged,
+ * independent of the current locale. Uses SSE2 where available, with a scalar
+ * (SWAR or lookup table) fallback.
+ */
+class ASCII {
+public:
+	// character classes (flags of CLASSES)
+	static const uint8_t SPACE = 0x01;	///< ' ', '\t', '\n', '\v', '\f', '\r' (as std::isspace() in the "C" locale)
+	static const uint8_t DIGIT = 0x02;
+	static const uint8_t ALPHA = 0x04;
+	static const uint8_t WORD = 0x08;	///< letters, digits and '_'
+
+	/** classes of each (unsigned) character */
+	static const uint8_t CLASSES[256];
+
+	static bool isSpace(char ch) {
+		return (CLASSES[(unsigned char)ch] & SPACE) != 0;
+	}
+
+	static bool isDigit(char ch) {
+		return (CLASSES[(unsigned char)ch] & DIGIT) != 0;
+	}
+
+	static bool isAlpha(char ch) {
+		return (CLASSES[(unsigned char)ch] & ALPHA) != 0;
+	}
+
+	static bool isAlnum(char ch) {
+		return (CLASSES[(unsigned char)ch] & (ALPHA | DIGIT)) != 0;
+	}
+
+	static bool isWordChar(char ch) {
+		return (CLASSES[(unsigned char)ch] & WORD) != 0;
+	}
+
+	/** @return the number of leading whitespace characters (see isSpace()) */
+	static size_t spanSpaces(const char *str, size_t len);
+
+	/** @return the number of leading letters, digits and '_' (see isWordChar()) */
+	static size_t spanWordChars(const char *str, size_t len);
+
+	static char toLowerCase(char ch) {
+		return ((unsigned char)(ch - 'A') < 26) ? (char)(ch + ('a' - 'A')) : ch;
+	}
+
+	static char toUpperCase(char ch) {
+		return ((unsigned char)(ch - 'a') < 26) ? (char)(ch - ('a' - 'A')) : ch;
+	}
+
+	/**
+	 * Converts <code>len</code> characters to lower case. <code>dst</code> may
+	 * be the same as <code>src</code> for in-place conversion.
+	 */
+	static void toLowerCase(char *dst, const char *src, size_t len);
+
+	/**
+	 * Converts <code>len</code> characters to upper case. <code>dst</code> may
+	 * be the same as <code>src</code> for in-place conversion.
+	 */
+	static void toUpperCase(char *dst, const char *src, size_t len);
+
+	/** Compares <code>len</code> characters, ignoring case */
+	static bool equalsIgnoreCase(const char *a, const char *b, size_t len);
+
+	/**
+	 * Case-insensitive hash code, same as String::hashCode() computed over the
+	 * lower case (unsigned) characters
+	 */
+	static int32_t hashCodeIgnoreCase(const char *str, size_t len);
+};
+
+} // namespace slib
+
+#endif // H_SLIB_LANG_ASCII_H
@@ -0,0 +1,189 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "slib/lang/ChunkedStringBuilder.h"
+#include "slib/lang/Numeric.h"
+
+#include <sys/uio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace slib {
+
+/** Maximum number of chunks handed to a single gathering write */
+static const int _MAX_IOV = 64;
+
+ChunkedStringBuilder::ChunkedStringBuilder(size_t chunkSize /* = DEFAULT_CHUNK_SIZE */)
+:_head(nullptr)
+,_tail(nullptr)
+,_len(0)
+,_numChunks(0)
+,_chunkSize(chunkSize > 0 ? chunkSize : DEFAULT_CHUNK_SIZE) {}
+
+ChunkedStringBuilder::ChunkedStringBuilder(ChunkedStringBuilder &&other)
+:_head(other._head)
+,_tail(other._tail)
+,_len(other._len)
+,_numChunks(other._numChunks)
+,_chunkSize(other._chunkSize) {
+	other._head = other._tail = nullptr;
+	other._len = other._numChunks = 0;
+}
+
+ChunkedStringBuilder& ChunkedStringBuilder::operator=(ChunkedStringBuilder &&other) {
+	if (this != &other) {
+		freeChunks();
+		_head = other._head;
+		_tail = other._tail;
+		_len = other._len;
+		_numChunks = other._numChunks;
+		_chunkSize = other._chunkSize;
+		other._head = other._tail = nullptr;
+		other._len = other._numChunks = 0;
+	}
+	return *this;
+}
+
+ChunkedStringBuilder::~ChunkedStringBuilder() {
+	freeChunks();
+}
+
+ChunkedStringBuilder::Chunk *ChunkedStringBuilder::newChunk(size_t size) {
+	Chunk *chunk = (Chunk *)malloc(offsetof(Chunk, _data) + size);
+	if (!chunk)
+		throw OutOfMemoryError(_HERE_);
+	chunk->_next = nullptr;
+	chunk->_len = 0;
+	chunk->_size = size;
+	return chunk;
+}
+
+void ChunkedStringBuilder::appendChunk(Chunk *chunk) {
+	if (_tail)
+		_tail->_next = chunk;
+	else
+		_head = chunk;
+	_tail = chunk;
+	_numChunks++;
+}
+
+void ChunkedStringBuilder::freeChunks() {
+	Chunk *chunk = _head;
+	while (chunk) {
+		Chunk *next = chunk->_next;
+		free(chunk);
+		chunk = next;
+	}
+	_head = _tail = nullptr;
+	_numChunks = 0;
+}
+
+/**
+ * Returns a pointer to <i>len</i> contiguous writable bytes at the end of the
+ * content, starting a new chunk if the current one is too full. Does not update
+ * the length.
+ */
+char *ChunkedStringBuilder::reserve(size_t len) {
+	if (!_tail || _tail->_size - _tail->_len < len)
+		appendChunk(newChunk(len > _chunkSize ? len : _chunkSize));
+	char *ptr = _tail->_data + _tail->_len;
+	_tail->_len += len;
+	return ptr;
+}
+
+ChunkedStringBuilder& ChunkedStringBuilder::clear() {
+	freeChunks();
+	_len = 0;
+	return *this;
+}
+
+ChunkedStringBuilder& ChunkedStringBuilder::add(const char *src, std::ptrdiff_t len /* = -1 */) {
+	if (!src)
+		return add("null", 4);
+	size_t remaining = (len < 0) ? strlen(src) : (size_t)len;
+	_len += remaining;
+
+	// fill up the current chunk first
+	if (_tail) {
+		size_t n = _tail->_size - _tail->_len;
+		if (n > remaining)
+			n = remaining;
+		memcpy(_tail->_data + _tail->_len, src, n);
+		_tail->_len += n;
+		src += n;
+		remaining -= n;
+	}
+	// the rest goes to a single new chunk, sized to fit if larger than usual
+	if (remaining > 0)
+		memcpy(reserve(remaining), src, remaining);
+
+	return *this;
+}
+
+ChunkedStringBuilder& ChunkedStringBuilder::add(BasicString const& src) {
+	return add(src.c_str(), (std::ptrdiff_t)src.length());
+}
+
+ChunkedStringBuilder& ChunkedStringBuilder::add(std::string const& src) {
+	return add(src.c_str(), (std::ptrdiff_t)src.length());
+}
+
+ChunkedStringBuilder& ChunkedStringBuilder::add(int i) {
+	char buffer[Number::MAX_CHARS];
+	return add(buffer, (std::ptrdiff_t)Integer::toChars(i, buffer));
+}
+
+ChunkedStringBuilder& ChunkedStringBuilder::add(int64_t i) {
+	char buffer[Number::MAX_CHARS];
+	return add(buffer, (std::ptrdiff_t)Long::toChars(i, buffer));
+}
+
+ChunkedStringBuilder& ChunkedStringBuilder::add(double d) {
+	char buffer[Number::MAX_CHARS];
+	return add(buffer, (std::ptrdiff_t)Double::toChars(d, buffer));
+}
+
+ChunkedStringBuilder& ChunkedStringBuilder::add(ChunkedStringBuilder &&other) {
+	if (this == &other || !other._head)
+		return *this;
+
+	if (_tail)
+		_tail->_next = other._head;
+	else
+		_head = other._head;
+	_tail = other._tail;
+	_len += other._len;
+	_numChunks += other._numChunks;
+
+	other._head = other._tail = nullptr;
+	other._len = other._numChunks = 0;
+	return *this;
+}
+
+void ChunkedStringBuilder::writeTo(OutputStream &out) const {
+	struct iovec iov[_MAX_IOV];
+	int n = 0;
+	for (Chunk *chunk = _head; chunk; chunk = chunk->_next) {
+		if (chunk->_len == 0)
+			continue;
+		iov[n].iov_base = chunk->_data;
+		iov[n].iov_len = chunk->_len;
+		if (++n == _MAX_IOV) {
+			out.writev(iov, n);
+			n = 0;
+		}
+	}
+	if (n > 0)
+		out.writev(iov, n);
+}
+
+UPtr<String> ChunkedStringBuilder::toString() const {
+	std::string str;
+	str.reserve(_len);
+	for (Chunk *chunk = _head; chunk; chunk = chunk->_next)
+		str.append(chunk->_data, chunk->_len);
+	return std::make_unique<String>(std::move(str));
+}
+
+} // namespace slib
@@ -0,0 +1,142 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_LANG_CHUNKEDSTRINGBUILDER_H
+#define H_SLIB_LANG_CHUNKEDSTRINGBUILDER_H
+
+#include "slib/lang/String.h"
+#include "slib/io/OutputStream.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace slib {
+
+/**
+ * Append-only string builder for very large outputs (a simple rope). Data is appended into a chain
+ * of fixed-size chunks, so growing never moves what was already written. Another builder can be
+ * appended in O(1) by moving its chunks over. The content can be written out with a single
+ * gathering write or flattened into a String on demand. <b>NOT</b> thread-safe.
+ */
+class ChunkedStringBuilder {
+private:
+	struct Chunk {
+		Chunk *_next;
+		size_t _len;
+		size_t _size;
+		char _data[1];
+	};
+
+	Chunk *_head;
+	Chunk *_tail;
+	size_t _len;
+	size_t _numChunks;
+	size_t _chunkSize;
+
+	Chunk *newChunk(size_t size);
+	void appendChunk(Chunk *chunk);
+	void freeChunks();
+	char *reserve(size_t len);
+public:
+	static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024 - 64;
+
+	/** for std container compatibility */
+	typedef char value_type;
+
+	ChunkedStringBuilder(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+	ChunkedStringBuilder(ChunkedStringBuilder const& other) = delete;
+	ChunkedStringBuilder& operator=(ChunkedStringBuilder const& other) = delete;
+
+	/** move constructor */
+	ChunkedStringBuilder(ChunkedStringBuilder &&other);
+
+	/** move assignment */
+	ChunkedStringBuilder& operator=(ChunkedStringBuilder &&other);
+
+	~ChunkedStringBuilder();
+
+	size_t length() const {
+		return _len;
+	}
+
+	bool isEmpty() const {
+		return _len == 0;
+	}
+
+	/** @return number of chunks currently holding data */
+	size_t numChunks() const {
+		return _numChunks;
+	}
+
+	ChunkedStringBuilder& clear();
+
+	// appenders
+	ChunkedStringBuilder& add(const char *src, std::ptrdiff_t len = -1);
+	ChunkedStringBuilder& add(BasicString const& src);
+	ChunkedStringBuilder& add(std::string const& src);
+	ChunkedStringBuilder& add(int i);
+	ChunkedStringBuilder& add(int64_t i);
+	ChunkedStringBuilder& add(double d);
+
+	ChunkedStringBuilder& add(char c) {
+		if (_tail && _tail->_len < _tail->_size)
+			_tail->_data[_tail->_len++] = c;
+		else
+			*reserve(1) = c;
+		_len++;
+		return *this;
+	}
+
+	ChunkedStringBuilder& add(Object const* obj) {
+		return add(*String::valueOf(obj));
+	}
+
+	/**
+	 * Appends the content of another builder in O(1), by taking over its chunks.
+	 * The other builder is left empty.
+	 */
+	ChunkedStringBuilder& add(ChunkedStringBuilder &&other);
+
+	/** for std container compatibility */
+	void push_back(char c) {
+		add(c);
+	}
+
+	/**
+	 * Calls <i>f(const char *data, size_t len)</i> for each non-empty chunk, in order
+	 */
+	template <class F>
+	void forEachChunk(F f) const {
+		for (Chunk *chunk = _head; chunk; chunk = chunk->_next)
+			if (chunk->_len > 0)
+				f((const char *)chunk->_data, chunk->_len);
+	}
+
+	/**
+	 * Writes the whole content to an output stream, using a gathering write
+	 * @param out  output stream
+	 * @throws IOException
+	 */
+	void writeTo(OutputStream &out) const;
+
+	/**
+	 * Flattens the content into a single contiguous String (one allocation, one copy)
+	 * @return a String with the content of this builder
+	 */
+	UPtr<String> toString() const;
+
+	// for compatibility with RapidJSON streams
+	typedef char Ch;
+
+	void Put(char c) {
+		add(c);
+	}
+
+	void Flush() {}
+};
+
+} // namespace slib
+
+#endif // H_SLIB_LANG_CHUNKEDSTRINGBUILDER_H
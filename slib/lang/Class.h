@@ -132,6 +132,7 @@ typedef enum {
 			HASHMAP,
 				LINKEDHASHMAP,
 					PROPERTIES,
+			FROZENMAP,
 		BASICSTRING,
 			STRING,
 			ASCIICASEINSENSITIVESTRING,
@@ -164,6 +165,7 @@ constexpr uint64_t VOIDID = typeId<BASEID(VOID)>();
 		constexpr uint64_t HASHMAPID = typeId<BASEID(HASHMAP), MAPID>();
 			constexpr uint64_t LINKEDHASHMAPID = typeId<BASEID(LINKEDHASHMAP), HASHMAPID>();
 				constexpr uint64_t PROPERTIESID = typeId<BASEID(PROPERTIES), LINKEDHASHMAPID>();
+		constexpr uint64_t FROZENMAPID = typeId<BASEID(FROZENMAP), MAPID>();
 	constexpr uint64_t BASICSTRINGID = typeId<BASEID(BASICSTRING)>();
 		constexpr uint64_t STRINGID = typeId<BASEID(STRING), BASICSTRINGID>();
 		constexpr uint64_t ASCIICASEINSENSITIVESTRINGD = typeId<BASEID(ASCIICASEINSENSITIVESTRING), BASICSTRINGID>();
@@ -307,6 +309,7 @@ CLASSDEF(MAP, Map)
 CLASSDEF(HASHMAP, HashMap)
 CLASSDEF(LINKEDHASHMAP, LinkedHashMap)
 CLASSDEF(PROPERTIES, Properties)
+CLASSDEF(FROZENMAP, FrozenMap)
 CLASSDEF(BASICSTRING, BasicString)
 CLASSDEF(STRING, String)
 CLASSDEF(STRINGBUILDER, StringBuilder)
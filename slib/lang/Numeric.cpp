@@ -5,168 +5,709 @@
 #include "slib/lang/Numeric.h"
 #include "slib/util/StringUtils.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 namespace slib {
 
 Number::~Number() {}
 
 constexpr Class Number::_class;
 
-static UPtr<String> getMantissa(UPtr<String> const& str, size_t stopPos) {
-	char firstChar = str->charAt(0);
-	bool hasSign = (firstChar == '-' || firstChar == '+');
+// Single-pass number parsing
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define SLIB_NUMERIC_SWAR
+#endif
 
-	return hasSign ? str->substring(1, stopPos) : str->substring(0, stopPos);
+#ifdef SLIB_NUMERIC_SWAR
+/** Checks if 8 characters (loaded little-endian) are all decimal digits */
+static inline bool isEightDigits(uint64_t val) {
+	return (((val & 0xF0F0F0F0F0F0F0F0ULL) |
+			 (((val + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL);
 }
 
-static UPtr<String> getMantissa(UPtr<String> const& str) {
-	return getMantissa(str, str->length());
+/** Converts 8 decimal digits (loaded little-endian) with 3 multiplications */
+static inline uint32_t parseEightDigits(uint64_t val) {
+	const uint64_t mask = 0x000000FF000000FFULL;
+	const uint64_t mul1 = 0x000F424000000064ULL;	// 100 + (1000000 << 32)
+	const uint64_t mul2 = 0x0000271000000001ULL;	// 1 + (10000 << 32)
+	val -= 0x3030303030303030ULL;
+	val = (val * 10) + (val >> 8);
+	val = (((val & mask) * mul1) + (((val >> 16) & mask) * mul2)) >> 32;
+	return (uint32_t)val;
 }
+#endif
 
-static bool isAllZeros(UPtr<String> const& str) {
-	if (!str)
-		return true;
+static inline bool isDecimalDigit(char ch) {
+	return (ch >= '0') && (ch <= '9');
+}
 
-	for (ssize_t i = (ssize_t)str->length() - 1; i >= 0; i--) {
-		if (str->charAt((size_t)i) != '0')
-			return false;
+static inline int hexDigitValue(char ch) {
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	if (ch >= 'a' && ch <= 'f')
+		return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'F')
+		return ch - 'A' + 10;
+	return -1;
+}
+
+/** Decimal significand accumulated while scanning: the value is mantissa * 10^exp10 */
+struct DecimalDigits {
+	uint64_t mantissa = 0;	///< first 19 significant digits
+	int significant = 0;	///< number of digits in the mantissa, not counting leading zeros
+	int exp10 = 0;
+	bool inexact = false;	///< non-zero digits were dropped from the mantissa
+};
+
+static const char *scanDigits(const char *p, const char *end, DecimalDigits &d, bool fraction) {
+	for (;;) {
+#ifdef SLIB_NUMERIC_SWAR
+		if (d.significant > 0) {
+			while ((end - p >= 8) && (d.significant <= 11)) {
+				uint64_t val;
+				memcpy(&val, p, sizeof(val));
+				if (!isEightDigits(val))
+					break;
+				d.mantissa = d.mantissa * 100000000 + parseEightDigits(val);
+				d.significant += 8;
+				if (fraction)
+					d.exp10 -= 8;
+				p += 8;
+			}
+		}
+#endif
+		if ((p == end) || !isDecimalDigit(*p))
+			return p;
+		unsigned digit = (unsigned)(*p - '0');
+		if (d.significant < 19) {
+			d.mantissa = d.mantissa * 10 + digit;
+			if (d.significant > 0 || digit != 0)
+				d.significant++;
+			if (fraction)
+				d.exp10--;
+		} else {
+			if (digit != 0)
+				d.inexact = true;
+			if (!fraction)
+				d.exp10++;
+		}
+		p++;
 	}
-	return (str->length() > 0);
 }
 
-static bool isDigits(UPtr<String> const& str) {
-	if (StringUtils::isEmpty(CPtr(str)))
-		return false;
-	for (size_t i = 0; i < str->length(); i++) {
-		if (!std::isdigit(str->charAt(i)))
-			return false;
+static const double _exactPowersOf10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/** @throws NumericOverflowException */
+static double toDouble(DecimalDigits const& d, bool negative, const char *begin, const char *end) {
+	double value;
+	if (d.mantissa == 0)
+		value = 0;
+	else if ((!d.inexact) && (d.mantissa <= (1ULL << 53)) && (d.exp10 >= -22) && (d.exp10 <= 22)) {
+		// both operands are exact, so a single IEEE operation is correctly rounded
+		value = (double)d.mantissa;
+		if (d.exp10 < 0)
+			value /= _exactPowersOf10[-d.exp10];
+		else
+			value *= _exactPowersOf10[d.exp10];
+	} else {
+		// rare: let the C library do the correctly rounded conversion
+		char buffer[128];
+		std::string longLiteral;
+		size_t len = (size_t)(end - begin);
+		const char *str;
+		if (len < sizeof(buffer)) {
+			memcpy(buffer, begin, len);
+			buffer[len] = 0;
+			str = buffer;
+		} else {
+			longLiteral.assign(begin, len);
+			str = longLiteral.c_str();
+		}
+		value = fabs(strtod(str, nullptr));
+	}
+
+	// underflow rounds to (signed) zero, as with strtod()
+	if (std::isinf(value))
+		throw NumericOverflowException(_HERE_, "Out of range");
+	return negative ? -value : value;
+}
+
+/** @throws NumericOverflowException */
+static Number::Literal integerLiteral(uint64_t magnitude, bool negative, bool forceLong, size_t length) {
+	Number::Literal literal;
+	if (magnitude > (negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX))
+		throw NumericOverflowException(_HERE_, "Out of range");
+	literal.longValue = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+	literal.doubleValue = 0;
+	literal.length = length;
+	if ((!forceLong) && (literal.longValue >= INT32_MIN) && (literal.longValue <= INT32_MAX))
+		literal.type = Number::LiteralType::INTEGER;
+	else
+		literal.type = Number::LiteralType::LONG;
+	return literal;
+}
+
+Number::Literal Number::parse(StringView const& str) {
+	const char *begin = str.c_str();
+	const char *end = begin + str.length();
+	const char *p = begin;
+
+	bool negative = false;
+	if ((p < end) && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		p++;
+	}
+
+	const char *hexStart = nullptr;
+	if ((p < end) && (*p == '#'))
+		hexStart = p + 1;
+	else if ((end - p >= 2) && (p[0] == '0') && (p[1] == 'x' || p[1] == 'X'))
+		hexStart = p + 2;
+
+	if (hexStart) {
+		uint64_t magnitude = 0;
+		int significant = 0;
+		int digit;
+		for (p = hexStart; (p < end) && ((digit = hexDigitValue(*p)) >= 0); p++) {
+			if (significant > 0 || digit != 0)
+				significant++;
+			magnitude = (magnitude << 4) | (uint64_t)digit;
+		}
+		if (p == hexStart)
+			throw NumberFormatException(_HERE_, "Invalid hexadecimal number");
+		if (significant > 16)
+			throw NumericOverflowException(_HERE_, "Out of range");
+		bool forceLong = (p < end) && (*p == 'l' || *p == 'L');
+		if (forceLong)
+			p++;
+		return integerLiteral(magnitude, negative, forceLong, (size_t)(p - begin));
+	}
+
+	DecimalDigits d;
+	const char *intStart = p;
+	p = scanDigits(p, end, d, false);
+	const char *intEnd = p;
+	bool real = false;
+
+	if ((p < end) && (*p == '.')) {
+		real = true;
+		p = scanDigits(p + 1, end, d, true);
+	}
+	if ((intEnd == intStart) && (p <= intEnd + 1))
+		throw NumberFormatException(_HERE_, "Not a number");
+
+	if ((p < end) && (*p == 'e' || *p == 'E')) {
+		const char *q = p + 1;
+		bool negativeExp = false;
+		if ((q < end) && (*q == '-' || *q == '+')) {
+			negativeExp = (*q == '-');
+			q++;
+		}
+		if ((q == end) || !isDecimalDigit(*q))
+			throw NumberFormatException(_HERE_, "Invalid exponent");
+		int exp = 0;
+		for (; (q < end) && isDecimalDigit(*q); q++) {
+			if (exp < 100000)
+				exp = exp * 10 + (*q - '0');
+		}
+		d.exp10 += negativeExp ? -exp : exp;
+		real = true;
+		p = q;
+	}
+
+	const char *literalEnd = p;
+	bool forceLong = false;
+	if (p < end) {
+		char suffix = *p;
+		if (suffix == 'l' || suffix == 'L') {
+			if (real)
+				throw NumberFormatException(_HERE_, "Invalid number");
+			forceLong = true;
+			p++;
+		} else if (suffix == 'f' || suffix == 'F' || suffix == 'd' || suffix == 'D') {
+			real = true;
+			p++;
+		}
+	}
+
+	if (real) {
+		Literal literal;
+		literal.type = LiteralType::DOUBLE;
+		literal.longValue = 0;
+		literal.doubleValue = toDouble(d, negative, begin, literalEnd);
+		literal.length = (size_t)(p - begin);
+		return literal;
+	}
+
+	uint64_t magnitude;
+	if ((*intStart == '0') && (intEnd - intStart > 1)) {
+		// octal, as in Integer::decode()
+		magnitude = 0;
+		for (const char *q = intStart + 1; q < intEnd; q++) {
+			if (*q > '7')
+				throw NumberFormatException(_HERE_, "Invalid octal number");
+			if (magnitude >> 61)
+				throw NumericOverflowException(_HERE_, "Out of range");
+			magnitude = (magnitude << 3) | (uint64_t)(*q - '0');
+		}
+	} else {
+		if (d.exp10 > 0)
+			throw NumericOverflowException(_HERE_, "Out of range");
+		magnitude = d.mantissa;
+	}
+	return integerLiteral(magnitude, negative, forceLong, (size_t)(p - begin));
+}
+
+UPtr<Number> Number::createNumber(Literal const& literal) {
+	switch (literal.type) {
+		case LiteralType::INTEGER:
+			return std::make_unique<Integer>((int32_t)literal.longValue);
+		case LiteralType::LONG:
+			return std::make_unique<Long>(literal.longValue);
+		case LiteralType::DOUBLE:
+			break;
 	}
-	return true;
+	return std::make_unique<Double>(literal.doubleValue);
+}
+
+UPtr<Number> Number::createNumber(StringView const& str) {
+	Literal literal = parse(str);
+	if (literal.length != str.length())
+		throw NumberFormatException(_HERE_, "Invalid number");
+	return createNumber(literal);
 }
 
-/** adapted from Apache Commons Lang3 Numberutils, under Apache License-2.0 */
 UPtr<Number> Number::createNumber(UPtr<String> const& str) {
 	if (!str)
 		return nullptr;
 	if (StringUtils::isBlank(CPtr(str)))
 		throw NumberFormatException(_HERE_, "Cannot convert blank string to number");
 
-	static const std::vector<std::string> hexPrefixes {"0x", "0X", "-0x", "-0X", "#", "-#"};
+	return createNumber(StringView(str->c_str(), str->length()));
+}
 
-	size_t prefixLen = 0;
-	for (std::string const& prefix : hexPrefixes) {
-		if (str->startsWith(CPtr(prefix))) {
-			prefixLen += prefix.length();
-			break;
-		}
+bool Number::isMathematicalInteger(double val) {
+	return std::trunc(val) == val;
+}
+
+constexpr size_t Number::MAX_CHARS;
+
+// Allocation-free number formatting
+
+static const char _digitPairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/** Writes the digits of value right-aligned, ending just before end; returns the first digit */
+template <class T>
+static char *formatDigitsBackwards(T value, char *end) {
+	char *p = end;
+	while (value >= 100) {
+		unsigned idx = (unsigned)(value % 100) * 2;
+		value /= 100;
+		p -= 2;
+		p[0] = _digitPairs[idx];
+		p[1] = _digitPairs[idx + 1];
 	}
-	if (prefixLen > 0) {
-		// Hex
-		char firstNzDigit = 0;
-		for (size_t i = prefixLen; i < str->length(); i++) {
-			firstNzDigit = str->charAt(i);
-			if (firstNzDigit == '0')
-				prefixLen++;
-			else
-				break;
-		}
+	if (value >= 10) {
+		unsigned idx = (unsigned)value * 2;
+		p -= 2;
+		p[0] = _digitPairs[idx];
+		p[1] = _digitPairs[idx + 1];
+	} else
+		*--p = (char)('0' + value);
+	return p;
+}
+
+template <class T>
+static size_t formatUnsigned(T value, bool negative, char *buffer) {
+	char tmp[24];
+	char *end = tmp + sizeof(tmp);
+	char *p = formatDigitsBackwards(value, end);
+	if (negative)
+		*--p = '-';
+	size_t len = (size_t)(end - p);
+	memcpy(buffer, p, len);
+	buffer[len] = 0;
+	return len;
+}
+
+size_t Integer::toChars(int32_t i, char *buffer) {
+	uint32_t magnitude = (i < 0) ? 0u - (uint32_t)i : (uint32_t)i;
+	return formatUnsigned(magnitude, i < 0, buffer);
+}
+
+size_t UInt::toChars(uint32_t i, char *buffer) {
+	return formatUnsigned(i, false, buffer);
+}
 
-		size_t hexDigits = str->length() - prefixLen;
-		if (hexDigits > 16 || ((hexDigits == 16) && (firstNzDigit > '7'))) {
-			// cannot fit into a Long, we don't have a BigInteger yet, abort
-			throw NumberFormatException("Overflow");
+size_t Long::toChars(int64_t i, char *buffer) {
+	uint64_t magnitude = (i < 0) ? 0u - (uint64_t)i : (uint64_t)i;
+	if (magnitude <= UINT32_MAX)
+		return formatUnsigned((uint32_t)magnitude, i < 0, buffer);
+	return formatUnsigned(magnitude, i < 0, buffer);
+}
+
+size_t ULong::toChars(uint64_t i, char *buffer) {
+	if (i <= UINT32_MAX)
+		return formatUnsigned((uint32_t)i, false, buffer);
+	return formatUnsigned(i, false, buffer);
+}
+
+/*
+ * Shortest round-trip double formatting, after Florian Loitsch's Grisu3
+ * ("Printing Floating-Point Numbers Quickly and Accurately with Integers",
+ * PLDI 2010). Grisu3 detects the (about 0.5%) values for which it cannot
+ * prove its digits are the shortest ones that parse back; those are
+ * formatted exactly by the C library instead.
+ */
+namespace grisu {
+
+/** Floating point value with a 64-bit significand: f * 2^e */
+struct DiyFp {
+	uint64_t f;
+	int e;
+
+	DiyFp(uint64_t fp, int exp)
+	:f(fp), e(exp) {}
+
+	explicit DiyFp(double d) {
+		uint64_t bits;
+		memcpy(&bits, &d, sizeof(bits));
+		int biasedE = (int)((bits & EXPONENT_MASK) >> 52);
+		uint64_t significand = bits & SIGNIFICAND_MASK;
+		if (biasedE != 0) {
+			f = significand + HIDDEN_BIT;
+			e = biasedE - EXPONENT_BIAS;
+		} else {
+			f = significand;
+			e = 1 - EXPONENT_BIAS;
 		}
-		if (hexDigits > 8 || (hexDigits == 8 && firstNzDigit > '7'))
-			return std::make_unique<Long>(Long::decode(CPtr(str)));
-		return std::make_unique<Integer>(Integer::decode(CPtr(str)));
 	}
 
-	char lastChar = str->charAt(str->length() - 1);
+	DiyFp operator -(DiyFp const& other) const {
+		return DiyFp(f - other.f, e);
+	}
 
-	UPtr<String> mantissa;
-	UPtr<String> decimal;
-	UPtr<String> exponent;
+	/** Product rounded to 64 bits, with an error of at most 0.5 ulp */
+	DiyFp operator *(DiyFp const& other) const {
+#ifdef __SIZEOF_INT128__
+		unsigned __int128 p = (unsigned __int128)f * other.f;
+		uint64_t h = (uint64_t)(p >> 64);
+		uint64_t l = (uint64_t)p;
+		if (l & ((uint64_t)1 << 63))
+			h++;	// round
+#else
+		const uint64_t M32 = 0xFFFFFFFFULL;
+		uint64_t a = f >> 32, b = f & M32;
+		uint64_t c = other.f >> 32, d = other.f & M32;
+		uint64_t ad = a * d, bc = b * c;
+		uint64_t mid = ((b * d) >> 32) + (ad & M32) + (bc & M32);
+		mid += (uint64_t)1 << 31;	// round
+		uint64_t h = a * c + (ad >> 32) + (bc >> 32) + (mid >> 32);
+#endif
+		return DiyFp(h, e + other.e + 64);
+	}
 
-	ptrdiff_t decPos = str->indexOf('.');
-	ptrdiff_t expPos = str->indexOf('e') + str->indexOf('E') + 1; // assumes both not present
-	// if both e and E are present, this is caught by the checks on expPos and the parsing which
-	// will detect if e or E appear in a number due to using the wrong offset
+	DiyFp normalize() const {
+#ifdef __GNUC__
+		int s = __builtin_clzll(f);
+#else
+		int s = 0;
+		while (!(f & ((uint64_t)1 << (63 - s))))
+			s++;
+#endif
+		return DiyFp(f << s, e - s);
+	}
 
-	size_t numDecimals = 0;
-	if (decPos > -1) {
-		if (expPos > -1) {
-			if ((expPos < decPos) || ((size_t)expPos > str->length()))
-				throw NumberFormatException(_HERE_, "Invalid number");
-			decimal = str->substring((size_t)decPos + 1, (size_t)expPos);
-		} else
-			decimal = str->substring((size_t)decPos + 1);
-		mantissa = getMantissa(str, decPos);
-		numDecimals = decimal->length();
-	} else {
-		if (expPos > -1) {
-			if ((size_t)expPos > str->length())
-				throw NumberFormatException(_HERE_, "Invalid number");
-			mantissa = getMantissa(str, expPos);
-		} else
-			mantissa = getMantissa(str);
-	}
-
-	if ((!std::isdigit(lastChar)) && (lastChar != '.')) {
-		if ((expPos > -1) && (expPos < (ptrdiff_t)str->length() - 1))
-			exponent = str->substring((size_t)expPos + 1, str->length() - 1);
-
-		std::unique_ptr<String> numeric = str->substring(0, str->length() - 1);
-		bool allZeros = isAllZeros(mantissa) && isAllZeros(exponent);
-		switch (lastChar) {
-			case 'l':
-			case 'L':
-				if ((!decimal) && (!exponent) &&
-					(((numeric->charAt(0) == '-') && (isDigits(numeric->substring(1)))) || isDigits(numeric))) {
-					return std::make_unique<Long>(Long::decode(CPtr(str)));
-					//we don't have a BigInteger yet, if we crash so be it
-				}
-				throw NumberFormatException(_HERE_, "Invalid number");
-			case 'f':
-			case 'F':
-				// we don't have a Float yet, fallback to Double
-			case 'd':
-			case 'D':
-				{
-					double d = Double::parseDouble(CPtr(numeric));
-					if (!(Double::isInfinite(d) || (d == 0.0 && !allZeros)))
-						return std::make_unique<Double>(d);
-				}
-				//we don't have a BigInteger yet, if we crash so be it
-				[[clang::fallthrough]];
-			default:
-				throw NumberFormatException(_HERE_, "Invalid number");
-		}
+	/** Computes the normalized boundaries m- and m+ of the value */
+	void normalizedBoundaries(DiyFp &minus, DiyFp &plus) const {
+		DiyFp pl = DiyFp((f << 1) + 1, e - 1).normalize();
+		// the lower neighbour is closer at powers of 2, except for the smallest normal value
+		bool lowerCloser = (f == HIDDEN_BIT) && (e != 1 - EXPONENT_BIAS);
+		DiyFp mi = lowerCloser ? DiyFp((f << 2) - 1, e - 2) : DiyFp((f << 1) - 1, e - 1);
+		mi.f <<= mi.e - pl.e;
+		mi.e = pl.e;
+		plus = pl;
+		minus = mi;
 	}
 
-	if ((expPos > -1) && (expPos < (ptrdiff_t)str->length() - 1))
-		exponent = str->substring((size_t)expPos + 1, str->length());
-	if ((!decimal) && (!exponent)) {
-		try {
-			return std::make_unique<Integer>(Integer::decode(CPtr(str)));
-		} catch (NumberFormatException const&) {
-			// ignore
-		}
-		return std::make_unique<Long>(Long::decode(CPtr(str)));
-		//we don't have a BigInteger yet, if we crash so be it
+	static constexpr uint64_t EXPONENT_MASK = 0x7FF0000000000000ULL;
+	static constexpr uint64_t SIGNIFICAND_MASK = 0x000FFFFFFFFFFFFFULL;
+	static constexpr uint64_t HIDDEN_BIT = 0x0010000000000000ULL;
+	static constexpr int EXPONENT_BIAS = 0x3FF + 52;
+};
+
+/** Normalized 64-bit approximations of 10^k, for k = -348, -340, ..., 340 */
+static const uint64_t _cachedPowersF[] = {
+	0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+	0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+	0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+	0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+	0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+	0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+	0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+	0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+	0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+	0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+	0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+	0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+	0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+	0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+	0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+	0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+	0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+	0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+	0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+	0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+	0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+	0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+static const int16_t _cachedPowersE[] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+	-954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+	-688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+	-422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+	-157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+	109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+	375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+	641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+	907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+/** Returns c_k ~= 10^-K, with K chosen so that the product with a value of binary exponent e has exponent in [-60, -32] */
+static DiyFp getCachedPower(int e, int &K) {
+	double dk = (-61 - e) * 0.30102999566398114 + 347;	// 1/lg(10)
+	int k = (int)dk;
+	if (dk - k > 0.0)
+		k++;
+	unsigned index = (unsigned)((k >> 3) + 1);
+	K = -(-348 + (int)(index << 3));
+	return DiyFp(_cachedPowersF[index], _cachedPowersE[index]);
+}
+
+/**
+ * Moves the last generated digit towards the value while it stays in the safe interval,
+ * and checks that the result is provably the closest shortest representation.
+ * All quantities are in units of the scaled, 64-bit representation.
+ * @param distanceTooHighW  distance from the upper end of the unsafe interval to the value
+ * @param unsafeInterval  width of the interval the digits are known to lie in
+ * @param rest  distance from the digits to the upper end of the unsafe interval
+ * @param tenKappa  weight of the last digit
+ * @param unit  maximum error of the scaled values
+ * @return false if the digits cannot be proven correct
+ */
+static bool roundWeed(char *buffer, int len, uint64_t distanceTooHighW, uint64_t unsafeInterval,
+					  uint64_t rest, uint64_t tenKappa, uint64_t unit) {
+	uint64_t smallDistance = distanceTooHighW - unit;
+	uint64_t bigDistance = distanceTooHighW + unit;
+	while (rest < smallDistance && unsafeInterval - rest >= tenKappa &&
+		   (rest + tenKappa < smallDistance || smallDistance - rest >= rest + tenKappa - smallDistance)) {
+		buffer[len - 1]--;
+		rest += tenKappa;
+	}
+	// another candidate could be closer to the value, given the error
+	if (rest < bigDistance && unsafeInterval - rest >= tenKappa &&
+		(rest + tenKappa < bigDistance || bigDistance - rest > rest + tenKappa - bigDistance))
+		return false;
+	// the digits must be inside the safe interval
+	return (2 * unit <= rest) && (rest <= unsafeInterval - 4 * unit);
+}
+
+static int countDecimalDigits(uint32_t n) {
+	if (n < 10) return 1;
+	if (n < 100) return 2;
+	if (n < 1000) return 3;
+	if (n < 10000) return 4;
+	if (n < 100000) return 5;
+	if (n < 1000000) return 6;
+	if (n < 10000000) return 7;
+	if (n < 100000000) return 8;
+	if (n < 1000000000) return 9;
+	return 10;
+}
+
+static const uint32_t _pow10[] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/**
+ * Generates the shortest digits in the scaled interval (low, high), as close as possible to w
+ * @return false if the digits cannot be proven correct
+ */
+static bool generateDigits(DiyFp const& low, DiyFp const& w, DiyFp const& high, char *buffer, int &len, int &kappa) {
+	// the scaled values are off by less than one unit, so the value is in (tooLow, tooHigh)
+	uint64_t unit = 1;
+	const DiyFp tooLow(low.f - unit, low.e);
+	const DiyFp tooHigh(high.f + unit, high.e);
+	uint64_t unsafeInterval = (tooHigh - tooLow).f;
+	const DiyFp one((uint64_t)1 << -w.e, w.e);
+	uint32_t integrals = (uint32_t)(tooHigh.f >> -one.e);
+	uint64_t fractionals = tooHigh.f & (one.f - 1);
+	kappa = countDecimalDigits(integrals);
+	len = 0;
+
+	while (kappa > 0) {
+		uint32_t divisor = _pow10[kappa - 1];
+		buffer[len++] = (char)('0' + integrals / divisor);
+		integrals %= divisor;
+		kappa--;
+		uint64_t rest = ((uint64_t)integrals << -one.e) + fractionals;
+		if (rest < unsafeInterval)
+			return roundWeed(buffer, len, (tooHigh - w).f, unsafeInterval, rest, (uint64_t)divisor << -one.e, unit);
 	}
 
-	bool allZeros = isAllZeros(mantissa) && isAllZeros(exponent);
-	if (numDecimals <= 16) {
-		double d = Double::parseDouble(CPtr(str));
-		if (!(Double::isInfinite(d) || (d == 0.0 && !allZeros)))
-			return std::make_unique<Double>(d);
-		throw NumberFormatException(_HERE_, "Invalid number");
+	for (;;) {
+		fractionals *= 10;
+		unit *= 10;
+		unsafeInterval *= 10;
+		buffer[len++] = (char)('0' + (fractionals >> -one.e));
+		fractionals &= one.f - 1;
+		kappa--;
+		if (fractionals < unsafeInterval)
+			return roundWeed(buffer, len, (tooHigh - w).f * unit, unsafeInterval, fractionals, one.f, unit);
 	}
+}
 
-	throw NumberFormatException(_HERE_, "Overflow");
+/**
+ * Generates the shortest digits of a positive, finite value; the value is digits * 10^K
+ * @return false if the digits cannot be proven to be the shortest, closest ones
+ */
+static bool grisu3(double value, char *buffer, int &len, int &K) {
+	const DiyFp v(value);
+	DiyFp wMinus(0, 0), wPlus(0, 0);
+	v.normalizedBoundaries(wMinus, wPlus);
+
+	const DiyFp cMk = getCachedPower(wPlus.e, K);
+	const DiyFp W = v.normalize() * cMk;
+	const DiyFp Wp = wPlus * cMk;
+	const DiyFp Wm = wMinus * cMk;
+	int kappa;
+	bool exact = generateDigits(Wm, W, Wp, buffer, len, kappa);
+	K += kappa;
+	return exact;
 }
 
-bool Number::isMathematicalInteger(double val) {
-	return std::trunc(val) == val;
+/**
+ * Generates the shortest digits of a positive, finite value with the C library: the
+ * correctly rounded digits of the first precision that parses back to the value
+ */
+static void exactDigits(double value, char *buffer, int &len, int &K) {
+	for (int precision = 1; ; precision++) {
+		char text[32];
+		snprintf(text, sizeof(text), "%.*e", precision - 1, value);
+		// d.ddde[+-]xx, the decimal point depends on the locale
+		len = 0;
+		const char *p = text;
+		for (; *p != 'e'; p++) {
+			if (*p >= '0' && *p <= '9')
+				buffer[len++] = *p;
+		}
+		K = atoi(p + 1) - (len - 1);
+
+		// parsed back without a decimal point, so independently of the locale
+		char check[32];
+		memcpy(check, buffer, (size_t)len);
+		snprintf(check + len, sizeof(check) - (size_t)len, "e%d", K);
+		if (precision >= 17 || strtod(check, nullptr) == value)
+			return;
+	}
+}
+
+constexpr uint64_t DiyFp::EXPONENT_MASK;
+constexpr uint64_t DiyFp::SIGNIFICAND_MASK;
+constexpr uint64_t DiyFp::HIDDEN_BIT;
+constexpr int DiyFp::EXPONENT_BIAS;
+
+} // namespace grisu
+
+size_t Double::toChars(double d, char *buffer) {
+	char *p = buffer;
+
+	if (std::isnan(d)) {
+		memcpy(buffer, "nan", 4);
+		return 3;
+	}
+	if (std::signbit(d)) {
+		*p++ = '-';
+		d = -d;
+	}
+	if (std::isinf(d)) {
+		memcpy(p, "inf", 4);
+		return (size_t)(p - buffer) + 3;
+	}
+	if (d == 0) {
+		memcpy(p, "0", 2);
+		return (size_t)(p - buffer) + 1;
+	}
+
+	char digits[20];
+	int len, K;
+	if (!grisu::grisu3(d, digits, len, K))
+		grisu::exactDigits(d, digits, len, K);
+
+	// the value is 0.d1d2...dn * 10^point
+	int point = len + K;
+	// larger integers are not all exact, and would not parse back as integer literals
+	bool plain = d < 9007199254740992.0;	// 2^53
+
+	if (plain && point >= len) {
+		// integer: digits followed by zeros
+		memcpy(p, digits, (size_t)len);
+		p += len;
+		for (int i = len; i < point; i++)
+			*p++ = '0';
+	} else if (plain && point > 0) {
+		// d1d2.d3d4
+		memcpy(p, digits, (size_t)point);
+		p += point;
+		*p++ = '.';
+		memcpy(p, digits + point, (size_t)(len - point));
+		p += len - point;
+	} else if (point > -6 && point <= 0) {
+		// 0.00d1d2
+		*p++ = '0';
+		*p++ = '.';
+		for (int i = point; i < 0; i++)
+			*p++ = '0';
+		memcpy(p, digits, (size_t)len);
+		p += len;
+	} else {
+		// d1.d2d3e+xx
+		*p++ = digits[0];
+		if (len > 1) {
+			*p++ = '.';
+			memcpy(p, digits + 1, (size_t)(len - 1));
+			p += len - 1;
+		}
+		*p++ = 'e';
+		int exp = point - 1;
+		if (exp < 0) {
+			*p++ = '-';
+			exp = -exp;
+		} else
+			*p++ = '+';
+		p = p + (exp >= 100 ? 3 : (exp >= 10 ? 2 : 1));
+		formatDigitsBackwards((unsigned)exp, p);
+	}
+
+	*p = 0;
+	return (size_t)(p - buffer);
 }
 
 constexpr Class Integer::_class;
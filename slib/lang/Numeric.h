@@ -8,12 +8,12 @@
 #include "slib/lang/Object.h"
 #include "slib/exception/NumericExceptions.h"
 #include "slib/lang/String.h"
+#include "slib/lang/StringView.h"
 #include "slib/compat/cppbits/make_unique.h"
 
 #include "fmt/format.h"
 
 #include <string>
-#include <sstream>
 
 #include <math.h>
 #include <limits.h>
@@ -29,10 +29,51 @@ public:
 
 	static constexpr Class _class = NUMBERCLASS;
 
+	/** Buffer size sufficient for the output of any toChars() variant, including the terminating null */
+	static constexpr size_t MAX_CHARS = 32;
+
 	virtual int64_t longValue() const = 0;
 
 	virtual double doubleValue() const = 0;
 
+	/** Type of a numeric literal recognized by parse() */
+	enum class LiteralType { INTEGER, LONG, DOUBLE };
+
+	/** Numeric literal recognized by parse() */
+	struct Literal {
+		LiteralType type;
+		int64_t longValue;		///< value of INTEGER and LONG literals
+		double doubleValue;		///< value of DOUBLE literals
+		size_t length;			///< number of characters consumed
+	};
+
+	/**
+	 * Classifies and parses the numeric literal at the start of a string in a
+	 * single pass, without allocating. Accepts decimal, octal (leading 0) and
+	 * hexadecimal (0x, #) integers with an optional sign, decimal reals with an
+	 * optional exponent and the l/L, f/F, d/D type suffixes. Scanning stops at
+	 * the first character that cannot continue the literal.
+	 *
+	 * Real literals too small for a double round to zero, as with strtod().
+	 *
+	 * @throws NumberFormatException if the string does not start with a valid literal
+	 * @throws NumericOverflowException if an integer literal does not fit into 64 bits
+	 * or a real literal is too large for a double
+	 */
+	static Literal parse(StringView const& str);
+
+	/**
+	 * Creates an Integer, Long or Double from a string that contains a single
+	 * numeric literal, as accepted by parse().
+	 *
+	 * @throws NumberFormatException
+	 */
+	static UPtr<Number> createNumber(StringView const& str);
+
+	/** Creates an Integer, Long or Double holding the value of a parsed literal */
+	static UPtr<Number> createNumber(Literal const& literal);
+
+	/** @throws NumberFormatException */
 	static UPtr<Number> createNumber(UPtr<String> const& str);
 
 	static bool isMathematicalInteger(double val);
@@ -180,10 +221,20 @@ public:
 		return result;
 	}
 
+	/**
+	 * Writes the decimal representation of the argument to a buffer of at
+	 * least Number::MAX_CHARS characters, without allocating.
+	 *
+	 * @param i  the value to format.
+	 * @param buffer  destination buffer, null terminated on return.
+	 * @return the number of characters written, not counting the terminating null.
+	 */
+	static size_t toChars(int32_t i, char *buffer);
+
 	static UPtr<String> toString(int32_t i) {
-		std::stringstream stream;
-		stream << i;
-		return std::make_unique<String>(stream.str());
+		char buffer[MAX_CHARS];
+		size_t len = toChars(i, buffer);
+		return std::make_unique<String>(buffer, len);
 	}
 
 	/**
@@ -298,10 +349,13 @@ public:
 		return parseUInt(s.c_str(), radix);
 	}
 
+	/** @see Integer::toChars(int32_t, char*) */
+	static size_t toChars(uint32_t i, char *buffer);
+
 	static UPtr<String> toString(uint32_t i) {
-		std::stringstream stream;
-		stream << i;
-		return std::make_unique<String>(stream.str());
+		char buffer[MAX_CHARS];
+		size_t len = toChars(i, buffer);
+		return std::make_unique<String>(buffer, len);
 	}
 
 	/**
@@ -513,10 +567,13 @@ public:
 		return result;
 	}
 
+	/** @see Integer::toChars(int32_t, char*) */
+	static size_t toChars(int64_t i, char *buffer);
+
 	static UPtr<String> toString(int64_t i) {
-		std::stringstream stream;
-		stream << i;
-		return std::make_unique<String>(stream.str());
+		char buffer[MAX_CHARS];
+		size_t len = toChars(i, buffer);
+		return std::make_unique<String>(buffer, len);
 	}
 
 	virtual UPtr<String> toString() const override {
@@ -636,10 +693,13 @@ public:
 		}
 	};
 
+	/** @see Integer::toChars(int32_t, char*) */
+	static size_t toChars(uint64_t i, char *buffer);
+
 	static UPtr<String> toString(uint64_t i) {
-		std::stringstream stream;
-		stream << i;
-		return std::make_unique<String>(stream.str());
+		char buffer[MAX_CHARS];
+		size_t len = toChars(i, buffer);
+		return std::make_unique<String>(buffer, len);
 	}
 
 	virtual UPtr<String> toString() const override {
@@ -744,10 +804,25 @@ public:
 		return parseDouble(buffer);
 	}
 
+	/**
+	 * Writes the shortest decimal representation of the argument that
+	 * parses back to the same value to a buffer of at least
+	 * Number::MAX_CHARS characters, without allocating. Plain notation is
+	 * used for magnitudes in [1e-6, 2^53), scientific notation otherwise
+	 * (<code>1e+20</code>, <code>1.5e-8</code>), so the output never reads
+	 * as an integer literal too large to parse. Non-finite values are
+	 * written as <code>nan</code>, <code>inf</code> and <code>-inf</code>.
+	 *
+	 * @param d  the value to format.
+	 * @param buffer  destination buffer, null terminated on return.
+	 * @return the number of characters written, not counting the terminating null.
+	 */
+	static size_t toChars(double d, char *buffer);
+
 	static UPtr<String> toString(double d) {
-		std::stringstream stream;
-		stream << d;
-		return std::make_unique<String>(stream.str());
+		char buffer[MAX_CHARS];
+		size_t len = toChars(d, buffer);
+		return std::make_unique<String>(buffer, len);
 	}
 };
 
@@ -8,6 +8,8 @@
 #include "slib/lang/Object.h"
 #include "slib/exception/Exception.h"
 #include "slib/util/TemplateUtils.h"
+#include "slib/lang/StringView.h"
+#include "slib/lang/ASCII.h"
 #include "slib/compat/cppbits/make_unique.h"
 
 #include "fmt/format.h"
@@ -107,10 +109,13 @@ public:
 	String();
 
 	String(std::string const& str);
+	String(std::string &&str);
 
 	String(const char *buffer);
 	String(const char *buffer, size_t len);
 
+	String(HashedStringView const& str);
+
 	String(String const& other);
 
 	String(char c);
@@ -643,8 +648,6 @@ void format_arg(fmt::BasicFormatter<char> &f, const char *&format_str, String co
  * Immutable ASCII string with case-insensitive comparison and hash code
  */
 class ASCIICaseInsensitiveString : public BasicString {
-private:
-	static const unsigned char _toLower[];
 protected:
 	char *_buffer;
 	size_t _len;
@@ -710,7 +713,7 @@ public:
 	 * Compares this String to another String, ignoring case.
 	 * Two strings are considered equal ignoring case if they are of the same length and
 	 * corresponding characters in the two strings are equal ignoring case.
-	 * Uses stricmp() internally.
+	 * Only ASCII letters are folded, independent of the current locale.
 	 *
 	 * @param other The String to compare this String against
 	 *
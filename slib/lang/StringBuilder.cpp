@@ -4,6 +4,7 @@
 
 #include "slib/lang/StringBuilder.h"
 #include "slib/lang/String.h"
+#include "slib/lang/Numeric.h"
 
 #include <stdarg.h>
 #include <inttypes.h>
@@ -509,10 +510,9 @@ const StringBuilder StringBuilder::operator+(char other) const {
 
 StringBuilder& StringBuilder::add(int i) {
 	_hash = 0;
-	char buffer[32];
-	int n = snprintf(buffer, 31, "%d", i);
-	buffer[31] = 0;
-	add(buffer, n);
+	char buffer[Number::MAX_CHARS];
+	size_t n = Integer::toChars((int32_t)i, buffer);
+	add(buffer, (ptrdiff_t)n);
 	return *this;
 }
 
@@ -532,10 +532,9 @@ const StringBuilder StringBuilder::operator+(int other) const {
 
 StringBuilder& StringBuilder::add(int64_t i) {
 	_hash = 0;
-	char buffer[32];
-	int n = snprintf(buffer, 31, "%" PRId64, i);
-	buffer[31] = 0;
-	add(buffer, n);
+	char buffer[Number::MAX_CHARS];
+	size_t n = Long::toChars(i, buffer);
+	add(buffer, (ptrdiff_t)n);
 	return *this;
 }
 
@@ -555,10 +554,9 @@ const StringBuilder StringBuilder::operator+(int64_t other) const {
 
 StringBuilder& StringBuilder::add(double d) {
 	_hash = 0;
-	char buffer[64];
-	int n = snprintf(buffer, 63, "%g", d);
-	buffer[63] = 0;
-	add(buffer, n);
+	char buffer[Number::MAX_CHARS];
+	size_t n = Double::toChars(d, buffer);
+	add(buffer, (ptrdiff_t)n);
 	return *this;
 }
 
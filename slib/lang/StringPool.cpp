@@ -0,0 +1,65 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "slib/lang/StringPool.h"
+
+namespace slib {
+
+StringPool::StringPool() {
+	for (SPtr<Shard> &shard : _shards)
+		shard = std::make_shared<Shard>();
+}
+
+StringPool& StringPool::global() {
+	static StringPool pool;
+	return pool;
+}
+
+void StringPool::Release::operator()(const String *str) const {
+	{
+		std::lock_guard<std::mutex> aLock(_shard->_lock);
+		auto it = _shard->_pool.find({str->c_str(), str->length(), str->hashCode()});
+		// the entry may already have been replaced by a newer instance of the same name
+		if ((it != _shard->_pool.end()) && (it->first._str == str->c_str()))
+			_shard->_pool.erase(it);
+	}
+	delete str;
+}
+
+SPtr<const String> StringPool::intern(const char *str, size_t len) {
+	// same as String::hashCode(), computed without signed overflow
+	uint32_t h = 0;
+	for (size_t i = 0; i < len; i++)
+		h = 31 * h + (uint32_t)str[i];
+
+	Key key {str, len, (int32_t)h};
+	SPtr<Shard> const& shard = _shards[h % SHARDS];
+
+	std::lock_guard<std::mutex> aLock(shard->_lock);
+	auto it = shard->_pool.find(key);
+	if (it != shard->_pool.end()) {
+		SPtr<const String> canonical = it->second.lock();
+		if (canonical)
+			return canonical;
+		// expired, but its deleter is still waiting for the lock to remove it
+		shard->_pool.erase(it);
+	}
+
+	SPtr<const String> canonical(new String(str, len), Release{shard});
+	canonical->hashCode();
+	key._str = canonical->c_str();
+	shard->_pool.emplace(key, canonical);
+	return canonical;
+}
+
+size_t StringPool::size() {
+	size_t size = 0;
+	for (SPtr<Shard> &shard : _shards) {
+		std::lock_guard<std::mutex> aLock(shard->_lock);
+		size += shard->_pool.size();
+	}
+	return size;
+}
+
+} // namespace slib
@@ -0,0 +1,95 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_LANG_STRINGPOOL_H
+#define H_SLIB_LANG_STRINGPOOL_H
+
+#include "slib/lang/String.h"
+#include "slib/lang/StringView.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace slib {
+
+/**
+ * Thread-safe intern table. Returns a single canonical, immutable instance
+ * for each distinct character sequence, with its hash code already computed.
+ * Two interned strings are equal if and only if they are the same instance,
+ * so comparing them reduces to a pointer compare.
+ *
+ * The table is split into independently locked shards, selected by hash code,
+ * so that concurrent compiles and config loads rarely contend. It only holds
+ * weak references: a canonical string is dropped from the pool when the last
+ * reference to it goes away, so the pool never grows beyond the set of names
+ * still in use.
+ */
+class StringPool {
+private:
+	/** Lookup key; for pooled entries it points into the canonical string */
+	struct Key {
+		const char *_str;
+		size_t _len;
+		int32_t _hash;
+	};
+
+	struct KeyHash {
+		size_t operator()(Key const& key) const {
+			return (size_t)key._hash;
+		}
+	};
+
+	struct KeyEquals {
+		bool operator()(Key const& a, Key const& b) const {
+			return (a._len == b._len) && (memcmp(a._str, b._str, a._len) == 0);
+		}
+	};
+
+	struct Shard {
+		std::mutex _lock;
+		std::unordered_map<Key, std::weak_ptr<const String>, KeyHash, KeyEquals> _pool;
+	};
+
+	/** Deletes a canonical string, removing its entry first; keeps the shard alive until then */
+	struct Release {
+		SPtr<Shard> _shard;
+
+		void operator()(const String *str) const;
+	};
+
+	static const size_t SHARDS = 16;
+
+	SPtr<Shard> _shards[SHARDS];
+public:
+	StringPool();
+
+	StringPool(StringPool const&) = delete;
+	StringPool& operator=(StringPool const&) = delete;
+
+	/** Shared pool used for identifiers by the expression engine */
+	static StringPool& global();
+
+	/** @return the canonical instance of the given character sequence */
+	SPtr<const String> intern(const char *str, size_t len);
+
+	SPtr<const String> intern(StringView const& str) {
+		return intern(str.c_str(), str.length());
+	}
+
+	/** @return the canonical instance of the given string, or <code>nullptr</code> if it is null */
+	template <class S>
+	SPtr<const String> intern(S const* str) {
+		if (!str)
+			return nullptr;
+		return intern(str->c_str(), str->length());
+	}
+
+	/** @return the number of canonical strings currently in use */
+	size_t size();
+};
+
+} // namespace slib
+
+#endif // H_SLIB_LANG_STRINGPOOL_H
@@ -6,6 +6,8 @@
 #define H_SLIB_LANG_STRINGVIEW_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "fmt/format.h"
 
@@ -41,6 +43,41 @@ constexpr StringView operator ""_SV(const char* str, size_t len) noexcept {
 	return StringView(str, len);
 }
 
+/**
+ * StringView with a hash code computed at compile time, identical to
+ * String::hashCode() for the same characters. Strings constructed from it
+ * start with their hash already cached. HashMap and FrozenMap with String keys
+ * also take it directly (<code>map.get("hostname"_HS)</code>), which neither
+ * hashes at runtime nor allocates a temporary String; going through the
+ * generic Map interface still converts it to a String first.
+ */
+class HashedStringView : public StringView {
+private:
+	int32_t _hash;
+
+	static constexpr uint32_t hash(const char *str, size_t len, uint32_t h) noexcept {
+		return (len == 0) ? h : hash(str + 1, len - 1, 31 * h + (uint32_t)(int32_t)*str);
+	}
+public:
+	inline constexpr HashedStringView(const char *str, size_t len) noexcept
+	:StringView(str, len)
+	,_hash((int32_t)hash(str, len, 0)) {}
+
+	inline constexpr int32_t hashCode() const noexcept {
+		return _hash;
+	}
+
+	/** @return <i>true</i> if the given string has the same characters */
+	template <class S>
+	bool equals(S const& str) const {
+		return (str.length() == length()) && (memcmp(str.c_str(), c_str(), length()) == 0);
+	}
+};
+
+constexpr HashedStringView operator ""_HS(const char* str, size_t len) noexcept {
+	return HashedStringView(str, len);
+}
+
 void format_arg(fmt::BasicFormatter<char> &f, const char *&format_str, StringView const& s);
 
 } // namespace slib
@@ -8,7 +8,11 @@
 #include "slib/collections/ArrayList.h"
 #include "slib/io/FileInputStream.h"
 #include "slib/util/expr/ExpressionEvaluator.h"
+#include "slib/util/expr/Template.h"
+#include "slib/concurrent/ThreadPool.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -28,21 +32,27 @@ UPtr<String> ConfigProcessor::processLine(String const& name, SPtr<String> const
 			_vars = std::make_unique<HashMap<String, Object>>();
 		_vars->put(String::substring(CPtr(name), 1), value);
 		return nullptr;
-	} else if (String::endsWith(CPtr(name), ']')) {
-		ptrdiff_t openBracket = String::lastIndexOf(CPtr(name), '[');
-		if (openBracket > 0) {
-			std::string mapName = String::trim(CPtr(String::substring(CPtr(name), 0, (size_t)openBracket)));
-			std::string mapEntry = String::trim(CPtr(String::substring(CPtr(name), (size_t)openBracket + 1, name.length() - 1)));
-			if ((!mapName.empty()) && (!mapEntry.empty())) {
-				bool sunk = sink(mapName, mapEntry, value);
-				if (sunk)
-					return nullptr;
-			}
-		}
+	}
+
+	std::string sinkName, sinkEntry;
+	if (isSunk(name, sinkName, sinkEntry)) {
+		sink(sinkName, sinkEntry, value);
+		return nullptr;
 	}
 	return Value::asString(value);
 }
 
+bool ConfigProcessor::isSunk(String const& propertyName, std::string &sinkName, std::string &name) const {
+	if (!String::endsWith(CPtr(propertyName), ']'))
+		return false;
+	ptrdiff_t openBracket = String::lastIndexOf(CPtr(propertyName), '[');
+	if (openBracket <= 0)
+		return false;
+	sinkName = String::trim(CPtr(String::substring(CPtr(propertyName), 0, (size_t)openBracket)));
+	name = String::trim(CPtr(String::substring(CPtr(propertyName), (size_t)openBracket + 1, propertyName.length() - 1)));
+	return (!sinkName.empty()) && (!name.empty()) && (_sinks.find(sinkName) != _sinks.end());
+}
+
 bool ConfigProcessor::sink(String const& sinkName, String const& name, SPtr<Object> const& value) {
 	SinkMapConstIter sink = _sinks.find(sinkName);
 	if (sink == _sinks.end())
@@ -55,7 +65,13 @@ SPtr<Object> ConfigProcessor::getVar(String const& name) const {
 	SPtr<Object> value = _props.get(name);
 	if ((!value) && _vars)
 		value = _vars->get(name);
-	if ((!value) && _sources) {
+	if (!value)
+		value = getSourceVar(name);
+	return value;
+}
+
+SPtr<Object> ConfigProcessor::getSourceVar(String const& name) const {
+	if (_sources) {
 		std::ptrdiff_t dotPos;
 		if ((dotPos = String::lastIndexOf(CPtr(name), '.')) > 0) {
 			std::string providerName = String::substring(CPtr(name), 0, (size_t)dotPos);
@@ -65,7 +81,243 @@ SPtr<Object> ConfigProcessor::getVar(String const& name) const {
 				return provider->second->getVar(propertyName);
 		}
 	}
-	return value;
+	return nullptr;
+}
+
+/**
+ * Lines of a config file evaluated as a dependency graph: each line waits for the earlier
+ * lines that define a property or variable it references, or a dotted name under it.
+ */
+class ConfigProcessor::ParallelLoad {
+private:
+	enum class Kind : uint8_t { PROPERTY, VARIABLE, SINK };
+
+	struct LineState {
+		Kind _kind;
+		/** property or variable name, or name passed to the sink */
+		String _name;
+		std::string _sinkName;
+		SPtr<const Template> _template;
+		/** later lines waiting for this one */
+		std::vector<uint32_t> _dependents;
+		std::atomic<uint32_t> _waiting;
+		/** a line this one waits for failed */
+		std::atomic<bool> _skipped;
+		SPtr<Object> _value;
+		/** PROPERTY: value stored in the properties */
+		SPtr<String> _stored;
+		std::exception_ptr _error;
+
+		LineState()
+		:_kind(Kind::PROPERTY)
+		,_waiting(0)
+		,_skipped(false) {}
+	};
+
+	/** Looks variables up as ConfigProcessor::getVar() would while processing a line */
+	class LineResolver : public Resolver {
+	private:
+		ParallelLoad const& _load;
+		uint32_t _line;
+
+		/** @return last line defining <i>name</i> before the current one, at or before <i>before</i> */
+		static ptrdiff_t lastBefore(std::vector<uint32_t> const& defs, ptrdiff_t before) {
+			auto i = std::lower_bound(defs.begin(), defs.end(), (uint32_t)(before + 1));
+			return (i == defs.begin()) ? -1 : *(i - 1);
+		}
+	public:
+		LineResolver(ParallelLoad const& load, uint32_t line)
+		:_load(load)
+		,_line(line) {}
+
+		virtual SPtr<Object> getVar(String const& name) const override {
+			SPtr<Object> value;
+			// the last property definition that stored a value, if any
+			bool defined = false;
+			auto props = _load._properties.find(name);
+			if (props != _load._properties.end()) {
+				for (ptrdiff_t i = lastBefore(props->second, (ptrdiff_t)_line - 1); i >= 0; i = lastBefore(props->second, i - 1)) {
+					if (_load._lines[i]._stored) {
+						value = _load._lines[i]._stored;
+						defined = true;
+						break;
+					}
+				}
+			}
+			if (!defined)
+				value = _load._proc._props.get(name);
+
+			if (!value) {
+				auto vars = _load._variables.find(name);
+				ptrdiff_t i = (vars != _load._variables.end()) ? lastBefore(vars->second, (ptrdiff_t)_line - 1) : -1;
+				if (i >= 0)
+					value = _load._lines[i]._value;
+				else if (_load._proc._vars)
+					value = _load._proc._vars->get(name);
+			}
+
+			if (!value)
+				value = _load._proc.getSourceVar(name);
+			return value;
+		}
+	};
+
+	ConfigProcessor &_proc;
+	std::vector<Line> const& _source;
+	std::vector<LineState> _lines;
+	/** lines defining each property, in order */
+	std::unordered_map<String, std::vector<uint32_t>> _properties;
+	/** lines defining each variable, in order */
+	std::unordered_map<String, std::vector<uint32_t>> _variables;
+
+	void evaluate(ThreadPool &pool, uint32_t index) {
+		LineState &line = _lines[index];
+		if (!line._skipped.load(std::memory_order_relaxed)) {
+			try {
+				line._value = line._template->renderObject(LineResolver(*this, index), false);
+				if (line._kind == Kind::PROPERTY)
+					line._stored = Value::asString(line._value);
+			} catch (...) {
+				line._error = std::current_exception();
+			}
+		}
+
+		bool failed = line._error || line._skipped.load(std::memory_order_relaxed);
+		for (uint32_t dependent : line._dependents) {
+			if (failed)
+				_lines[dependent]._skipped.store(true, std::memory_order_relaxed);
+			if (_lines[dependent]._waiting.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				pool.submit([this, &pool, dependent] { evaluate(pool, dependent); });
+		}
+	}
+public:
+	ParallelLoad(ConfigProcessor &proc, std::vector<Line> const& lines)
+	:_proc(proc)
+	,_source(lines)
+	,_lines(lines.size()) {
+		// names each line defines, also indexed by their dotted prefixes: a reference
+		// to 'a' may end up looking up 'a.b' (see Value::member())
+		std::unordered_map<String, std::vector<uint32_t>> definitions;
+		for (uint32_t i = 0; i < (uint32_t)lines.size(); i++) {
+			LineState &line = _lines[i];
+			String const& name = lines[i]._name;
+			line._template = Template::compile(*lines[i]._value);
+			if (String::startsWith(CPtr(name), '@')) {
+				line._kind = Kind::VARIABLE;
+				line._name = String::substring(CPtr(name), 1);
+				_variables[line._name].push_back(i);
+			} else {
+				std::string sinkName, sinkEntry;
+				if (_proc.isSunk(name, sinkName, sinkEntry)) {
+					line._kind = Kind::SINK;
+					line._name = sinkEntry;
+					line._sinkName = sinkName;
+					continue;
+				}
+				line._name = name;
+				_properties[line._name].push_back(i);
+			}
+			definitions[line._name].push_back(i);
+			for (ptrdiff_t dot = String::indexOf(CPtr(line._name), '.'); dot > 0; dot = String::indexOf(CPtr(line._name), '.', (size_t)dot + 1))
+				definitions[String::substring(CPtr(line._name), 0, (size_t)dot)].push_back(i);
+		}
+
+		std::vector<uint32_t> marks(lines.size(), 0);
+		std::vector<SPtr<const String>> references;
+		// lines up to the last dynamic line are all done once it is
+		uint32_t barrierEnd = 0;
+		for (uint32_t i = 0; i < (uint32_t)lines.size(); i++) {
+			LineState &line = _lines[i];
+			auto dependOn = [&](uint32_t j) {
+				if (marks[j] != i + 1) {
+					marks[j] = i + 1;
+					_lines[j]._dependents.push_back(i);
+					line._waiting++;
+				}
+			};
+
+			references.clear();
+			if (!line._template->collectVariables(references)) {
+				// '$()' or '#()' may look up anything defined before
+				for (uint32_t j = (barrierEnd > 0) ? barrierEnd - 1 : 0; j < i; j++)
+					dependOn(j);
+				barrierEnd = i + 1;
+				continue;
+			}
+			for (SPtr<const String> const& reference : references) {
+				auto defs = definitions.find(*reference);
+				if (defs == definitions.end())
+					continue;
+				for (uint32_t j : defs->second) {
+					if (j >= i)
+						break;
+					dependOn(j);
+				}
+			}
+		}
+	}
+
+	void run(unsigned threads) {
+		// lines waiting for nothing, collected before any line runs and releases others
+		std::vector<uint32_t> ready;
+		for (uint32_t i = 0; i < (uint32_t)_lines.size(); i++) {
+			if (_lines[i]._waiting.load(std::memory_order_relaxed) == 0)
+				ready.push_back(i);
+		}
+
+		ThreadPool pool(std::min((size_t)threads, _lines.size()));
+		for (uint32_t i : ready)
+			pool.submit([this, &pool, i] { evaluate(pool, i); });
+		pool.wait();
+	}
+
+	/** Stores the results, as processLine() would have, stopping at the first error */
+	void apply(Properties &props) {
+		for (size_t i = 0; i < _lines.size(); i++) {
+			LineState &line = _lines[i];
+			// lines skipped after an error come after the line that failed
+			if (line._error)
+				std::rethrow_exception(line._error);
+			switch (line._kind) {
+				case Kind::VARIABLE:
+					if (!_proc._vars)
+						_proc._vars = std::make_unique<HashMap<String, Object>>();
+					_proc._vars->put(line._name, line._value);
+					break;
+				case Kind::SINK:
+					_proc.sink(line._sinkName, line._name, line._value);
+					break;
+				case Kind::PROPERTY:
+					if (line._stored)
+						props.put(_source[i]._name, line._stored);
+					break;
+			}
+		}
+	}
+};
+
+void ConfigProcessor::processLines(Properties &props, std::vector<Line> const& lines, unsigned threads) {
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if ((threads <= 1) || (lines.size() <= 1)) {
+		for (Line const& line : lines) {
+			UPtr<String> value = processLine(line._name, line._value);
+			if (value)
+				props.put(line._name, std::move(value));
+		}
+		return;
+	}
+
+	if (_sources) {
+		for (auto const& source : *_sources) {
+			if (!source.second->isInitialized())
+				source.second->init();
+		}
+	}
+
+	ParallelLoad load(*this, lines);
+	load.run(threads);
+	load.apply(props);
 }
 
 /*bool ConfigProcessor::containsKey(std::string const& name) const {
@@ -113,11 +365,14 @@ SPtr<Object> SimpleConfigProcessor::getVar(String const& name) const {
 	return false;
 }*/
 
+const size_t Config::PARALLEL_MIN_LINES;
+
 Config::Config(String const& confFileName, String const& appName)
 :_confFileName(confFileName)
 ,_appName(appName)
 ,_cfgProc(*this)
-,_simpleCfgProc(*this) {}
+,_simpleCfgProc(*this)
+,_loadThreads(1) {}
 
 SPtr<String> searchConfigFile(List<String> const& configDirs, String const& configFile) {
 	ConstIterator<SPtr<String>> i = configDirs.constIterator();
@@ -200,8 +455,11 @@ void Config::openConfigFile(bool minimal) {
 		FileInputStream propsFile(*configFile);
 		if (minimal)
 			load(propsFile, &_simpleCfgProc);
-		else
-			load(propsFile, &_cfgProc);
+		else {
+			ConfigProcessor::LineCollector lines;
+			load(propsFile, &lines);
+			_cfgProc.processLines(*this, lines.getLines(), (lines.getLines().size() >= PARALLEL_MIN_LINES) ? _loadThreads : 1);
+		}
 	} catch (IOException const& e) {
 		throw InitException(_HERE_, fmt::format("I/O error reading config file '{}': {}", *configFile, e.getMessage()).c_str());
 	}
@@ -17,12 +17,34 @@
 #include "fmt/format.h"
 
 #include <string>
+#include <vector>
 
 namespace slib {
 
 class ConfigProcessor : public Properties::LineProcessor, /*public ValueProvider<std::string, std::string>,*/ public expr::Resolver {
 public:
 	typedef std::function<void(String const&, SPtr<Object> const&)> PropertySink;
+
+	/** Raw property line, as read from a file */
+	struct Line {
+		String _name;
+		SPtr<String> _value;
+	};
+
+	/** Line processor that only collects the raw lines, for processLines() */
+	class LineCollector : public Properties::LineProcessor {
+	private:
+		std::vector<Line> _lines;
+	public:
+		virtual UPtr<String> processLine(String const& name, SPtr<String> const& rawProperty) override {
+			_lines.push_back({name, rawProperty});
+			return nullptr;
+		}
+
+		std::vector<Line> const& getLines() const {
+			return _lines;
+		}
+	};
 private:
 	typedef Map<String, Object> VarMap;
 
@@ -36,6 +58,18 @@ private:
 	UPtr<VarMap> _vars;
 	UPtr<SourceMap> _sources;
 	SinkMap _sinks;
+private:
+	class ParallelLoad;
+
+	/**
+	 * @param[out] sinkName  sink, if the property name has the form <code>sink[name]</code>
+	 * @param[out] name  name passed to the sink
+	 * @return <i>true</i> if the property goes to a registered sink
+	 */
+	bool isSunk(String const& propertyName, std::string &sinkName, std::string &name) const;
+
+	/** @return variable from a property source (<code>source.name</code>) */
+	SPtr<Object> getSourceVar(String const& name) const;
 public:
 	ConfigProcessor(Properties const& props)
 	:_props(props) {}
@@ -44,6 +78,21 @@ public:
 
 	virtual UPtr<String> processLine(String const& name, SPtr<String> const& rawProperty) override;
 
+	/**
+	 * Processes all the lines of a file, with the same results as passing them in turn to
+	 * processLine() and storing the non-null results. Lines are evaluated concurrently, each
+	 * one once the lines defining the properties and variables it references are done; lines
+	 * that look up variables by computed names (<code>$()</code>, <code>#()</code>) wait for
+	 * all the lines before them. Results are then stored, and sinks called, in file order,
+	 * on the calling thread. Property sources are initialized first, and must support
+	 * concurrent lookups.
+	 * @param props  the properties this processor was created for
+	 * @param lines  lines, in file order
+	 * @param threads  number of threads; 0 for one per CPU, 1 to process lines in turn
+	 * @throws EvaluationException  error of the first line that fails, as with processLine()
+	 */
+	void processLines(Properties &props, std::vector<Line> const& lines, unsigned threads);
+
 	void registerSource(String const& name, SPtr<PropertySource> const& src) {
 		if (!_sources)
 			_sources = std::make_unique<SourceMap>();
@@ -95,6 +144,8 @@ protected:
 
 	ConfigProcessor _cfgProc;
 	SimpleConfigProcessor _simpleCfgProc;
+	/** see setLoadThreads() */
+	unsigned _loadThreads;
 protected:
 	/** @throws InitException */
 	void openConfigFile(bool minimal);
@@ -142,6 +193,19 @@ public:
 public:
 	void registerPropertySource(String const& name, SPtr<PropertySource> const& src);
 	void registerPropertySink(String const& name, ConfigProcessor::PropertySink const& sink);
+
+	/**
+	 * Sets the number of threads evaluating the lines of config files with at least
+	 * PARALLEL_MIN_LINES lines (see ConfigProcessor::processLines()); smaller files are
+	 * always processed line by line. Parallel loading requires all registered property
+	 * sources to be thread-safe, and initializes them before any line is evaluated.
+	 * @param threads  0 for one per CPU, 1 to always process line by line (the default)
+	 */
+	void setLoadThreads(unsigned threads) {
+		_loadThreads = threads;
+	}
+
+	static const size_t PARALLEL_MIN_LINES = 256;
 public:
 	String const& getAppName() const { return _appName; }
 	SPtr<String> getHomeDir() const { return _homeDir; }
@@ -23,7 +23,7 @@ private:
 	PropertyMap _properties;
 	bool _initialized;
 protected:
-	void provideProperty(std::string const& name, GetProperty prop) {
+	void provideProperty(String const& name, GetProperty prop) {
 		_properties[name] = prop;
 	}
 public:
@@ -42,6 +42,10 @@ public:
 		_initialized = true;
 	}
 
+	bool isInitialized() const {
+		return _initialized;
+	}
+
 	virtual SPtr<Object> getVar(String const& name) const override;
 };
 
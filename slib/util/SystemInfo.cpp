@@ -10,10 +10,10 @@ extern slib::Log logger;
 namespace slib {
 
 SystemInfo::SystemInfo() {
-	provideProperty("hostname",	static_cast<GetProperty>(&SystemInfo::getHostname));
-	provideProperty("ip", 		static_cast<GetProperty>(&SystemInfo::getIp));
-	provideProperty("ipv4", 	static_cast<GetProperty>(&SystemInfo::getIpV4));
-	provideProperty("ipv6", 	static_cast<GetProperty>(&SystemInfo::getIpV6));
+	provideProperty("hostname"_HS,	static_cast<GetProperty>(&SystemInfo::getHostname));
+	provideProperty("ip"_HS, 		static_cast<GetProperty>(&SystemInfo::getIp));
+	provideProperty("ipv4"_HS, 	static_cast<GetProperty>(&SystemInfo::getIpV4));
+	provideProperty("ipv6"_HS, 	static_cast<GetProperty>(&SystemInfo::getIpV6));
 }
 
 static int getIPAddrs(SPtr<String>& ip, SPtr<String>& ipv4, SPtr<String>& ipv6) {
@@ -0,0 +1,90 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "slib/util/expr/Ast.h"
+
+namespace slib {
+namespace expr {
+namespace ast {
+
+Node::~Node() {}
+
+Literal::~Literal() {}
+
+Symbol::~Symbol() {}
+
+Unary::~Unary() {}
+
+Binary::~Binary() {
+	// frees a chain of left operands in a loop instead of through nested destructors; an
+	// operand still referenced elsewhere is freed by its last owner, the same way
+	NodePtr left = std::move(_left);
+	while (left && left->kind() == Kind::BINARY && left.use_count() == 1) {
+		Binary &operand = const_cast<Binary &>(static_cast<Binary const&>(*left));
+		left = NodePtr(std::move(operand._left));
+	}
+}
+
+constexpr int Binary::OP_LTE;
+constexpr int Binary::OP_GTE;
+constexpr int Binary::OP_EQ;
+constexpr int Binary::OP_NEQ;
+
+std::vector<Binary const*> Binary::chainOf(Binary const& binary) {
+	std::vector<Binary const*> chain;
+	Binary const* current = &binary;
+	while (true) {
+		chain.push_back(current);
+		if (current->_left->kind() != Kind::BINARY)
+			break;
+		current = static_cast<Binary const*>(current->_left.get());
+	}
+	std::reverse(chain.begin(), chain.end());
+	return chain;
+}
+
+Value Binary::apply(int op, Value const& left, Value const& right) {
+	switch (op) {
+		case '+':
+			return Value::add(left, right);
+		case '-':
+			return Value::subtract(left, right);
+		case '*':
+			return Value::multiply(left, right);
+		case '/':
+			return Value::divide(left, right);
+		case '%':
+			return Value::remainder(left, right);
+		case '&':
+			return Value::isTrue(left) ? right : left;
+		case '|':
+			return Value::isTrue(left) ? left : right;
+		case '<':
+			return Value((int32_t)Value::lt(left, right));
+		case OP_LTE:
+			return Value((int32_t)Value::lte(left, right));
+		case '>':
+			return Value((int32_t)Value::gt(left, right));
+		case OP_GTE:
+			return Value((int32_t)Value::gte(left, right));
+		case OP_EQ:
+			return Value((int32_t)Value::eq(left, right));
+		case OP_NEQ:
+			return Value((int32_t)!Value::eq(left, right));
+		default:
+			throw SyntaxErrorException(_HERE_, fmt::format("Unknown operator '{}'", (char)op).c_str());
+	}
+}
+
+Index::~Index() {}
+
+Member::~Member() {}
+
+Call::~Call() {}
+
+Error::~Error() {}
+
+} // namespace ast
+} // namespace expr
+} // namespace slib
@@ -0,0 +1,336 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_UTIL_EXPR_AST_H
+#define H_SLIB_UTIL_EXPR_AST_H
+
+#include "slib/util/expr/Value.h"
+#include "slib/util/expr/Expression.h"
+
+#include <algorithm>
+#include <vector>
+#include <exception>
+
+namespace slib {
+namespace expr {
+namespace ast {
+
+/**
+ * Node of a parsed expression. Nodes are immutable once built, and are evaluated by
+ * compiling them to a Program, with the semantics of the ExpressionEvaluator interpreter.
+ */
+class Node {
+public:
+	enum class Kind { LITERAL, SYMBOL, UNARY, BINARY, INDEX, MEMBER, CALL, ERROR };
+protected:
+	uint32_t _depth;
+
+	Node(uint32_t depth)
+	:_depth(depth) {}
+public:
+	virtual ~Node();
+
+	virtual Kind kind() const = 0;
+
+	/**
+	 * @return number of levels of the subtree rooted at this node; folding, compiling and
+	 *   freeing the subtree recurse this deep. A chain of binary operators (such as
+	 *   "a + b + c") is walked in a loop over its left operands, so it only counts as one level.
+	 */
+	uint32_t getDepth() const {
+		return _depth;
+	}
+};
+
+typedef SPtr<const Node> NodePtr;
+
+/** @return depth of a subtree, 0 if there is none */
+inline uint32_t depthOf(NodePtr const& node) {
+	return node ? node->getDepth() : 0;
+}
+
+/**
+ * Number or string literal, or the value of a subtree folded at compile time. A folded
+ * value that depends on builtins is only used while those builtins are not hidden by
+ * the resolver; otherwise the original subtree is evaluated.
+ */
+class Literal : public Node {
+public:
+	/** Builtin a folded value was computed from */
+	struct Assumption {
+		SPtr<const String> _name;
+		SPtr<Object> _value;
+	};
+private:
+	/** values are never modified after creation, so the same instance is returned every time */
+	SPtr<Value> _value;
+	std::vector<Assumption> _assumptions;
+	NodePtr _original;
+public:
+	Literal(SPtr<Object> const& value)
+	:Node(1)
+	,_value(Value::of(value)) {}
+
+	/**
+	 * Folded value
+	 * @param value  the value (boxed once here, if held inline)
+	 * @param assumptions  builtins the value depends on
+	 * @param original  subtree to evaluate when an assumption does not hold
+	 */
+	Literal(Value const& value, std::vector<Assumption> &&assumptions, NodePtr const& original)
+	:Node(depthOf(original) + 1)
+	,_value(Value::of(value.getValue(), value.getName()))
+	,_assumptions(std::move(assumptions))
+	,_original(original) {}
+
+	virtual ~Literal() override;
+
+	virtual Kind kind() const override {
+		return Kind::LITERAL;
+	}
+
+	SPtr<Object> getValue() const {
+		return _value->getValue();
+	}
+
+	Value const& getConstant() const {
+		return *_value;
+	}
+
+	std::vector<Assumption> const& getAssumptions() const {
+		return _assumptions;
+	}
+
+	NodePtr const& getOriginal() const {
+		return _original;
+	}
+};
+
+/** Variable reference, looked up in the resolver on each evaluation */
+class Symbol : public Node {
+private:
+	SPtr<const String> _name;
+public:
+	Symbol(SPtr<const String> const& name)
+	:Node(1)
+	,_name(name) {}
+
+	virtual ~Symbol() override;
+
+	virtual Kind kind() const override {
+		return Kind::SYMBOL;
+	}
+
+	SPtr<const String> const& getName() const {
+		return _name;
+	}
+};
+
+/** Prefix operator: '-' or '!' */
+class Unary : public Node {
+private:
+	char _op;
+	NodePtr _operand;
+public:
+	Unary(char op, NodePtr const& operand)
+	:Node(depthOf(operand) + 1)
+	,_op(op)
+	,_operand(operand) {}
+
+	virtual ~Unary() override;
+
+	virtual Kind kind() const override {
+		return Kind::UNARY;
+	}
+
+	char getOp() const {
+		return _op;
+	}
+
+	NodePtr const& getOperand() const {
+		return _operand;
+	}
+};
+
+/** Infix operator */
+class Binary : public Node {
+public:
+	// surrogate values for multi-char operators
+	static constexpr int OP_LTE = 500;
+	static constexpr int OP_GTE = 501;
+	static constexpr int OP_EQ = 502;
+	static constexpr int OP_NEQ = 503;
+private:
+	int _op;
+	NodePtr _left;
+	NodePtr _right;
+public:
+	Binary(int op, NodePtr const& left, NodePtr const& right)
+	:Node(std::max(depthOf(left), depthOf(right) + 1))
+	,_op(op)
+	,_left(left)
+	,_right(right) {}
+
+	virtual ~Binary() override;
+
+	virtual Kind kind() const override {
+		return Kind::BINARY;
+	}
+
+	int getOp() const {
+		return _op;
+	}
+
+	NodePtr const& getLeft() const {
+		return _left;
+	}
+
+	NodePtr const& getRight() const {
+		return _right;
+	}
+
+	/**
+	 * Lists the operators of a chain: <i>binary</i>, its left operand while that is a binary
+	 * operator too, and so on. Walking the chain in this order avoids recursing once per operator.
+	 * @return operators, innermost (leftmost) first; the left operand of the first one is not
+	 *   a binary operator
+	 */
+	static std::vector<Binary const*> chainOf(Binary const& binary);
+
+	/**
+	 * @return true if the left operand alone decides the result of the operator (and is the
+	 *   result), so the right operand must not be evaluated ('&' and '|' short-circuit)
+	 */
+	static bool shortCircuits(int op, Value const& left) {
+		return (op == '&' && !Value::isTrue(left)) || (op == '|' && Value::isTrue(left));
+	}
+
+	/**
+	 * Applies an infix operator to two evaluated operands
+	 * @throws EvaluationException
+	 */
+	static Value apply(int op, Value const& left, Value const& right);
+};
+
+/** Operator '[]' */
+class Index : public Node {
+private:
+	NodePtr _target;
+	NodePtr _index;
+public:
+	Index(NodePtr const& target, NodePtr const& index)
+	:Node(std::max(depthOf(target), depthOf(index)) + 1)
+	,_target(target)
+	,_index(index) {}
+
+	virtual ~Index() override;
+
+	virtual Kind kind() const override {
+		return Kind::INDEX;
+	}
+
+	NodePtr const& getTarget() const {
+		return _target;
+	}
+
+	NodePtr const& getIndex() const {
+		return _index;
+	}
+};
+
+/** Operator '.' */
+class Member : public Node {
+private:
+	NodePtr _target;
+	SPtr<const String> _name;
+public:
+	Member(NodePtr const& target, SPtr<const String> const& name)
+	:Node(depthOf(target) + 1)
+	,_target(target)
+	,_name(name) {}
+
+	virtual ~Member() override;
+
+	virtual Kind kind() const override {
+		return Kind::MEMBER;
+	}
+
+	NodePtr const& getTarget() const {
+		return _target;
+	}
+
+	SPtr<const String> const& getName() const {
+		return _name;
+	}
+};
+
+/**
+ * Function call. Whether an argument is evaluated before the call or passed
+ * unevaluated (as an Expression) depends on the function, so it is only known
+ * at run time; each argument is prepared both ways.
+ */
+class Call : public Node {
+public:
+	struct Arg {
+		/** node used when the argument is evaluated before the call */
+		NodePtr _eager;
+		/** expression passed to functions that take an Expression parameter */
+		SPtr<Expression> _lazy;
+	};
+private:
+	NodePtr _target;
+	std::vector<Arg> _args;
+public:
+	Call(NodePtr const& target, std::vector<Arg> &&args)
+	:Node(depthOf(target) + 1)
+	,_target(target)
+	,_args(std::move(args)) {
+		for (Arg const& arg : _args)
+			_depth = std::max(_depth, depthOf(arg._eager) + 1);
+	}
+
+	virtual ~Call() override;
+
+	virtual Kind kind() const override {
+		return Kind::CALL;
+	}
+
+	NodePtr const& getTarget() const {
+		return _target;
+	}
+
+	std::vector<Arg> const& getArgs() const {
+		return _args;
+	}
+};
+
+/**
+ * Placeholder for a part of the source that failed to parse. The error is only
+ * raised if the node is actually evaluated, as the interpreter would do for an
+ * argument that is never evaluated.
+ */
+class Error : public Node {
+private:
+	std::exception_ptr _error;
+public:
+	Error(std::exception_ptr const& error)
+	:Node(1)
+	,_error(error) {}
+
+	virtual ~Error() override;
+
+	virtual Kind kind() const override {
+		return Kind::ERROR;
+	}
+
+	std::exception_ptr const& getError() const {
+		return _error;
+	}
+};
+
+} // namespace ast
+} // namespace expr
+} // namespace slib
+
+#endif // H_SLIB_UTIL_EXPR_AST_H
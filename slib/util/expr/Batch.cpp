@@ -0,0 +1,558 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "slib/util/expr/Batch.h"
+#include "slib/util/expr/ExpressionEvaluator.h"
+#include "slib/exception/IllegalArgumentException.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace slib {
+namespace expr {
+
+using namespace ast;
+
+namespace {
+
+/** Raised when part of an expression can only be evaluated one row at a time */
+struct NotVectorizable {};
+
+bool isVectorizable(Node const& node) {
+	switch (node.kind()) {
+		case Node::Kind::LITERAL:
+		case Node::Kind::SYMBOL:
+			return true;
+		case Node::Kind::UNARY:
+			return isVectorizable(*static_cast<Unary const&>(node).getOperand());
+		case Node::Kind::BINARY:
+			{
+				std::vector<Binary const*> chain = Binary::chainOf(static_cast<Binary const&>(node));
+				for (Binary const* binary : chain)
+					if (!isVectorizable(*binary->getRight()))
+						return false;
+				return isVectorizable(*chain[0]->getLeft());
+			}
+		default:
+			return false;
+	}
+}
+
+/**
+ * Applies a numeric operation to every row; one of the operands may be the same for all rows.
+ * Kept to a plain loop over contiguous arrays, so that the compiler can vectorize it.
+ */
+template <class F>
+void applyNumeric(double const* left, double leftScalar, double const* right, double rightScalar, double *out, size_t n, F f) {
+	if (left && right) {
+		for (size_t i = 0; i < n; i++)
+			out[i] = f(left[i], right[i]);
+	} else if (left) {
+		for (size_t i = 0; i < n; i++)
+			out[i] = f(left[i], rightScalar);
+	} else {
+		for (size_t i = 0; i < n; i++)
+			out[i] = f(leftScalar, right[i]);
+	}
+}
+
+} // namespace
+
+/** Resolver for one row, used for expressions that cannot be evaluated by column */
+class Batch::RowResolver : public Resolver {
+private:
+	Batch const& _batch;
+	Resolver const& _resolver;
+	size_t _row;
+public:
+	RowResolver(Batch const& batch, Resolver const& resolver)
+	:_batch(batch)
+	,_resolver(resolver)
+	,_row(0) {}
+
+	void setRow(size_t row) {
+		_row = row;
+	}
+
+	virtual SPtr<Object> getVar(String const& key) const override {
+		Column const* column = _batch.getColumn(key);
+		if (!column)
+			return _resolver.getVar(key);
+		switch (column->_type) {
+			case ColumnType::INTEGER:
+				return std::make_shared<Integer>((int32_t)column->_longs[_row]);
+			case ColumnType::LONG:
+				return std::make_shared<Long>(column->_longs[_row]);
+			case ColumnType::DOUBLE:
+				return std::make_shared<Double>(column->_doubles[_row]);
+			default:
+				return column->_strings[_row];
+		}
+	}
+};
+
+/** Evaluates a syntax tree over all rows at once */
+class Batch::Evaluator {
+public:
+	/** Intermediate result */
+	struct Operand {
+		enum class Kind {
+			SCALAR,		///< same value for all rows, in _scalar
+			COLUMN,		///< values of _column
+			NUMBERS,	///< numbers in _numbers, of type _type (INTEGER or DOUBLE)
+			VALUES		///< values in _values
+		};
+
+		Kind _kind;
+		Value _scalar;
+		Column const* _column;
+		std::vector<double> _numbers;
+		Value::Type _type;
+		std::vector<Value> _values;
+
+		Operand(Kind kind)
+		:_kind(kind)
+		,_column(nullptr)
+		,_type(Value::Type::DOUBLE) {}
+	};
+private:
+	Batch const& _batch;
+	ExpressionEvaluator::InternalResolver _resolver;
+	/** rows being evaluated */
+	size_t _begin;
+	size_t _rows;
+
+	static Operand scalar(Value const& value) {
+		Operand result(Operand::Kind::SCALAR);
+		result._scalar = value;
+		return result;
+	}
+
+	static Operand numbers(size_t rows, Value::Type type) {
+		Operand result(Operand::Kind::NUMBERS);
+		result._numbers.resize(rows);
+		result._type = type;
+		return result;
+	}
+
+	/**
+	 * Numbers of a per-row operand
+	 * @param tmp  receives integers converted to double
+	 * @return <code>nullptr</code> if the operand is not numeric, or the same for all rows
+	 */
+	double const* numbersOf(Operand const& operand, std::vector<double> &tmp) const {
+		if (operand._kind == Operand::Kind::NUMBERS)
+			return operand._numbers.data();
+		if (operand._kind != Operand::Kind::COLUMN)
+			return nullptr;
+		Column const& column = *operand._column;
+		switch (column._type) {
+			case ColumnType::DOUBLE:
+				return column._doubles.data() + _begin;
+			case ColumnType::INTEGER:
+			case ColumnType::LONG:
+				tmp.resize(_rows);
+				for (size_t i = 0; i < _rows; i++)
+					tmp[i] = (double)column._longs[_begin + i];
+				return tmp.data();
+			default:
+				return nullptr;
+		}
+	}
+
+	/** @return type of the values of a numeric operand */
+	static Value::Type typeOf(Operand const& operand) {
+		switch (operand._kind) {
+			case Operand::Kind::SCALAR:
+				return operand._scalar.getType();
+			case Operand::Kind::COLUMN:
+				switch (operand._column->_type) {
+					case ColumnType::INTEGER:
+						return Value::Type::INTEGER;
+					case ColumnType::LONG:
+						return Value::Type::LONG;
+					default:
+						return Value::Type::DOUBLE;
+				}
+			default:
+				return operand._type;
+		}
+	}
+
+	static bool isStringOrNil(Value const& value) {
+		return value.isNil() || ((value.getType() == Value::Type::OBJECT) && instanceof<BasicString>(value.getValue()));
+	}
+
+	/** @throws EvaluationException */
+	Operand generic(Operand const& operand, int op) const {
+		Operand result(Operand::Kind::VALUES);
+		result._values.reserve(_rows);
+		for (size_t i = 0; i < _rows; i++) {
+			Value value = rowValue(operand, i);
+			result._values.push_back((op == '-') ? Value::inverse(value) : Value::logicalNegate(value));
+		}
+		return result;
+	}
+
+	/** @throws EvaluationException */
+	Operand generic(int op, Operand const& left, Operand const& right) const {
+		Operand result(Operand::Kind::VALUES);
+		result._values.reserve(_rows);
+		for (size_t i = 0; i < _rows; i++)
+			result._values.push_back(Binary::apply(op, rowValue(left, i), rowValue(right, i)));
+		return result;
+	}
+
+	/** @throws EvaluationException */
+	Operand literal(Literal const& node) const {
+		for (Literal::Assumption const& assumption : node.getAssumptions()) {
+			if (_batch.getColumn(*assumption._name) || (_resolver.getVar(*assumption._name) != assumption._value)) {
+				if (!isVectorizable(*node.getOriginal()))
+					throw NotVectorizable();
+				return eval(*node.getOriginal());
+			}
+		}
+		return scalar(node.getConstant());
+	}
+
+	/** @throws EvaluationException */
+	Operand symbol(Symbol const& node) const {
+		SPtr<const String> const& name = node.getName();
+		Column const* column = _batch.getColumn(*name);
+		if (!column)
+			return scalar(Value(_resolver.getVar(*name), name));
+		Operand result(Operand::Kind::COLUMN);
+		result._column = column;
+		return result;
+	}
+
+	/** @throws EvaluationException */
+	Operand unary(Unary const& node) const {
+		Operand operand = eval(*node.getOperand());
+		if (operand._kind == Operand::Kind::SCALAR)
+			return scalar((node.getOp() == '-') ? Value::inverse(operand._scalar) : Value::logicalNegate(operand._scalar));
+
+		std::vector<double> tmp;
+		double const* in = numbersOf(operand, tmp);
+		if (!in)
+			return generic(operand, node.getOp());
+
+		if (node.getOp() == '-') {
+			Operand result = numbers(_rows, Value::Type::DOUBLE);
+			double *out = result._numbers.data();
+			for (size_t i = 0; i < _rows; i++)
+				out[i] = -in[i];
+			return result;
+		}
+		Operand result = numbers(_rows, Value::Type::INTEGER);
+		double *out = result._numbers.data();
+		for (size_t i = 0; i < _rows; i++)
+			out[i] = (in[i] == 0) ? 1 : 0;
+		return result;
+	}
+
+	/** String equality, for a string column against another one, a string or nil */
+	bool stringEquality(int op, Operand const& left, Operand const& right, Operand &result) const {
+		Operand const* column = &left;
+		Operand const* other = &right;
+		if (!((left._kind == Operand::Kind::COLUMN) && (left._column->_type == ColumnType::STRING))) {
+			column = &right;
+			other = &left;
+		}
+		if (!((column->_kind == Operand::Kind::COLUMN) && (column->_column->_type == ColumnType::STRING)))
+			return false;
+
+		SPtr<String> const* strings = column->_column->_strings.data() + _begin;
+		double match = (op == Binary::OP_EQ) ? 1 : 0;
+		result = numbers(_rows, Value::Type::INTEGER);
+		double *out = result._numbers.data();
+
+		if ((other->_kind == Operand::Kind::COLUMN) && (other->_column->_type == ColumnType::STRING)) {
+			SPtr<String> const* others = other->_column->_strings.data() + _begin;
+			for (size_t i = 0; i < _rows; i++) {
+				bool eq = (strings[i] && others[i]) ? strings[i]->equals(*others[i]) : (!strings[i] && !others[i]);
+				out[i] = eq ? match : 1 - match;
+			}
+			return true;
+		}
+
+		if ((other->_kind != Operand::Kind::SCALAR) || !isStringOrNil(other->_scalar))
+			return false;
+
+		if (other->_scalar.isNil()) {
+			for (size_t i = 0; i < _rows; i++)
+				out[i] = strings[i] ? 1 - match : match;
+			return true;
+		}
+		// same as BasicString::equals(), with the constant side looked at only once
+		SPtr<BasicString> value = Class::cast<BasicString>(other->_scalar.getValue());
+		const char *buffer = value->c_str();
+		if (!buffer)
+			return false;
+		size_t len = value->length();
+		for (size_t i = 0; i < _rows; i++) {
+			String const* str = strings[i].get();
+			bool eq = str && (str->length() == len) && str->c_str() && (!strcmp(str->c_str(), buffer));
+			out[i] = eq ? match : 1 - match;
+		}
+		return true;
+	}
+
+	/**
+	 * Evaluates a chain of binary operators, one operator at a time from the innermost one
+	 * @throws EvaluationException
+	 */
+	Operand binary(Binary const& node) const {
+		std::vector<Binary const*> chain = Binary::chainOf(node);
+		Operand result = eval(*chain[0]->getLeft());
+		for (Binary const* binary : chain)
+			result = apply(binary->getOp(), result, eval(*binary->getRight()));
+		return result;
+	}
+
+	/** @throws EvaluationException */
+	Operand apply(int op, Operand const& left, Operand const& right) const {
+
+		if ((left._kind == Operand::Kind::SCALAR) && (right._kind == Operand::Kind::SCALAR))
+			return scalar(Binary::apply(op, left._scalar, right._scalar));
+
+		if ((op == Binary::OP_EQ) || (op == Binary::OP_NEQ)) {
+			Operand result(Operand::Kind::NUMBERS);
+			if (stringEquality(op, left, right, result))
+				return result;
+		}
+
+		std::vector<double> leftTmp, rightTmp;
+		double leftScalar = 0, rightScalar = 0;
+		double const* l = numbersOf(left, leftTmp);
+		double const* r = numbersOf(right, rightTmp);
+		bool isNumeric = (l || ((left._kind == Operand::Kind::SCALAR) && left._scalar.numberValue(leftScalar))) &&
+					   (r || ((right._kind == Operand::Kind::SCALAR) && right._scalar.numberValue(rightScalar)));
+		if (!isNumeric)
+			return generic(op, left, right);
+
+		Value::Type resultType = Value::Type::INTEGER;
+		if ((op == '&') || (op == '|')) {
+			// one of the operands is the result, so the result type is only known if both agree
+			resultType = typeOf(left);
+			if ((resultType != typeOf(right)) || ((resultType != Value::Type::INTEGER) && (resultType != Value::Type::DOUBLE)))
+				return generic(op, left, right);
+		} else if ((op == '+') || (op == '-') || (op == '*') || (op == '/') || (op == '%'))
+			resultType = Value::Type::DOUBLE;
+
+		Operand result = numbers(_rows, resultType);
+		double *out = result._numbers.data();
+		switch (op) {
+			case '+':
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return a + b; });
+				break;
+			case '-':
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return a - b; });
+				break;
+			case '*':
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return a * b; });
+				break;
+			case '/':
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return a / b; });
+				break;
+			case '%':
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return std::fmod(a, b); });
+				break;
+			case '&':
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return (a != 0) ? b : a; });
+				break;
+			case '|':
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return (a != 0) ? a : b; });
+				break;
+			case '<':
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return (double)(a < b); });
+				break;
+			case Binary::OP_LTE:
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return (double)(a <= b); });
+				break;
+			case '>':
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return (double)(a > b); });
+				break;
+			case Binary::OP_GTE:
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return (double)(a >= b); });
+				break;
+			case Binary::OP_EQ:
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return (double)(a == b); });
+				break;
+			case Binary::OP_NEQ:
+				applyNumeric(l, leftScalar, r, rightScalar, out, _rows, [](double a, double b) { return (double)(a != b); });
+				break;
+			default:
+				return generic(op, left, right);
+		}
+		return result;
+	}
+public:
+	Evaluator(Batch const& batch, Resolver const& resolver)
+	:_batch(batch)
+	,_resolver(resolver)
+	,_begin(0)
+	,_rows(0) {}
+
+	void setRange(size_t begin, size_t rows) {
+		_begin = begin;
+		_rows = rows;
+	}
+
+	/**
+	 * @throws EvaluationException
+	 * @throws NotVectorizable
+	 */
+	Operand eval(Node const& node) const {
+		switch (node.kind()) {
+			case Node::Kind::LITERAL:
+				return literal(static_cast<Literal const&>(node));
+			case Node::Kind::SYMBOL:
+				return symbol(static_cast<Symbol const&>(node));
+			case Node::Kind::UNARY:
+				return unary(static_cast<Unary const&>(node));
+			case Node::Kind::BINARY:
+				return binary(static_cast<Binary const&>(node));
+			default:
+				throw NotVectorizable();
+		}
+	}
+
+	/** @param row  row number, relative to the range being evaluated */
+	Value rowValue(Operand const& operand, size_t row) const {
+		switch (operand._kind) {
+			case Operand::Kind::SCALAR:
+				return operand._scalar;
+			case Operand::Kind::NUMBERS:
+				if (operand._type == Value::Type::INTEGER)
+					return Value((int32_t)operand._numbers[row]);
+				return Value(operand._numbers[row]);
+			case Operand::Kind::VALUES:
+				return operand._values[row];
+			default:
+				break;
+		}
+		Column const& column = *operand._column;
+		switch (column._type) {
+			case ColumnType::INTEGER:
+				return Value((int32_t)column._longs[_begin + row]);
+			case ColumnType::LONG:
+				return Value(column._longs[_begin + row]);
+			case ColumnType::DOUBLE:
+				return Value(column._doubles[_begin + row]);
+			default:
+				return Value(column._strings[_begin + row], column._name);
+		}
+	}
+
+	/** Writes the truth value of each row in the range being evaluated */
+	void truthValues(Operand const& operand, uint8_t *out) const {
+		std::vector<double> tmp;
+		if (double const* in = numbersOf(operand, tmp)) {
+			for (size_t i = 0; i < _rows; i++)
+				out[i] = (in[i] != 0);
+		} else if (operand._kind == Operand::Kind::SCALAR) {
+			bool truth = Value::isTrue(operand._scalar);
+			for (size_t i = 0; i < _rows; i++)
+				out[i] = truth;
+		} else {
+			for (size_t i = 0; i < _rows; i++)
+				out[i] = Value::isTrue(rowValue(operand, i));
+		}
+	}
+};
+
+const size_t Batch::CHUNK_SIZE;
+
+Batch::Column& Batch::newColumn(String const& name, ColumnType type, size_t size) {
+	if (size != _rows)
+		throw IllegalArgumentException(_HERE_, fmt::format("Column '{}' has {} values, expected {}", name, size, _rows).c_str());
+	Column &column = _columns[name];
+	column._type = type;
+	column._longs.clear();
+	column._doubles.clear();
+	column._strings.clear();
+	column._name = std::make_shared<const String>(name);
+	return column;
+}
+
+void Batch::addColumn(String const& name, std::vector<int32_t> const& values) {
+	Column &column = newColumn(name, ColumnType::INTEGER, values.size());
+	column._longs.assign(values.begin(), values.end());
+}
+
+void Batch::addColumn(String const& name, std::vector<int64_t> values) {
+	Column &column = newColumn(name, ColumnType::LONG, values.size());
+	column._longs = std::move(values);
+}
+
+void Batch::addColumn(String const& name, std::vector<double> values) {
+	Column &column = newColumn(name, ColumnType::DOUBLE, values.size());
+	column._doubles = std::move(values);
+}
+
+void Batch::addColumn(String const& name, std::vector<SPtr<String>> values) {
+	Column &column = newColumn(name, ColumnType::STRING, values.size());
+	column._strings = std::move(values);
+}
+
+std::vector<Value> Batch::evaluateRows(CompiledExpression const& expr, Resolver const& resolver) const {
+	RowResolver rowResolver(*this, resolver);
+	ExpressionEvaluator::InternalResolver internalResolver(rowResolver);
+	std::vector<Value> values;
+	values.reserve(_rows);
+	for (size_t i = 0; i < _rows; i++) {
+		rowResolver.setRow(i);
+		values.push_back(expr.getProgram()->execute(internalResolver));
+	}
+	return values;
+}
+
+std::vector<Value> Batch::evaluate(CompiledExpression const& expr, Resolver const& resolver) const {
+	if (isVectorizable(*expr.getFoldedRoot())) {
+		// any error is raised again by the row that causes it, as row by row evaluation
+		// may not even evaluate the failing operand ('&', '|')
+		try {
+			Evaluator evaluator(*this, resolver);
+			std::vector<Value> values;
+			values.reserve(_rows);
+			for (size_t begin = 0; begin < _rows; begin += CHUNK_SIZE) {
+				size_t rows = std::min(CHUNK_SIZE, _rows - begin);
+				evaluator.setRange(begin, rows);
+				Evaluator::Operand result = evaluator.eval(*expr.getFoldedRoot());
+				for (size_t i = 0; i < rows; i++)
+					values.push_back(evaluator.rowValue(result, i));
+			}
+			return values;
+		} catch (EvaluationException const&) {
+		} catch (NotVectorizable const&) {
+		}
+	}
+	return evaluateRows(expr, resolver);
+}
+
+std::vector<uint8_t> Batch::select(CompiledExpression const& expr, Resolver const& resolver) const {
+	std::vector<uint8_t> selected(_rows);
+	if (isVectorizable(*expr.getFoldedRoot())) {
+		try {
+			Evaluator evaluator(*this, resolver);
+			for (size_t begin = 0; begin < _rows; begin += CHUNK_SIZE) {
+				size_t rows = std::min(CHUNK_SIZE, _rows - begin);
+				evaluator.setRange(begin, rows);
+				evaluator.truthValues(evaluator.eval(*expr.getFoldedRoot()), selected.data() + begin);
+			}
+			return selected;
+		} catch (EvaluationException const&) {
+		} catch (NotVectorizable const&) {
+		}
+	}
+	std::vector<Value> values = evaluateRows(expr, resolver);
+	for (size_t i = 0; i < _rows; i++)
+		selected[i] = Value::isTrue(values[i]);
+	return selected;
+}
+
+} // namespace expr
+} // namespace slib
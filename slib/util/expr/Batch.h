@@ -0,0 +1,114 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_UTIL_EXPR_BATCH_H
+#define H_SLIB_UTIL_EXPR_BATCH_H
+
+#include "slib/util/expr/CompiledExpression.h"
+#include "slib/exception/IllegalArgumentException.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace slib {
+namespace expr {
+
+/**
+ * Set of records stored by column, for evaluating one expression over all of them at once.
+ * Variables named after a column take the value of the column in each row; all other
+ * variables are looked up once per batch, in a resolver shared by all rows.
+ *
+ * Arithmetic, comparisons, '!', '&' and '|' over numeric columns run as simple loops over
+ * contiguous arrays, which the compiler vectorizes; equality against string columns is
+ * computed without boxing. Expressions that use function calls, members or indexes, or
+ * whose operands are of types these loops do not handle, are evaluated one row at a time,
+ * with the same results and errors as CompiledExpression::evaluate() on each row.
+ *
+ * Precedence is that of the expression parser: '*', '/' and '%' bind tighter than all
+ * other binary operators, which share one level and associate left to right. So
+ * <code>price * qty > limit</code> needs no parentheses, but a conjunction of comparisons
+ * does: <code>(price * qty > limit) & (region == 'eu')</code>.
+ */
+class Batch {
+public:
+	enum class ColumnType : uint8_t {
+		INTEGER,	///< Integer values
+		LONG,		///< Long values
+		DOUBLE,		///< Double values
+		STRING		///< String values; nullptr is nil
+	};
+private:
+	struct Column {
+		ColumnType _type;
+		/** INTEGER, LONG */
+		std::vector<int64_t> _longs;
+		/** DOUBLE */
+		std::vector<double> _doubles;
+		/** STRING */
+		std::vector<SPtr<String>> _strings;
+		SPtr<const String> _name;
+	};
+
+	class Evaluator;
+	class RowResolver;
+
+	size_t _rows;
+	std::unordered_map<String, Column> _columns;
+
+	/** @throws IllegalArgumentException if the number of values is not the number of rows */
+	Column& newColumn(String const& name, ColumnType type, size_t size);
+
+	Column const* getColumn(String const& name) const {
+		auto i = _columns.find(name);
+		return (i == _columns.end()) ? nullptr : &i->second;
+	}
+
+	/** @throws EvaluationException */
+	std::vector<Value> evaluateRows(CompiledExpression const& expr, Resolver const& resolver) const;
+public:
+	/** Rows evaluated together; intermediate results for a chunk stay in cache */
+	static const size_t CHUNK_SIZE = 1024;
+
+	Batch(size_t rows)
+	:_rows(rows) {}
+
+	size_t rows() const {
+		return _rows;
+	}
+
+	/** @throws IllegalArgumentException if the number of values is not the number of rows */
+	void addColumn(String const& name, std::vector<int32_t> const& values);
+
+	/** @throws IllegalArgumentException if the number of values is not the number of rows */
+	void addColumn(String const& name, std::vector<int64_t> values);
+
+	/** @throws IllegalArgumentException if the number of values is not the number of rows */
+	void addColumn(String const& name, std::vector<double> values);
+
+	/** @throws IllegalArgumentException if the number of values is not the number of rows */
+	void addColumn(String const& name, std::vector<SPtr<String>> values);
+
+	/**
+	 * Evaluates an expression for every row, as CompiledExpression::evaluate() would
+	 * @param expr  compiled expression
+	 * @param resolver  resolver for variables that are not columns (builtins are available)
+	 * @return one value per row
+	 * @throws EvaluationException raised by the first row that fails
+	 */
+	std::vector<Value> evaluate(CompiledExpression const& expr, Resolver const& resolver) const;
+
+	/**
+	 * Evaluates a condition for every row
+	 * @param expr  compiled expression
+	 * @param resolver  resolver for variables that are not columns (builtins are available)
+	 * @return one element per row, 1 if the condition is true (Value::isTrue()), 0 otherwise
+	 * @throws EvaluationException raised by the first row that fails
+	 */
+	std::vector<uint8_t> select(CompiledExpression const& expr, Resolver const& resolver) const;
+};
+
+} // namespace expr
+} // namespace slib
+
+#endif // H_SLIB_UTIL_EXPR_BATCH_H
@@ -5,40 +5,88 @@
 #include "slib/util/expr/ExpressionEvaluator.h"
 #include "slib/util/expr/Function.h"
 #include "slib/util/expr/ExpressionFormatter.h"
+#include "slib/util/expr/Profiler.h"
 
 #include <cmath>
 
 namespace slib {
 namespace expr {
 
+/**
+ * Result of a for() loop: the values of the body, added up as Value::add() would, except that
+ * strings are appended to a single builder instead of being copied on every iteration
+ */
+class LoopAccumulator {
+private:
+	Value _value;
+	UPtr<StringBuilder> _text;
+
+	static bool isString(Value const& v) {
+		return (v.getType() == Value::Type::OBJECT) && instanceof<BasicString>(v.getValue());
+	}
+public:
+	/** @throws EvaluationException */
+	void add(Value const& v) {
+		if (_text) {
+			if (isString(v)) {
+				BasicString const* str = Class::castPtr<BasicString>(v.getValue());
+				EvaluationContext::checkStringLength(_text->length() + str->length());
+				*_text += *str;
+				return;
+			}
+			// let Value::add() report the error
+			_value = Value(_text->toString());
+			_text = nullptr;
+		} else if (_value.isNil()) {
+			_value = v;
+			return;
+		} else if (isString(_value) && isString(v)) {
+			BasicString const* first = Class::castPtr<BasicString>(_value.getValue());
+			BasicString const* str = Class::castPtr<BasicString>(v.getValue());
+			EvaluationContext::checkStringLength(first->length() + str->length());
+			_text = std::make_unique<StringBuilder>(*first);
+			*_text += *str;
+			return;
+		}
+		_value = Value::add(_value, v);
+	}
+
+	SPtr<Value> get() const {
+		if (_text)
+			return std::make_shared<Value>(_text->toString());
+		return std::make_shared<Value>(_value);
+	}
+};
+
+/** Builtin table under construction; frozen into ExpressionEvaluator::_builtins */
 class Builtins : public HashMap<String, Object> {
 public:
 	Builtins() {
 		// constants
-		put("true", std::make_shared<Boolean>(true));
-		put("false", std::make_shared<Boolean>(false));
-		put("nil", nullptr);
+		put("true"_HS, std::make_shared<Boolean>(true));
+		put("false"_HS, std::make_shared<Boolean>(false));
+		put("nil"_HS, nullptr);
 
-		SPtr<Map<String, Object>> math = std::make_shared<HashMap<String, Object>>();
-		put("math", math);
+		HashMap<String, Object> math;
 
-		math->put("ceil", Function::impl<Double>(
-			[](Resolver const& /* resolver */, ArgList const& args) {
-				return Value::of(std::make_shared<Double>(ceil(args.get<Double>(0)->doubleValue())));
+		math.put("ceil"_HS, Function::pureImpl<Double>(
+			[](double d) {
+				return ceil(d);
 			}
 		));
-		math->put("floor", Function::impl<Double>(
-			[](Resolver const& /* resolver */, ArgList const& args) {
-				return Value::of(std::make_shared<Double>(floor(args.get<Double>(0)->doubleValue())));
+		math.put("floor"_HS, Function::pureImpl<Double>(
+			[](double d) {
+				return floor(d);
 			}
 		));
-		math->put("abs", Function::impl<Double>(
-			[](Resolver const& /* resolver */, ArgList const& args) {
-				return Value::of(std::make_shared<Double>(abs(args.get<Double>(0)->doubleValue())));
+		math.put("abs"_HS, Function::pureImpl<Double>(
+			[](double d) {
+				return fabs(d);
 			}
 		));
+		put("math"_HS, std::make_shared<FrozenMap<String, Object>>(math));
 
-		put("format", Function::impl<String>(
+		put("format"_HS, Function::impl<String>(
 			[](Resolver const& resolver, ArgList const& args) {
 				StringBuilder result;
 				ExpressionFormatter::format(result, args, resolver);
@@ -46,7 +94,7 @@ public:
 			}
 		));
 
-		put("if", Function::impl<Object, Expression, Expression>(
+		put("if"_HS, Function::impl<Object, Expression, Expression>(
 			[](Resolver const& resolver, ArgList const& args) {
 				bool val = Value::isTrue(args.getNullable(0));
 				if (val)
@@ -60,7 +108,7 @@ public:
 			}
 		));
 
-		put("for", Function::impl<String, Object, Expression, Expression, Expression>(
+		put("for"_HS, Function::impl<String, Object, Expression, Expression, Expression>(
 			[](Resolver const& resolver, ArgList const& args) {
 				size_t nArgs = args.size();
 				if (nArgs == 5) {
@@ -74,23 +122,15 @@ public:
 					ExpressionEvaluator::LoopResolver loopResolver(loopVarName, resolver);
 					loopResolver.setVar(initialValue);
 
-					SPtr<Value> finalValue = Value::Nil();
-					bool cond = true;
-
-					while (cond) {
-						SPtr<Value> condValue = condExpression->evaluate(loopResolver);
-						if (!Value::isTrue(condValue))
-							break;
-						SPtr<Value> exprValue = evalExpression->evaluate(loopResolver);
-						if (finalValue->isNil())
-							finalValue = exprValue;
-						else
-							finalValue = finalValue->add(exprValue);
-						SPtr<Value> updatedValue = updateExpression->evaluate(loopResolver);
-						loopResolver.setVar(updatedValue->getValue());
+					LoopAccumulator finalValue;
+
+					while (Value::isTrue(condExpression->execute(loopResolver))) {
+						EvaluationContext::step();
+						finalValue.add(evalExpression->execute(loopResolver));
+						loopResolver.setVar(updateExpression->execute(loopResolver).getValue());
 					}
 
-					return finalValue;
+					return finalValue.get();
 				} else if (nArgs == 3) {
 					// generic "for"
 					SPtr<String> loopVarName = args.get<String>(0);
@@ -100,22 +140,18 @@ public:
 
 						ExpressionEvaluator::LoopResolver loopResolver(loopVarName, resolver);
 
-						SPtr<Value> finalValue = Value::Nil();
+						LoopAccumulator finalValue;
 
 						ConstIterable<Object> *i = Class::castPtr<ConstIterable<Object>>(iterable);
 						ConstIterator<SPtr<Object>> iter = i->constIterator();
 						while (iter.hasNext()) {
+							EvaluationContext::step();
 							SPtr<Object> val = iter.next();
 							loopResolver.setVar(val);
-
-							SPtr<Value> exprValue = evalExpression->evaluate(loopResolver);
-							if (finalValue->isNil())
-								finalValue = exprValue;
-							else
-								finalValue = finalValue->add(exprValue);
+							finalValue.add(evalExpression->execute(loopResolver));
 						}
 
-						return finalValue;
+						return finalValue.get();
 					} else
 						throw EvaluationException(_HERE_, "generic for(): second argument is not iterable");
 				} else
@@ -123,15 +159,16 @@ public:
 			}
 		));
 
-		put("$", Function::impl<String>(
+		put("$"_HS, Function::impl<String>(
 			[](Resolver const& resolver, ArgList const& args) {
 				SPtr<String> varName = args.get<String>(0);
+				Profiler::lookup();
 				SPtr<Object> value = resolver.getVar(*varName);
 				return value ? Value::of(value, varName) : Value::Nil(varName);
 			}
 		));
 
-		put("#", Function::impl<String>(
+		put("#"_HS, Function::impl<String>(
 			[](Resolver const& resolver, ArgList const& args) {
 				return ExpressionEvaluator::expressionValue(std::make_shared<ExpressionInputStream>(args.get<String>(0)), resolver);
 			}
@@ -143,7 +180,7 @@ public:
 
 Builtins::~Builtins() {}
 
-UPtr<Map<String, Object>> ExpressionEvaluator::_builtins = std::make_unique<Builtins>();
+UPtr<const FrozenMap<String, Object>> ExpressionEvaluator::_builtins = std::make_unique<FrozenMap<String, Object>>(Builtins());
 
 } // namespace expr
 } // namespace slib
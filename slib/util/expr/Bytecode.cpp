@@ -0,0 +1,553 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "slib/util/expr/Bytecode.h"
+#include "slib/util/expr/ExpressionEvaluator.h"
+#include "slib/util/expr/Function.h"
+#include "slib/util/expr/Profiler.h"
+#include "slib/lang/StringPool.h"
+
+#include <algorithm>
+#include <new>
+#include <type_traits>
+
+namespace slib {
+namespace expr {
+
+using namespace ast;
+
+/** Stack and slot space available without heap allocation */
+static const size_t _LOCAL_SIZE = 16;
+/** Nested calls tracked without heap allocation */
+static const size_t _LOCAL_CALLS = 4;
+
+class Program::Compiler {
+private:
+	Program &_program;
+	size_t _depth;
+	/** calls in progress */
+	size_t _calls;
+public:
+	Compiler(Program &program)
+	:_program(program)
+	,_depth(0)
+	,_calls(0) {}
+
+	size_t here() const {
+		return _program._code.size();
+	}
+
+	/** Emits an instruction, adjusting the stack depth by <i>delta</i> */
+	size_t emit(Opcode op, int delta, uint32_t a = 0, uint32_t b = 0) {
+		_program._code.push_back({op, a, b});
+		_depth += delta;
+		if (_depth > _program._maxStack)
+			_program._maxStack = _depth;
+		return _program._code.size() - 1;
+	}
+
+	void patch(size_t insn) {
+		Opcode op = _program._code[insn]._op;
+		if (op == Opcode::IF_BUILTIN || op == Opcode::GUARD || op == Opcode::ARG_LAZY)
+			_program._code[insn]._b = (uint32_t)here();
+		else
+			_program._code[insn]._a = (uint32_t)here();
+	}
+
+	uint32_t constant(SPtr<Object> const& value) {
+		return constant(Value(value));
+	}
+
+	uint32_t constant(Value const& value) {
+		_program._constants.push_back(value);
+		return (uint32_t)_program._constants.size() - 1;
+	}
+
+	uint32_t slot(SPtr<const String> const& name) {
+		// names are interned
+		for (size_t i = 0; i < _program._slots.size(); i++)
+			if (_program._slots[i] == name)
+				return (uint32_t)i;
+		_program._slots.push_back(name);
+		return (uint32_t)_program._slots.size() - 1;
+	}
+
+	uint32_t name(SPtr<const String> const& name) {
+		_program._names.push_back(name);
+		return (uint32_t)_program._names.size() - 1;
+	}
+
+	uint32_t error(std::exception_ptr const& error) {
+		_program._errors.push_back(error);
+		return (uint32_t)_program._errors.size() - 1;
+	}
+
+	uint32_t builtin(Object const* builtin) {
+		_program._builtins.push_back(builtin);
+		return (uint32_t)_program._builtins.size() - 1;
+	}
+
+	uint32_t guard(Literal::Assumption const& assumption) {
+		_program._guards.push_back({slot(assumption._name), assumption._value.get()});
+		return (uint32_t)_program._guards.size() - 1;
+	}
+
+	/**
+	 * The argument is only compiled on its first use as an Expression: its node is also compiled
+	 * inline, and compiling it here too would double the work at each level of nested calls
+	 */
+	uint32_t lazyArg(SPtr<Expression> const& expr, NodePtr const& eager) {
+		NodePtr node = expr->getNode();
+		// the lazy form differs if the inline form is an error (or was folded apart), and
+		// may then read other variables
+		if (node != eager)
+			Program::compile(node)->collectVariables(_program._lazyVariables);
+		_program._lazyArgs.push_back(std::make_shared<Expression>(expr->getText(), node));
+		return (uint32_t)_program._lazyArgs.size() - 1;
+	}
+
+	void compile(Node const& node) {
+		switch (node.kind()) {
+			case Node::Kind::LITERAL:
+				compileLiteral(static_cast<Literal const&>(node));
+				break;
+			case Node::Kind::SYMBOL:
+				emit(Opcode::VAR, 1, slot(static_cast<Symbol const&>(node).getName()));
+				break;
+			case Node::Kind::UNARY:
+				{
+					Unary const& unary = static_cast<Unary const&>(node);
+					compile(*unary.getOperand());
+					emit(unary.getOp() == '-' ? Opcode::NEG : Opcode::NOT, 0);
+				}
+				break;
+			case Node::Kind::BINARY:
+				compileBinary(static_cast<Binary const&>(node));
+				break;
+			case Node::Kind::INDEX:
+				{
+					Index const& index = static_cast<Index const&>(node);
+					compile(*index.getTarget());
+					compile(*index.getIndex());
+					emit(Opcode::INDEX, -1);
+				}
+				break;
+			case Node::Kind::MEMBER:
+				{
+					Member const& member = static_cast<Member const&>(node);
+					compile(*member.getTarget());
+					emit(Opcode::MEMBER, 0, name(member.getName()));
+				}
+				break;
+			case Node::Kind::CALL:
+				compileCall(static_cast<Call const&>(node));
+				break;
+			case Node::Kind::ERROR:
+				emit(Opcode::ERROR, 1, error(static_cast<Error const&>(node).getError()));
+				break;
+		}
+	}
+
+	void compileLiteral(Literal const& literal) {
+		if (literal.getAssumptions().empty()) {
+			emit(Opcode::CONST, 1, constant(literal.getConstant()));
+			return;
+		}
+
+		// folded from builtins: the original subtree is compiled too, for when a builtin is hidden
+		std::vector<size_t> guards;
+		for (Literal::Assumption const& assumption : literal.getAssumptions())
+			guards.push_back(emit(Opcode::GUARD, 0, guard(assumption)));
+		emit(Opcode::CONST, 1, constant(literal.getConstant()));
+		size_t end = emit(Opcode::JUMP, -1);
+		for (size_t insn : guards)
+			patch(insn);
+		compile(*literal.getOriginal());
+		patch(end);
+	}
+
+	/** Compiles a chain of binary operators, one operator at a time from the innermost one */
+	void compileBinary(Binary const& binary) {
+		std::vector<Binary const*> chain = Binary::chainOf(binary);
+		compile(*chain[0]->getLeft());
+		for (Binary const* op : chain)
+			compileOperator(*op);
+	}
+
+	/** Compiles the right operand and the operator, with the left operand already on the stack */
+	void compileOperator(Binary const& binary) {
+		int op = binary.getOp();
+		if (op == '&' || op == '|') {
+			size_t jump = emit(op == '&' ? Opcode::AND : Opcode::OR, -1);
+			compile(*binary.getRight());
+			patch(jump);
+			return;
+		}
+
+		compile(*binary.getRight());
+		Opcode opcode;
+		switch (op) {
+			case '+': opcode = Opcode::ADD; break;
+			case '-': opcode = Opcode::SUB; break;
+			case '*': opcode = Opcode::MUL; break;
+			case '/': opcode = Opcode::DIV; break;
+			case '%': opcode = Opcode::MOD; break;
+			case '<': opcode = Opcode::LT; break;
+			case Binary::OP_LTE: opcode = Opcode::LTE; break;
+			case '>': opcode = Opcode::GT; break;
+			case Binary::OP_GTE: opcode = Opcode::GTE; break;
+			case Binary::OP_EQ: opcode = Opcode::EQ; break;
+			case Binary::OP_NEQ: opcode = Opcode::NEQ; break;
+			default:
+				throw SyntaxErrorException(_HERE_, fmt::format("Unknown operator '{}'", (char)op).c_str());
+		}
+		emit(opcode, -1);
+	}
+
+	/**
+	 * Argument passing, with the function already on the stack; arguments are pushed above it
+	 * @param eager  compile the arguments inline; otherwise they are evaluated through their
+	 *   lazy form, for arguments that are already compiled inline elsewhere in the program
+	 */
+	void compileGenericCall(Call const& call, bool eager = true) {
+		emit(Opcode::CALL_BEGIN, 0);
+		if (++_calls > _program._maxCalls)
+			_program._maxCalls = _calls;
+		std::vector<Call::Arg> const& args = call.getArgs();
+		for (Call::Arg const& arg : args) {
+			uint32_t lazyIndex = lazyArg(arg._lazy, arg._eager);
+			size_t lazy = emit(Opcode::ARG_LAZY, 0, lazyIndex);
+			if (eager)
+				compile(*arg._eager);
+			else
+				emit(Opcode::ARG_EVAL, 1, lazyIndex);
+			emit(Opcode::ARG, 0);
+			patch(lazy);
+		}
+		emit(Opcode::CALL_END, -(int)args.size());
+		_calls--;
+	}
+
+	void compileCall(Call const& call) {
+		compile(*call.getTarget());
+
+		// if() compiles to jumps, unless the name resolves to something else than the builtin
+		std::vector<Call::Arg> const& args = call.getArgs();
+		NodePtr const& target = call.getTarget();
+		if (target->kind() == Node::Kind::SYMBOL && (args.size() == 2 || args.size() == 3) &&
+			static_cast<Symbol const&>(*target).getName() == StringPool::global().intern("if"_SV)) {
+			SPtr<Object> ifBuiltin = ExpressionEvaluator::_builtins->get("if"_HS);
+			size_t generic = emit(Opcode::IF_BUILTIN, -1, builtin(ifBuiltin.get()));
+			compile(*args[0]._eager);
+			size_t otherwise = emit(Opcode::JUMP_IF_FALSE, -1);
+			compile(*args[1]._lazy->getNode());
+			size_t end1 = emit(Opcode::JUMP, -1);
+			patch(otherwise);
+			if (args.size() == 3)
+				compile(*args[2]._lazy->getNode());
+			else
+				emit(Opcode::CONST, 1, constant(std::make_shared<String>("")));
+			size_t end2 = emit(Opcode::JUMP, 0);
+			// function value still on the stack; the arguments are not compiled a second time, as
+			// each nesting level would double the size of the program
+			patch(generic);
+			compileGenericCall(call, false);
+			patch(end1);
+			patch(end2);
+			return;
+		}
+
+		compileGenericCall(call);
+	}
+};
+
+Program::Program()
+:_maxStack(0)
+,_maxCalls(0) {}
+
+SPtr<const Program> Program::compile(NodePtr const& root) {
+	SPtr<Program> program = std::make_shared<Program>();
+	Compiler compiler(*program);
+	compiler.compile(*root);
+	compiler.emit(Opcode::RETURN, -1);
+	return program;
+}
+
+void Program::collectVariables(std::vector<SPtr<const String>> &names) const {
+	names.insert(names.end(), _slots.begin(), _slots.end());
+	names.insert(names.end(), _lazyVariables.begin(), _lazyVariables.end());
+}
+
+namespace {
+
+/** Function call waiting for its arguments, which are on the operand stack */
+struct PendingCall {
+	Function const* _function;
+	/** first argument; the function value is just below */
+	Value *_args;
+};
+
+/** Operand stack and variable slots of one evaluation; only the entries actually used are constructed */
+class Frame {
+private:
+	typename std::aligned_storage<sizeof(Value), alignof(Value)>::type _local[_LOCAL_SIZE];
+	bool _localResolved[_LOCAL_SIZE];
+	PendingCall _localCalls[_LOCAL_CALLS];
+	Value *_values;
+	/** per slot, whether the variable was already looked up (it may still be nil) */
+	bool *_resolved;
+	PendingCall *_calls;
+	size_t _size;
+public:
+	Frame(size_t numSlots, size_t stackSize, size_t maxCalls)
+	:_size(numSlots + stackSize) {
+		if (_size <= _LOCAL_SIZE) {
+			_values = reinterpret_cast<Value *>(_local);
+			_resolved = _localResolved;
+		} else {
+			_values = static_cast<Value *>(::operator new(_size * sizeof(Value)));
+			_resolved = new bool[numSlots];
+		}
+		_calls = (maxCalls <= _LOCAL_CALLS) ? _localCalls : new PendingCall[maxCalls];
+		for (size_t i = 0; i < _size; i++)
+			new (&_values[i]) Value();
+		std::fill(_resolved, _resolved + numSlots, false);
+	}
+
+	~Frame() {
+		for (size_t i = 0; i < _size; i++)
+			_values[i].~Value();
+		if (_values != reinterpret_cast<Value *>(_local)) {
+			::operator delete(_values);
+			delete[] _resolved;
+		}
+		if (_calls != _localCalls)
+			delete[] _calls;
+	}
+
+	Value *get() {
+		return _values;
+	}
+
+	bool *resolved() {
+		return _resolved;
+	}
+
+	PendingCall *calls() {
+		return _calls;
+	}
+};
+
+} // namespace
+
+SPtr<const Binding> Program::bind(SlotResolver const& resolver) const {
+	SPtr<Binding> binding = std::make_shared<Binding>(resolver.getLayout());
+	binding->_slots.reserve(_slots.size());
+	binding->_builtins.reserve(_slots.size());
+	for (SPtr<const String> const& name : _slots) {
+		binding->_slots.push_back(resolver.getSlot(*name));
+		binding->_builtins.push_back(ExpressionEvaluator::_builtins->get(*name));
+	}
+	return binding;
+}
+
+inline Value const& Program::resolveSlot(Value *slots, bool *resolved, uint32_t slot, Resolver const& resolver,
+										 SlotResolver const* slotResolver, Binding const* binding) const {
+	if (!resolved[slot]) {
+		SPtr<const String> const& name = _slots[slot];
+		uint32_t bound = binding ? binding->_slots[slot] : SlotResolver::NO_SLOT;
+		if (bound != SlotResolver::NO_SLOT) {
+			// same as InternalResolver: the builtin, unless the resolver has a value
+			SPtr<Object> value = slotResolver->getSlotVar(bound);
+			slots[slot] = value ? Value(value, name) : Value(binding->_builtins[slot], name);
+		} else {
+			Profiler::lookup();
+			slots[slot] = Value(resolver.getVar(*name), name);
+		}
+		resolved[slot] = true;
+	}
+	return slots[slot];
+}
+
+Value Program::execute(Resolver const& resolver, SlotResolver const* slotResolver, Binding const* binding) const {
+	// jumps only go forward: no run executes more instructions than the program has
+	EvaluationContext::step(_code.size());
+	Frame frame(_slots.size(), _maxStack, _maxCalls);
+	Value *slots = frame.get();
+	bool *resolved = frame.resolved();
+	Value *stack = slots + _slots.size();
+	PendingCall *cp = frame.calls();
+
+	Value *sp = stack;
+	Instruction const* code = _code.data();
+	Instruction const* ip = code;
+	Instruction const* insn;
+
+#ifdef SLIB_EXPR_COMPUTED_GOTO
+	static void const* const dispatch[] = {
+		&&op_CONST, &&op_VAR, &&op_NEG, &&op_NOT,
+		&&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV, &&op_MOD,
+		&&op_LT, &&op_LTE, &&op_GT, &&op_GTE, &&op_EQ, &&op_NEQ,
+		&&op_INDEX, &&op_MEMBER, &&op_JUMP, &&op_JUMP_IF_FALSE, &&op_AND, &&op_OR,
+		&&op_IF_BUILTIN, &&op_GUARD, &&op_CALL_BEGIN, &&op_ARG_LAZY, &&op_ARG_EVAL, &&op_ARG, &&op_CALL_END,
+		&&op_ERROR, &&op_RETURN
+	};
+	static_assert(sizeof(dispatch) / sizeof(dispatch[0]) == (size_t)Opcode::RETURN + 1, "dispatch table out of sync");
+#define VM_CASE(name) op_##name:
+#define VM_NEXT() do { insn = ip++; goto *dispatch[(size_t)insn->_op]; } while (0)
+	VM_NEXT();
+#else
+#define VM_CASE(name) case Opcode::name:
+#define VM_NEXT() continue
+	while (true) {
+		insn = ip++;
+		switch (insn->_op) {
+#endif
+	VM_CASE(CONST)
+		*sp++ = _constants[insn->_a];
+		VM_NEXT();
+	VM_CASE(VAR)
+		*sp++ = resolveSlot(slots, resolved, insn->_a, resolver, slotResolver, binding);
+		VM_NEXT();
+	VM_CASE(NEG)
+		sp[-1] = Value::inverse(sp[-1]);
+		VM_NEXT();
+	VM_CASE(NOT)
+		sp[-1] = Value::logicalNegate(sp[-1]);
+		VM_NEXT();
+	VM_CASE(ADD)
+		sp--;
+		sp[-1] = Value::add(sp[-1], *sp);
+		VM_NEXT();
+	VM_CASE(SUB)
+		sp--;
+		sp[-1] = Value::subtract(sp[-1], *sp);
+		VM_NEXT();
+	VM_CASE(MUL)
+		sp--;
+		sp[-1] = Value::multiply(sp[-1], *sp);
+		VM_NEXT();
+	VM_CASE(DIV)
+		sp--;
+		sp[-1] = Value::divide(sp[-1], *sp);
+		VM_NEXT();
+	VM_CASE(MOD)
+		sp--;
+		sp[-1] = Value::remainder(sp[-1], *sp);
+		VM_NEXT();
+	VM_CASE(LT)
+		sp--;
+		sp[-1] = Value((int32_t)Value::lt(sp[-1], *sp));
+		VM_NEXT();
+	VM_CASE(LTE)
+		sp--;
+		sp[-1] = Value((int32_t)Value::lte(sp[-1], *sp));
+		VM_NEXT();
+	VM_CASE(GT)
+		sp--;
+		sp[-1] = Value((int32_t)Value::gt(sp[-1], *sp));
+		VM_NEXT();
+	VM_CASE(GTE)
+		sp--;
+		sp[-1] = Value((int32_t)Value::gte(sp[-1], *sp));
+		VM_NEXT();
+	VM_CASE(EQ)
+		sp--;
+		sp[-1] = Value((int32_t)Value::eq(sp[-1], *sp));
+		VM_NEXT();
+	VM_CASE(NEQ)
+		sp--;
+		sp[-1] = Value((int32_t)!Value::eq(sp[-1], *sp));
+		VM_NEXT();
+	VM_CASE(INDEX)
+		sp--;
+		sp[-1] = Value::index(sp[-1], *sp);
+		VM_NEXT();
+	VM_CASE(MEMBER)
+		sp[-1] = Value::member(sp[-1], _names[insn->_a], resolver);
+		VM_NEXT();
+	VM_CASE(JUMP)
+		ip = code + insn->_a;
+		VM_NEXT();
+	VM_CASE(JUMP_IF_FALSE)
+		if (!Value::isTrue(*--sp))
+			ip = code + insn->_a;
+		VM_NEXT();
+	VM_CASE(AND)
+		if (!Value::isTrue(sp[-1]))
+			ip = code + insn->_a;
+		else
+			sp--;
+		VM_NEXT();
+	VM_CASE(OR)
+		if (Value::isTrue(sp[-1]))
+			ip = code + insn->_a;
+		else
+			sp--;
+		VM_NEXT();
+	VM_CASE(IF_BUILTIN)
+		if (sp[-1]._value.get() == _builtins[insn->_a])
+			sp--;
+		else
+			ip = code + insn->_b;
+		VM_NEXT();
+	VM_CASE(GUARD)
+		{
+			Guard const& guard = _guards[insn->_a];
+			if (resolveSlot(slots, resolved, guard._slot, resolver, slotResolver, binding)._value.get() != guard._builtin)
+				ip = code + insn->_b;
+		}
+		VM_NEXT();
+	VM_CASE(CALL_BEGIN)
+		{
+			Value &val = sp[-1];
+			if (!instanceof<Function>(val._value))
+				throw EvaluationException(_HERE_, "Not a function");
+			if (!val._name)
+				val._name = StringPool::global().intern("<unknown>"_SV);
+			cp->_function = Class::cast<Function>(val._value.get());
+			cp->_args = sp;
+			cp++;
+		}
+		VM_NEXT();
+	VM_CASE(ARG_LAZY)
+		if (cp[-1]._function->getParamType(sp - cp[-1]._args) == EXPRESSIONCLASS) {
+			*sp++ = Value(_lazyArgs[insn->_a]);
+			ip = code + insn->_b;
+		}
+		VM_NEXT();
+	VM_CASE(ARG_EVAL)
+		*sp++ = _lazyArgs[insn->_a]->execute(resolver);
+		VM_NEXT();
+	VM_CASE(ARG)
+		cp[-1]._function->checkArg(sp - 1 - cp[-1]._args, sp[-1], cp[-1]._args[-1]._name);
+		VM_NEXT();
+	VM_CASE(CALL_END)
+		{
+			PendingCall const& call = *--cp;
+			Value result;
+			try {
+				Profiler::CallScope scope(call._args[-1]._name);
+				result = call._function->call(resolver, call._args, sp - call._args, call._args[-1]._name);
+			} catch (ClassCastException const& e) {
+				throw CastException(_HERE_, fmt::format("Cast exception in function {}()", *call._args[-1]._name).c_str(), e);
+			}
+			sp = call._args;
+			sp[-1] = std::move(result);
+		}
+		VM_NEXT();
+	VM_CASE(ERROR)
+		std::rethrow_exception(_errors[insn->_a]);
+	VM_CASE(RETURN)
+		return std::move(*--sp);
+#ifndef SLIB_EXPR_COMPUTED_GOTO
+		}
+	}
+#endif
+#undef VM_CASE
+#undef VM_NEXT
+}
+
+} // namespace expr
+} // namespace slib
@@ -0,0 +1,172 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_UTIL_EXPR_BYTECODE_H
+#define H_SLIB_UTIL_EXPR_BYTECODE_H
+
+#include "slib/util/expr/Ast.h"
+
+#include <vector>
+
+#if defined(__GNUC__) && !defined(SLIB_EXPR_NO_COMPUTED_GOTO)
+#define SLIB_EXPR_COMPUTED_GOTO
+#endif
+
+namespace slib {
+namespace expr {
+
+/** Instructions of the expression stack machine */
+enum class Opcode : uint8_t {
+	CONST,			///< push constant <a>
+	VAR,			///< push variable in slot <a>, resolved on first use in each evaluation
+	NEG,			///< unary '-'
+	NOT,			///< unary '!'
+	ADD, SUB, MUL, DIV, MOD,
+	LT, LTE, GT, GTE, EQ, NEQ,
+	INDEX,			///< operator '[]'
+	MEMBER,			///< operator '.', member name <a>
+	JUMP,			///< jump to <a>
+	JUMP_IF_FALSE,	///< pop, jump to <a> if false
+	AND,			///< if top is false jump to <a>, else pop ('&' short-circuit)
+	OR,				///< if top is true jump to <a>, else pop ('|' short-circuit)
+	IF_BUILTIN,		///< if top is builtin <a>, pop; else jump to <b>
+	GUARD,			///< unless guard <a> holds, jump to <b>
+	CALL_BEGIN,		///< start a call to the function on top; its arguments are pushed above it
+	ARG_LAZY,		///< if the pending call takes an Expression, push lazy argument <a> and jump to <b>
+	ARG_EVAL,		///< push the value of lazy argument <a>
+	ARG,			///< check the argument on top against the pending call's param
+	CALL_END,		///< invoke pending call, replace function and arguments with the result
+	ERROR,			///< raise deferred error <a>
+	RETURN			///< return top
+};
+
+struct Instruction {
+	Opcode _op;
+	uint32_t _a;
+	uint32_t _b;
+};
+
+/**
+ * Variables of a program mapped to the slots of a SlotResolver layout (see Program::bind()).
+ * Immutable, so it can be shared by all threads evaluating against resolvers of the same layout.
+ */
+class Binding {
+friend class Program;
+private:
+	uint64_t _layout;
+	/** per program variable: resolver slot, or SlotResolver::NO_SLOT to look it up by name */
+	std::vector<uint32_t> _slots;
+	/** per program variable: builtin used when the resolver has no value */
+	std::vector<SPtr<Object>> _builtins;
+public:
+	/** do NOT use directly, use Program::bind() */
+	Binding(uint64_t layout)
+	:_layout(layout) {}
+
+	uint64_t getLayout() const {
+		return _layout;
+	}
+};
+
+/**
+ * Expression compiled to bytecode for a small stack machine. Evaluates the same as
+ * the syntax tree it was compiled from, except that '&', '|' and the builtin if()
+ * skip the operands they do not need, and that each variable is looked up at most
+ * once per evaluation. Immutable after compilation.
+ */
+class Program {
+private:
+	/** Check that a variable still resolves to the builtin a folded constant was computed from */
+	struct Guard {
+		uint32_t _slot;
+		Object const* _builtin;
+	};
+
+	std::vector<Instruction> _code;
+	std::vector<Value> _constants;
+	/** variable names, by slot */
+	std::vector<SPtr<const String>> _slots;
+	/** member names */
+	std::vector<SPtr<const String>> _names;
+	std::vector<SPtr<Expression>> _lazyArgs;
+	/** variables read by lazy arguments whose syntax tree is not compiled inline */
+	std::vector<SPtr<const String>> _lazyVariables;
+	std::vector<std::exception_ptr> _errors;
+	std::vector<Object const*> _builtins;
+	std::vector<Guard> _guards;
+	size_t _maxStack;
+	/** maximum nesting of calls */
+	size_t _maxCalls;
+
+	class Compiler;
+
+	/** Variable in a slot, looked up on first use (by slot, if bound) */
+	Value const& resolveSlot(Value *slots, bool *resolved, uint32_t slot, Resolver const& resolver,
+							 SlotResolver const* slotResolver, Binding const* binding) const;
+
+	/** @throws EvaluationException */
+	Value execute(Resolver const& resolver, SlotResolver const* slotResolver, Binding const* binding) const;
+public:
+	/** do NOT use directly, use compile() */
+	Program();
+
+	/**
+	 * Compiles a syntax tree
+	 * @param root  root node
+	 * @return compiled program
+	 */
+	static SPtr<const Program> compile(ast::NodePtr const& root);
+
+	/**
+	 * Runs the program
+	 * @param resolver  resolver, including builtins
+	 * @return result, possibly held unboxed
+	 * @throws EvaluationException
+	 */
+	Value execute(Resolver const& resolver) const {
+		return execute(resolver, nullptr, nullptr);
+	}
+
+	/**
+	 * Maps the variables of the program to the slots of a resolver
+	 * @param resolver  resolver; only its layout is used
+	 * @return binding, valid for all resolvers with the same layout
+	 */
+	SPtr<const Binding> bind(SlotResolver const& resolver) const;
+
+	/**
+	 * Runs the program, fetching variables by slot
+	 * @param resolver  resolver, including builtins, for variables that are not in a slot
+	 * @param slotResolver  the resolver <i>resolver</i> looks up first
+	 * @param binding  binding to the layout of <i>slotResolver</i>; if it was made for a
+	 *		different layout, all variables are looked up by name
+	 * @return result, possibly held unboxed
+	 * @throws EvaluationException
+	 */
+	Value execute(Resolver const& resolver, SlotResolver const& slotResolver, Binding const& binding) const {
+		if (binding._layout != slotResolver.getLayout())
+			return execute(resolver, nullptr, nullptr);
+		return execute(resolver, &slotResolver, &binding);
+	}
+
+	size_t size() const {
+		return _code.size();
+	}
+
+	/** @return names of the variables the program reads (including those of folded builtins) */
+	std::vector<SPtr<const String>> const& getVariables() const {
+		return _slots;
+	}
+
+	/**
+	 * Adds the names of the variables the program may read to a list, including those read
+	 * by lazy arguments (see Function::getParamType()), which getVariables() does not list
+	 */
+	void collectVariables(std::vector<SPtr<const String>> &names) const;
+};
+
+} // namespace expr
+} // namespace slib
+
+#endif // H_SLIB_UTIL_EXPR_BYTECODE_H
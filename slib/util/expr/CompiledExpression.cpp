@@ -0,0 +1,410 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "slib/util/expr/CompiledExpression.h"
+#include "slib/util/expr/ExpressionEvaluator.h"
+#include "slib/util/expr/Profiler.h"
+#include "slib/lang/StringPool.h"
+
+namespace slib {
+namespace expr {
+
+using namespace ast;
+
+SPtr<CompiledExpression> CompiledExpression::compile(SPtr<BasicString> const& text) {
+	Profiler::CompileScope scope(*text);
+	ExpressionInputStream input(text);
+	return std::make_shared<CompiledExpression>(text, parse(input));
+}
+
+SPtr<Value> CompiledExpression::evaluate(Resolver const& resolver) const {
+	Profiler::EvaluationScope scope(*_text);
+	return std::make_shared<Value>(_program->execute(ExpressionEvaluator::InternalResolver(resolver)));
+}
+
+SPtr<Object> CompiledExpression::value(Resolver const& resolver) const {
+	Profiler::EvaluationScope scope(*_text);
+	return ExpressionEvaluator::normalize(_program->execute(ExpressionEvaluator::InternalResolver(resolver)));
+}
+
+UPtr<String> CompiledExpression::strValue(Resolver const& resolver) const {
+	Profiler::EvaluationScope scope(*_text);
+	return ExpressionEvaluator::toString(_program->execute(ExpressionEvaluator::InternalResolver(resolver)));
+}
+
+const size_t CompiledExpression::MAX_BINDINGS;
+const uint32_t CompiledExpression::MAX_DEPTH;
+
+Binding const* CompiledExpression::getBinding(SlotResolver const& resolver, SPtr<const Binding> &holder) const {
+	uint64_t layout = resolver.getLayout();
+	Binding const* binding = _binding.load(std::memory_order_acquire);
+	if (binding && (binding->getLayout() == layout))
+		return binding;
+
+	std::lock_guard<std::mutex> lock(_bindingsLock);
+	for (SPtr<const Binding> const& existing : _bindings) {
+		if (existing->getLayout() == layout) {
+			_binding.store(existing.get(), std::memory_order_release);
+			return existing.get();
+		}
+	}
+	holder = _program->bind(resolver);
+	if (_bindings.size() < MAX_BINDINGS) {
+		_bindings.push_back(holder);
+		_binding.store(holder.get(), std::memory_order_release);
+	}
+	return holder.get();
+}
+
+SPtr<Object> CompiledExpression::value(SlotResolver const& resolver) const {
+	Profiler::EvaluationScope scope(*_text);
+	SPtr<const Binding> holder;
+	Binding const* binding = getBinding(resolver, holder);
+	return ExpressionEvaluator::normalize(_program->execute(ExpressionEvaluator::InternalResolver(resolver), resolver, *binding));
+}
+
+UPtr<String> CompiledExpression::strValue(SlotResolver const& resolver) const {
+	Profiler::EvaluationScope scope(*_text);
+	SPtr<const Binding> holder;
+	Binding const* binding = getBinding(resolver, holder);
+	return ExpressionEvaluator::toString(_program->execute(ExpressionEvaluator::InternalResolver(resolver), resolver, *binding));
+}
+
+// The parser mirrors the ExpressionEvaluator interpreter step by step (including
+// operator precedence), building nodes instead of computing values. Instead of
+// recursing for each nested sub-expression, it keeps one frame per sub-expression
+// being parsed on an explicit stack. The trees it builds are still folded, compiled and
+// freed recursively (except along chains of binary operators), so their depth is limited
+// to MAX_DEPTH
+
+/** Name the interpreter would report for a call target, when known in advance */
+static SPtr<const String> staticName(NodePtr const& node) {
+	if (Symbol const* symbol = dynamic_cast<Symbol const*>(node.get()))
+		return symbol->getName();
+	if (Member const* member = dynamic_cast<Member const*>(node.get()))
+		return member->getName();
+	return StringPool::global().intern("<unknown>"_SV);
+}
+
+namespace {
+
+/** (Sub)expression being parsed, with the operands it has read so far */
+struct ParseFrame {
+	/** what the enclosing frame does with the result */
+	enum class Kind : uint8_t {
+		TOP,		///< returned
+		PAREN,		///< primary in parentheses
+		INDEX,		///< argument of '[]'
+		ARG			///< function argument, read from its own input
+	};
+
+	Kind _kind;
+	ExpressionInputStream *_input;
+	/** ARG: argument text, and the input reading it */
+	SPtr<String> _argText;
+	UPtr<ExpressionInputStream> _argInput;
+	/** left operand and operator of the binary operator chain */
+	NodePtr _left;
+	int _op;
+	/** unary operator of the current operand, or 0 */
+	char _unary;
+	/** left operand and operator of the '*', '/', '%' chain */
+	NodePtr _product;
+	char _productOp;
+	/** node being indexed, or called with _args */
+	NodePtr _target;
+	std::vector<Call::Arg> _args;
+
+	ParseFrame(Kind kind, ExpressionInputStream *input)
+	:_kind(kind)
+	,_input(input)
+	,_op(0)
+	,_unary(0)
+	,_productOp(0) {}
+
+	ParseFrame(SPtr<String> const& argText)
+	:_kind(Kind::ARG)
+	,_argText(argText)
+	,_argInput(std::make_unique<ExpressionInputStream>(argText))
+	,_op(0)
+	,_unary(0)
+	,_productOp(0) {
+		_input = _argInput.get();
+	}
+};
+
+/** Parser states, named after the interpreter methods they stand for */
+enum class Step : uint8_t {
+	PREFIX_TERM,	///< start of an operand of a binary operator
+	FACTOR,			///< start of an operand of '*', '/', '%'
+	POSTFIX,		///< after a primary: '[]', '()', '.'
+	FACTOR_DONE,	///< after a factor, in the '*', '/', '%' chain
+	TERM_DONE,		///< after an operand, in the binary operator chain
+	DONE			///< end of the frame's expression
+};
+
+/**
+ * Builds a node of the syntax tree
+ * @throws SyntaxErrorException if the tree gets deeper than CompiledExpression::MAX_DEPTH
+ */
+template <class N, class... A>
+NodePtr makeNode(A&&... args) {
+	NodePtr node = std::make_shared<N>(std::forward<A>(args)...);
+	if (node->getDepth() > CompiledExpression::MAX_DEPTH)
+		throw SyntaxErrorException(_HERE_, fmt::format("Expression nested deeper than {} levels", CompiledExpression::MAX_DEPTH).c_str());
+	return node;
+}
+
+/** @throws EvaluationException */
+int readBinaryOperator(ExpressionInputStream &input) {
+	int op = input.readChar();
+	if (op == '<') {
+		if (input.peek() == '=') {
+			input.readChar();
+			op = Binary::OP_LTE;
+		}
+	} else if (op == '>') {
+		if (input.peek() == '=') {
+			input.readChar();
+			op = Binary::OP_GTE;
+		}
+	} else if (op == '=') {
+		if (input.peek() == '=') {
+			input.readChar();
+			op = Binary::OP_EQ;
+		} else
+			throw SyntaxErrorException(_HERE_, "Unknown operator '='");
+	} else if (op == '~') {
+		if (input.peek() == '=') {
+			input.readChar();
+			op = Binary::OP_NEQ;
+		} else
+			throw SyntaxErrorException(_HERE_, fmt::format("Unknown operator '~{}'", input.peek()).c_str());
+	}
+	return op;
+}
+
+bool isBinaryOperator(char ch) {
+	return ch == '+' || ch == '-' || ch == '&' || ch == '|' || ch == '<' || ch == '>' || ch == '~' || ch == '=';
+}
+
+/**
+ * Delimits the next argument of a call (as Expression arguments are) and pushes a frame
+ * parsing it on its own; parse errors are deferred until the argument is evaluated
+ * @throws EvaluationException
+ */
+void pushArg(std::vector<ParseFrame> &stack) {
+	SPtr<String> argText = stack.back()._input->readArgText();
+	stack.emplace_back(argText);
+	stack.back()._input->skipBlanks();
+}
+
+} // namespace
+
+/**
+ * @param prefixTermOnly  stop after the first operand of a binary operator
+ * @throws EvaluationException
+ */
+static NodePtr parseExpression(ExpressionInputStream &input, bool prefixTermOnly) {
+	std::vector<ParseFrame> stack;
+	stack.reserve(8);
+	stack.emplace_back(ParseFrame::Kind::TOP, &input);
+	input.skipBlanks();
+
+	Step step = Step::PREFIX_TERM;
+	NodePtr node;
+	// the argument at the top of the stack failed to parse, node holds the error
+	bool argFailed = false;
+
+	while (true) {
+		try {
+			// frames are only referenced until the next push or pop
+			ParseFrame &frame = stack.back();
+			ExpressionInputStream &in = *frame._input;
+
+			switch (step) {
+				case Step::PREFIX_TERM:
+					if (in.peek() == '-' || in.peek() == '!')
+						frame._unary = in.readChar();
+					step = Step::FACTOR;
+					break;
+
+				case Step::FACTOR: {
+					in.skipBlanks();
+					char ch = in.peek();
+					if (ASCII::isDigit(ch)) {
+						node = std::make_shared<Literal>(in.readNumber()->getValue());
+						step = Step::POSTFIX;
+					} else if (ExpressionInputStream::isIdentifierStart(ch)) {
+						node = std::make_shared<Symbol>(in.readName());
+						step = Step::POSTFIX;
+					} else if (ch == '(') {
+						in.readChar();
+						stack.emplace_back(ParseFrame::Kind::PAREN, &in);
+						in.skipBlanks();
+						step = Step::PREFIX_TERM;
+					} else if (ch == '\'' || ch == '\"') {
+						node = std::make_shared<Literal>(in.readString()->getValue());
+						step = Step::POSTFIX;
+					} else if (ch == CharacterIterator::DONE)
+						throw SyntaxErrorException(_HERE_, "Unexpected end of line");
+					else if (ch == ')')
+						throw SyntaxErrorException(_HERE_, "Extra right paranthesis");
+					else if (ch == '+' || ch == '-' || ch == '&' || ch == '|' || ch == '*' || ch == '/' || ch == '%')
+						throw SyntaxErrorException(_HERE_, fmt::format("Misplaced operator '{}'", ch).c_str());
+					else
+						throw SyntaxErrorException(_HERE_, fmt::format("Unexpected character '{}' encountered", ch).c_str());
+					break;
+				}
+
+				case Step::POSTFIX:
+					in.skipBlanks();
+					switch (in.peek()) {
+						case '[':
+							in.readChar();
+							frame._target = std::move(node);
+							stack.emplace_back(ParseFrame::Kind::INDEX, &in);
+							in.skipBlanks();
+							step = Step::PREFIX_TERM;
+							break;
+						case '(':
+							in.readChar();
+							// check for 0 parameters
+							in.skipBlanks();
+							if (in.peek() == ')') {
+								in.readChar();
+								node = makeNode<Call>(node, std::vector<Call::Arg>());
+								break;
+							}
+							frame._target = std::move(node);
+							pushArg(stack);
+							step = Step::PREFIX_TERM;
+							break;
+						case '.':
+							in.readChar();
+							node = makeNode<Member>(node, in.readName());
+							break;
+						default:
+							in.skipBlanks();
+							step = Step::FACTOR_DONE;
+							break;
+					}
+					break;
+
+				case Step::FACTOR_DONE:
+					frame._product = frame._product ? makeNode<Binary>(frame._productOp, frame._product, node) : std::move(node);
+					in.skipBlanks();
+					if (in.peek() == '*' || in.peek() == '/' || in.peek() == '%') {
+						frame._productOp = in.readChar();
+						step = Step::FACTOR;
+						break;
+					}
+					node = std::move(frame._product);
+					frame._product = nullptr;
+					if (frame._unary) {
+						node = makeNode<Unary>(frame._unary, node);
+						frame._unary = 0;
+					}
+					step = Step::TERM_DONE;
+					break;
+
+				case Step::TERM_DONE:
+					if (prefixTermOnly && frame._kind == ParseFrame::Kind::TOP)
+						return node;
+					frame._left = frame._left ? makeNode<Binary>(frame._op, frame._left, node) : std::move(node);
+					in.skipBlanks();
+					if (isBinaryOperator(in.peek())) {
+						frame._op = readBinaryOperator(in);
+						in.skipBlanks();
+						step = Step::PREFIX_TERM;
+						break;
+					}
+					node = std::move(frame._left);
+					frame._left = nullptr;
+					step = Step::DONE;
+					break;
+
+				case Step::DONE:
+					switch (frame._kind) {
+						case ParseFrame::Kind::TOP:
+							return node;
+
+						case ParseFrame::Kind::PAREN: {
+							stack.pop_back();
+							ExpressionInputStream &outer = *stack.back()._input;
+							outer.skipBlanks();
+							if (outer.peek() != ')')
+								throw SyntaxErrorException(_HERE_, "Missing right paranthesis");
+							outer.readChar();
+							step = Step::POSTFIX;
+							break;
+						}
+
+						case ParseFrame::Kind::INDEX: {
+							stack.pop_back();
+							ParseFrame &outer = stack.back();
+							outer._input->skipBlanks();
+							if (outer._input->peek() != ']')
+								throw SyntaxErrorException(_HERE_, "Missing right bracket after array argument");
+							outer._input->readChar();
+							node = makeNode<Index>(outer._target, node);
+							outer._target = nullptr;
+							step = Step::POSTFIX;
+							break;
+						}
+
+						case ParseFrame::Kind::ARG: {
+							Call::Arg arg;
+							if (!argFailed) {
+								in.skipBlanks();
+								if (in.peek() != CharacterIterator::DONE)
+									arg._eager = std::make_shared<Error>(std::make_exception_ptr(SyntaxErrorException(_HERE_,
+										fmt::format("Missing right paranthesis after function arguments ({})", *staticName(stack[stack.size() - 2]._target)).c_str())));
+							}
+							argFailed = false;
+							if (!arg._eager)
+								arg._eager = node;
+							arg._lazy = std::make_shared<Expression>(frame._argText, node);
+							stack.pop_back();
+
+							ParseFrame &outer = stack.back();
+							outer._args.push_back(std::move(arg));
+							if (outer._input->readChar() == ')') {
+								node = makeNode<Call>(outer._target, std::move(outer._args));
+								outer._target = nullptr;
+								outer._args.clear();
+								step = Step::POSTFIX;
+							} else {
+								pushArg(stack);
+								step = Step::PREFIX_TERM;
+							}
+							break;
+						}
+					}
+					break;
+			}
+		} catch (EvaluationException const&) {
+			// the error ends the innermost argument being parsed, if any
+			while (stack.back()._kind != ParseFrame::Kind::ARG) {
+				if (stack.back()._kind == ParseFrame::Kind::TOP)
+					throw;
+				stack.pop_back();
+			}
+			node = std::make_shared<Error>(std::current_exception());
+			argFailed = true;
+			step = Step::DONE;
+		}
+	}
+}
+
+NodePtr CompiledExpression::parse(ExpressionInputStream &input) {
+	return parseExpression(input, false);
+}
+
+NodePtr CompiledExpression::parsePrefixTerm(ExpressionInputStream &input) {
+	return parseExpression(input, true);
+}
+
+} // namespace expr
+} // namespace slib
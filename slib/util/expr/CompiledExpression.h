@@ -0,0 +1,157 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_UTIL_EXPR_COMPILEDEXPRESSION_H
+#define H_SLIB_UTIL_EXPR_COMPILEDEXPRESSION_H
+
+#include "slib/util/expr/Ast.h"
+#include "slib/util/expr/Bytecode.h"
+#include "slib/util/expr/ConstantFolder.h"
+#include "slib/util/expr/ExpressionInputStream.h"
+#include "slib/util/expr/Resolver.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace slib {
+namespace expr {
+
+/**
+ * Expression parsed once into a syntax tree and compiled to bytecode, to be evaluated
+ * repeatedly against different resolvers. Constant parts are computed at compile time
+ * (see ConstantFolder). Immutable after compilation, so a single instance can be
+ * shared and evaluated concurrently by multiple threads.
+ */
+class CompiledExpression {
+friend class Expression;
+friend class ExpressionEvaluator;
+private:
+	SPtr<BasicString> _text;
+	ast::NodePtr _root;
+	ast::NodePtr _folded;
+	SPtr<const Program> _program;
+	/** bindings made by evaluations against SlotResolvers, kept for reuse (at most MAX_BINDINGS) */
+	mutable std::mutex _bindingsLock;
+	mutable std::vector<SPtr<const Binding>> _bindings;
+	/** most recently used of _bindings */
+	mutable std::atomic<Binding const*> _binding;
+private:
+	static const size_t MAX_BINDINGS = 8;
+
+	/**
+	 * @param holder  owns the returned binding, if it is not kept for reuse
+	 * @return binding to the layout of a resolver
+	 */
+	Binding const* getBinding(SlotResolver const& resolver, SPtr<const Binding> &holder) const;
+
+	/**
+	 * Parses an expression from an input stream, stopping at the first character
+	 * that cannot continue it (as the interpreter does). Nested sub-expressions are
+	 * kept on an explicit stack, not parsed recursively.
+	 * @throws EvaluationException
+	 */
+	static ast::NodePtr parse(ExpressionInputStream &input);
+
+	/**
+	 * Parses a single operand of a binary operator, including its unary operator if any
+	 * @throws EvaluationException
+	 */
+	static ast::NodePtr parsePrefixTerm(ExpressionInputStream &input);
+public:
+	/**
+	 * Maximum depth of a syntax tree, counting each operand nested in an operator, call, index
+	 * or member access as one level. A chain of binary operators (such as "a + b + c") only
+	 * counts as one level, however long. Deeper expressions are rejected with a
+	 * SyntaxErrorException, as folding, compiling and freeing the tree are recursive. The
+	 * ExpressionEvaluator interpreter limits its own recursion (parentheses, arguments and
+	 * indexes) to the same depth.
+	 */
+	static const uint32_t MAX_DEPTH = 1000;
+
+	/** do NOT use directly, only public for make_shared */
+	CompiledExpression(SPtr<BasicString> const& text, ast::NodePtr const& root)
+	:_text(text)
+	,_root(root)
+	,_folded(ConstantFolder::fold(root))
+	,_program(Program::compile(_folded))
+	,_binding(nullptr) {}
+
+	/**
+	 * Parses an expression. Syntax errors inside function arguments are only reported
+	 * if the argument is actually evaluated.
+	 * @param text  expression source
+	 * @return compiled expression
+	 * @throws EvaluationException on syntax errors
+	 */
+	static SPtr<CompiledExpression> compile(SPtr<BasicString> const& text);
+
+	SPtr<BasicString> const& getText() const {
+		return _text;
+	}
+
+	ast::NodePtr const& getRoot() const {
+		return _root;
+	}
+
+	/** @return syntax tree after constant folding, as compiled */
+	ast::NodePtr const& getFoldedRoot() const {
+		return _folded;
+	}
+
+	SPtr<const Program> const& getProgram() const {
+		return _program;
+	}
+
+	/**
+	 * Names of the variables the expression depends on, after folding. The value only
+	 * changes if one of these does.
+	 */
+	std::vector<SPtr<const String>> const& getVariables() const {
+		return _program->getVariables();
+	}
+
+	/**
+	 * Evaluates the expression, with builtins available
+	 * @throws EvaluationException
+	 */
+	SPtr<Value> evaluate(Resolver const& resolver) const;
+
+	/**
+	 * Same as ExpressionEvaluator::expressionValue(), without the parsing
+	 * @throws EvaluationException
+	 */
+	SPtr<Object> value(Resolver const& resolver) const;
+
+	/**
+	 * Same as ExpressionEvaluator::strExpressionValue(), without the parsing
+	 * @throws EvaluationException
+	 */
+	UPtr<String> strValue(Resolver const& resolver) const;
+
+	/**
+	 * Maps the variables of the expression to the slots of a resolver (see Program::bind())
+	 * @return binding, valid for all resolvers with the same layout
+	 */
+	SPtr<const Binding> bind(SlotResolver const& resolver) const {
+		return _program->bind(resolver);
+	}
+
+	/**
+	 * Same as value(Resolver const&), with variables fetched by slot. The expression is bound
+	 * to the layout of the resolver on first use, and again only if the layout changes.
+	 * @throws EvaluationException
+	 */
+	SPtr<Object> value(SlotResolver const& resolver) const;
+
+	/**
+	 * Same as strValue(Resolver const&), with variables fetched by slot
+	 * @throws EvaluationException
+	 */
+	UPtr<String> strValue(SlotResolver const& resolver) const;
+};
+
+} // namespace expr
+} // namespace slib
+
+#endif // H_SLIB_UTIL_EXPR_COMPILEDEXPRESSION_H
@@ -0,0 +1,272 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "slib/util/expr/ConstantFolder.h"
+#include "slib/util/expr/ExpressionEvaluator.h"
+#include "slib/util/expr/Function.h"
+#include "slib/lang/StringPool.h"
+
+namespace slib {
+namespace expr {
+
+using namespace ast;
+
+namespace {
+
+/** Resolver for compile-time evaluation; pure functions and constant operands never look anything up */
+class NullResolver : public Resolver {
+public:
+	virtual SPtr<Object> getVar(String const& /* key */) const override {
+		return nullptr;
+	}
+};
+
+Literal const* asLiteral(NodePtr const& node) {
+	if (node->kind() == Node::Kind::LITERAL)
+		return static_cast<Literal const*>(node.get());
+	return nullptr;
+}
+
+/** Adds the assumptions of a literal operand to those of a folded value */
+void assume(std::vector<Literal::Assumption> &assumptions, Literal const& operand) {
+	for (Literal::Assumption const& assumption : operand.getAssumptions()) {
+		bool found = false;
+		for (Literal::Assumption const& existing : assumptions) {
+			if (existing._name == assumption._name) {
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			assumptions.push_back(assumption);
+	}
+}
+
+} // namespace
+
+NodePtr ConstantFolder::fold(NodePtr const& root) {
+	return foldNode(root);
+}
+
+NodePtr ConstantFolder::foldNode(NodePtr const& node) {
+	switch (node->kind()) {
+		case Node::Kind::SYMBOL:
+			{
+				SPtr<const String> const& name = static_cast<Symbol const&>(*node).getName();
+				SPtr<Object> builtin = ExpressionEvaluator::_builtins->get(*name);
+				if (!builtin)
+					return node;
+				std::vector<Literal::Assumption> assumptions { { name, builtin } };
+				return std::make_shared<Literal>(Value(builtin, name), std::move(assumptions), node);
+			}
+		case Node::Kind::UNARY:
+			return foldUnary(node);
+		case Node::Kind::BINARY:
+			return foldBinary(node);
+		case Node::Kind::INDEX:
+			return foldIndex(node);
+		case Node::Kind::MEMBER:
+			return foldMember(node);
+		case Node::Kind::CALL:
+			return foldCall(node);
+		default:
+			return node;
+	}
+}
+
+NodePtr ConstantFolder::foldUnary(NodePtr const& node) {
+	Unary const& unary = static_cast<Unary const&>(*node);
+	NodePtr operand = foldNode(unary.getOperand());
+
+	if (Literal const* literal = asLiteral(operand)) {
+		try {
+			Value const& value = literal->getConstant();
+			Value result = (unary.getOp() == '-') ? Value::inverse(value) : Value::logicalNegate(value);
+			std::vector<Literal::Assumption> assumptions;
+			assume(assumptions, *literal);
+			return std::make_shared<Literal>(result, std::move(assumptions), node);
+		} catch (EvaluationException const&) {
+			// left for run time
+		}
+	}
+
+	if (operand == unary.getOperand())
+		return node;
+	return std::make_shared<Unary>(unary.getOp(), operand);
+}
+
+NodePtr ConstantFolder::foldBinary(NodePtr const& node) {
+	std::vector<Binary const*> chain = Binary::chainOf(static_cast<Binary const&>(*node));
+	NodePtr folded = foldNode(chain[0]->getLeft());
+	for (size_t i = 0; i < chain.size(); i++) {
+		// the node owning each operator is the left operand of the next one
+		NodePtr const& original = (i + 1 < chain.size()) ? chain[i + 1]->getLeft() : node;
+		folded = foldBinary(original, folded, foldNode(chain[i]->getRight()));
+	}
+	return folded;
+}
+
+NodePtr ConstantFolder::foldBinary(NodePtr const& node, NodePtr const& left, NodePtr const& right) {
+	Binary const& binary = static_cast<Binary const&>(*node);
+	int op = binary.getOp();
+
+	Literal const* leftLiteral = asLiteral(left);
+	Literal const* rightLiteral = asLiteral(right);
+
+	if (leftLiteral && (op == '&' || op == '|')) {
+		// the left operand decides which operand is the result; the other one is never evaluated
+		bool leftIsResult = (Value::isTrue(leftLiteral->getConstant()) == (op == '|'));
+		if (leftLiteral->getAssumptions().empty())
+			return leftIsResult ? left : right;
+		if (leftIsResult || rightLiteral) {
+			Literal const* result = leftIsResult ? leftLiteral : rightLiteral;
+			std::vector<Literal::Assumption> assumptions;
+			assume(assumptions, *leftLiteral);
+			assume(assumptions, *result);
+			return std::make_shared<Literal>(result->getConstant(), std::move(assumptions), node);
+		}
+	} else if (leftLiteral && rightLiteral) {
+		try {
+			Value result = Binary::apply(op, leftLiteral->getConstant(), rightLiteral->getConstant());
+			std::vector<Literal::Assumption> assumptions;
+			assume(assumptions, *leftLiteral);
+			assume(assumptions, *rightLiteral);
+			return std::make_shared<Literal>(result, std::move(assumptions), node);
+		} catch (EvaluationException const&) {
+			// left for run time
+		}
+	}
+
+	if (left == binary.getLeft() && right == binary.getRight())
+		return node;
+	return std::make_shared<Binary>(op, left, right);
+}
+
+NodePtr ConstantFolder::foldIndex(NodePtr const& node) {
+	Index const& index = static_cast<Index const&>(*node);
+	NodePtr target = foldNode(index.getTarget());
+	NodePtr arg = foldNode(index.getIndex());
+
+	Literal const* targetLiteral = asLiteral(target);
+	Literal const* argLiteral = asLiteral(arg);
+	if (targetLiteral && argLiteral) {
+		try {
+			Value result = Value::index(targetLiteral->getConstant(), argLiteral->getConstant());
+			std::vector<Literal::Assumption> assumptions;
+			assume(assumptions, *targetLiteral);
+			assume(assumptions, *argLiteral);
+			return std::make_shared<Literal>(result, std::move(assumptions), node);
+		} catch (Exception const&) {
+			// left for run time
+		}
+	}
+
+	if (target == index.getTarget() && arg == index.getIndex())
+		return node;
+	return std::make_shared<Index>(target, arg);
+}
+
+NodePtr ConstantFolder::foldMember(NodePtr const& node) {
+	Member const& member = static_cast<Member const&>(*node);
+	NodePtr target = foldNode(member.getTarget());
+
+	// a nil target is looked up as a dotted name, which depends on the resolver
+	Literal const* literal = asLiteral(target);
+	if (literal && !literal->getConstant().isNil()) {
+		try {
+			Value result = Value::member(literal->getConstant(), member.getName(), NullResolver());
+			std::vector<Literal::Assumption> assumptions;
+			assume(assumptions, *literal);
+			return std::make_shared<Literal>(result, std::move(assumptions), node);
+		} catch (Exception const&) {
+			// left for run time
+		}
+	}
+
+	if (target == member.getTarget())
+		return node;
+	return std::make_shared<Member>(target, member.getName());
+}
+
+NodePtr ConstantFolder::foldCall(NodePtr const& node) {
+	Call const& call = static_cast<Call const&>(*node);
+	NodePtr target = foldNode(call.getTarget());
+
+	bool argsChanged = false;
+	std::vector<Call::Arg> args;
+	args.reserve(call.getArgs().size());
+	for (Call::Arg const& arg : call.getArgs()) {
+		Call::Arg folded;
+		folded._eager = foldNode(arg._eager);
+		NodePtr const& lazyNode = arg._lazy->getNode();
+		NodePtr foldedLazy = (lazyNode == arg._eager) ? folded._eager : foldNode(lazyNode);
+		if (foldedLazy == lazyNode)
+			folded._lazy = arg._lazy;
+		else
+			folded._lazy = std::make_shared<Expression>(arg._lazy->getText(), foldedLazy);
+		argsChanged = argsChanged || (folded._eager != arg._eager) || (folded._lazy != arg._lazy);
+		args.push_back(std::move(folded));
+	}
+
+	Literal const* targetLiteral = asLiteral(target);
+	if (targetLiteral && instanceof<Function>(targetLiteral->getValue())) {
+		SPtr<Function> func = Class::cast<Function>(targetLiteral->getValue());
+		std::vector<Literal::Assumption> assumptions;
+		assume(assumptions, *targetLiteral);
+
+		if (func == ExpressionEvaluator::_builtins->get("if"_HS)) {
+			// constant condition and selected branch
+			Literal const* condition = (args.size() == 2 || args.size() == 3) ? asLiteral(args[0]._eager) : nullptr;
+			if (condition) {
+				assume(assumptions, *condition);
+				if (Value::isTrue(condition->getConstant())) {
+					if (Literal const* branch = asLiteral(args[1]._lazy->getNode())) {
+						assume(assumptions, *branch);
+						return std::make_shared<Literal>(branch->getConstant(), std::move(assumptions), node);
+					}
+				} else if (args.size() == 2)
+					return std::make_shared<Literal>(Value(std::make_shared<String>("")), std::move(assumptions), node);
+				else if (Literal const* branch = asLiteral(args[2]._lazy->getNode())) {
+					assume(assumptions, *branch);
+					return std::make_shared<Literal>(branch->getConstant(), std::move(assumptions), node);
+				}
+			}
+		} else if (func->isPure()) {
+			try {
+				SPtr<const String> symbolName = targetLiteral->getConstant().getName();
+				if (!symbolName)
+					symbolName = StringPool::global().intern("<unknown>"_SV);
+				FunctionArgs params(func, symbolName);
+				bool constant = true;
+				for (Call::Arg const& arg : args) {
+					Literal const* argLiteral = asLiteral(arg._eager);
+					if (!argLiteral || params.peek() == EXPRESSIONCLASS) {
+						constant = false;
+						break;
+					}
+					assume(assumptions, *argLiteral);
+					params.add(argLiteral->getValue());
+				}
+				if (constant) {
+					SPtr<Value> result = func->evaluate(NullResolver(), params);
+					return std::make_shared<Literal>(*result, std::move(assumptions), node);
+				}
+			} catch (Exception const&) {
+				// left for run time
+			}
+		}
+	}
+
+	// a builtin referenced by name only saves a lookup, while the compiler recognizes some
+	// calls by their name (if())
+	if (call.getTarget()->kind() == Node::Kind::SYMBOL)
+		target = call.getTarget();
+
+	if (target == call.getTarget() && !argsChanged)
+		return node;
+	return std::make_shared<Call>(target, std::move(args));
+}
+
+} // namespace expr
+} // namespace slib
@@ -0,0 +1,54 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_UTIL_EXPR_CONSTANTFOLDER_H
+#define H_SLIB_UTIL_EXPR_CONSTANTFOLDER_H
+
+#include "slib/util/expr/Ast.h"
+
+namespace slib {
+namespace expr {
+
+/**
+ * Compile-time simplification of syntax trees. Replaces with literals:
+ * <ul>
+ * <li>operators applied to constants (e.g. <code>1024 * 1024</code>)</li>
+ * <li>references to builtins and their members (e.g. <code>math.ceil</code>)</li>
+ * <li>calls to pure functions with constant arguments (e.g. <code>math.ceil(3.7)</code>)</li>
+ * <li>if() with a constant condition, when the selected branch is constant too</li>
+ * </ul>
+ * Subtrees that fail to evaluate are left alone, so the error is still raised at run time, and
+ * only if the subtree is actually evaluated. Values derived from builtins remember the builtins
+ * they were computed from (see Literal).
+ */
+class ConstantFolder {
+private:
+	/** @return folded node, or <i>node</i> itself if nothing changed */
+	static ast::NodePtr foldNode(ast::NodePtr const& node);
+
+	static ast::NodePtr foldUnary(ast::NodePtr const& node);
+	/** Folds a chain of binary operators, one operator at a time from the innermost one */
+	static ast::NodePtr foldBinary(ast::NodePtr const& node);
+
+	/**
+	 * @param node  binary operator
+	 * @param left, right  its folded operands
+	 */
+	static ast::NodePtr foldBinary(ast::NodePtr const& node, ast::NodePtr const& left, ast::NodePtr const& right);
+	static ast::NodePtr foldIndex(ast::NodePtr const& node);
+	static ast::NodePtr foldMember(ast::NodePtr const& node);
+	static ast::NodePtr foldCall(ast::NodePtr const& node);
+public:
+	/**
+	 * Folds the constant parts of a syntax tree
+	 * @param root  root node
+	 * @return simplified tree; nodes that did not change are shared with the original
+	 */
+	static ast::NodePtr fold(ast::NodePtr const& root);
+};
+
+} // namespace expr
+} // namespace slib
+
+#endif // H_SLIB_UTIL_EXPR_CONSTANTFOLDER_H
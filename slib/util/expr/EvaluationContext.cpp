@@ -0,0 +1,74 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "slib/util/expr/EvaluationContext.h"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace slib {
+namespace expr {
+
+const uint64_t EvaluationContext::CLOCK_CHECK_STEPS;
+
+thread_local EvaluationContext *EvaluationContext::_current = nullptr;
+
+EvaluationContext::EvaluationContext()
+:_previous(_current)
+,_steps(0)
+,_maxSteps(std::numeric_limits<uint64_t>::max())
+,_nextCheck(std::numeric_limits<uint64_t>::max())
+,_hasDeadline(false)
+,_maxStringLength(std::numeric_limits<size_t>::max()) {
+	_current = this;
+}
+
+EvaluationContext::~EvaluationContext() {
+	_current = _previous;
+}
+
+EvaluationContext& EvaluationContext::setMaxSteps(uint64_t maxSteps) {
+	_maxSteps = maxSteps;
+	updateNextCheck();
+	return *this;
+}
+
+EvaluationContext& EvaluationContext::setTimeout(Clock::duration timeout) {
+	_hasDeadline = true;
+	_deadline = Clock::now() + timeout;
+	updateNextCheck();
+	return *this;
+}
+
+EvaluationContext& EvaluationContext::setMaxStringLength(size_t maxLength) {
+	_maxStringLength = maxLength;
+	return *this;
+}
+
+void EvaluationContext::updateNextCheck() {
+	// the first step over the budget, if any
+	_nextCheck = (_maxSteps == std::numeric_limits<uint64_t>::max()) ? _maxSteps : _maxSteps + 1;
+	if (_hasDeadline && (_nextCheck > _steps + CLOCK_CHECK_STEPS))
+		_nextCheck = _steps + CLOCK_CHECK_STEPS;
+}
+
+void EvaluationContext::check() {
+	if (_steps > _maxSteps)
+		throw BudgetExceededException(_HERE_, fmt::format("Evaluation step budget exceeded ({} steps)", _maxSteps).c_str());
+	if (_hasDeadline && (Clock::now() >= _deadline)) {
+		// any further step fails as well
+		_nextCheck = _steps;
+		throw BudgetExceededException(_HERE_, "Evaluation deadline exceeded");
+	}
+	updateNextCheck();
+}
+
+void EvaluationContext::stringTooLong(size_t length) {
+	throw BudgetExceededException(_HERE_, fmt::format("String length limit exceeded ({} > {})", length, _maxStringLength).c_str());
+}
+
+} // namespace expr
+} // namespace slib
@@ -0,0 +1,110 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_UTIL_EXPR_EVALUATIONCONTEXT_H
+#define H_SLIB_UTIL_EXPR_EVALUATIONCONTEXT_H
+
+#include "slib/util/expr/Exceptions.h"
+
+#include <chrono>
+#include <cstdint>
+
+namespace slib {
+namespace expr {
+
+/**
+ * Limits on the evaluations made by the current thread while the context exists, for
+ * evaluating untrusted expressions (such as templates in configuration files) without
+ * stalling the thread: a budget of evaluation steps, a wall-clock deadline and a maximum
+ * length for strings built by concatenation (including for() results), by format() and
+ * by interpolation. An evaluation that exceeds any of them throws a
+ * BudgetExceededException, and so does any further evaluation in the same context.
+ *
+ * A step is roughly one operation: one per operand for the interpreter, one per bytecode
+ * instruction of each compiled expression run (whether executed or jumped over) and one
+ * per for() iteration. The deadline is only checked every CLOCK_CHECK_STEPS steps, so a
+ * single long running function call is not interrupted.
+ *
+ * Contexts nest: a new context replaces the current one until it is destroyed. Evaluations
+ * on other threads (such as those of Config's parallel loading) are not limited.
+ */
+class EvaluationContext {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	static const uint64_t CLOCK_CHECK_STEPS = 1024;
+private:
+	static thread_local EvaluationContext *_current;
+
+	EvaluationContext *_previous;
+	uint64_t _steps;
+	uint64_t _maxSteps;
+	/** step count at which the limits are checked next */
+	uint64_t _nextCheck;
+	bool _hasDeadline;
+	Clock::time_point _deadline;
+	size_t _maxStringLength;
+
+	void updateNextCheck();
+
+	/** @throws BudgetExceededException */
+	void check();
+
+	/** @throws BudgetExceededException */
+	void stringTooLong(size_t length);
+public:
+	/** Creates a context without limits, current on this thread until destroyed */
+	EvaluationContext();
+
+	~EvaluationContext();
+
+	EvaluationContext(EvaluationContext const&) = delete;
+	EvaluationContext& operator=(EvaluationContext const&) = delete;
+
+	EvaluationContext& setMaxSteps(uint64_t maxSteps);
+
+	/** Sets the deadline to the given time from now */
+	EvaluationContext& setTimeout(Clock::duration timeout);
+
+	EvaluationContext& setMaxStringLength(size_t maxLength);
+
+	/** @return steps counted so far */
+	uint64_t getSteps() const {
+		return _steps;
+	}
+
+	/** @return the context of the current thread, or nullptr if none */
+	static EvaluationContext *current() {
+		return _current;
+	}
+
+	/**
+	 * Counts evaluation steps against the context of the current thread, if any
+	 * @throws BudgetExceededException
+	 */
+	static void step(uint64_t steps = 1) {
+		EvaluationContext *context = _current;
+		if (context) {
+			context->_steps += steps;
+			if (context->_steps >= context->_nextCheck)
+				context->check();
+		}
+	}
+
+	/**
+	 * Checks the length of a string about to be built against the context of the current
+	 * thread, if any
+	 * @throws BudgetExceededException
+	 */
+	static void checkStringLength(size_t length) {
+		EvaluationContext *context = _current;
+		if (context && length > context->_maxStringLength)
+			context->stringTooLong(length);
+	}
+};
+
+} // namespace expr
+} // namespace slib
+
+#endif // H_SLIB_UTIL_EXPR_EVALUATIONCONTEXT_H
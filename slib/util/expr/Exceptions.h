@@ -43,14 +43,14 @@ public:
 
 class MissingSymbolException : public EvaluationException {
 private:
-	SPtr<String> _name;
+	SPtr<const String> _name;
 public:
-	MissingSymbolException(const char *where, SPtr<String> const& name)
+	MissingSymbolException(const char *where, SPtr<const String> const& name)
 	:EvaluationException(where, "MissingSymbolException",
-						 fmt::format("Symbol '{}' could not be located", name->c_str()).c_str())
+						 fmt::format("Symbol '{}' could not be located", name ? name->c_str() : "<unknown>").c_str())
 	,_name(name) {}
 
-	SPtr<String> getSymbolName() const {
+	SPtr<const String> getSymbolName() const {
 		return _name;
 	}
 };
@@ -71,6 +71,13 @@ public:
 
 };
 
+/** An evaluation exceeded a limit of its EvaluationContext */
+class BudgetExceededException : public EvaluationException {
+public:
+	BudgetExceededException(const char *where, const char *msg)
+	:EvaluationException(where, "BudgetExceededException", msg) {}
+};
+
 } // namespace expr
 } // namespace slib
 
@@ -3,7 +3,8 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "slib/util/expr/Expression.h"
-#include "slib/util/expr/ExpressionEvaluator.h"
+#include "slib/util/expr/CompiledExpression.h"
+#include "slib/util/expr/Bytecode.h"
 
 namespace slib {
 namespace expr {
@@ -13,7 +14,27 @@ Expression::~Expression() {}
 constexpr Class Expression::_class;
 
 SPtr<Value> Expression::evaluate(Resolver const& resolver) {
-	return ExpressionEvaluator::expressionValue(std::make_shared<ExpressionInputStream>(_text), resolver);
+	return std::make_shared<Value>(execute(resolver));
+}
+
+SPtr<const Program> Expression::getProgram() const {
+	SPtr<const Program> program = std::atomic_load(&_program);
+	if (program)
+		return program;
+
+	SPtr<const ast::Node> node = std::atomic_load(&_node);
+	if (!node) {
+		ExpressionInputStream input(_text);
+		node = CompiledExpression::parse(input);
+		std::atomic_store(&_node, node);
+	}
+	program = Program::compile(ConstantFolder::fold(node));
+	std::atomic_store(&_program, program);
+	return program;
+}
+
+Value Expression::execute(Resolver const& resolver) {
+	return getProgram()->execute(resolver);
 }
 
 } // namespace expr
@@ -8,19 +8,39 @@
 #include "slib/lang/Object.h"
 #include "slib/lang/String.h"
 
+#include <memory>
+
 namespace slib {
 namespace expr {
 
 class Value;
 class Resolver;
 
+namespace ast {
+	class Node;
+}
+
+class Program;
+
+/**
+ * Unevaluated expression (function argument). The text is compiled on first evaluation
+ * and the compiled form is kept for subsequent evaluations; concurrent first evaluations
+ * may each compile it, only one compiled form is kept.
+ */
 class Expression : virtual public Object {
 private:
 	SPtr<String> _text;
+	mutable SPtr<const ast::Node> _node;
+	mutable SPtr<const Program> _program;
 public:
 	Expression(SPtr<String> const& text)
 	:_text(text) {}
 
+	/** Creates an already parsed expression */
+	Expression(SPtr<String> const& text, SPtr<const ast::Node> const& node)
+	:_text(text)
+	,_node(node) {}
+
 	virtual ~Expression() override;
 
 	static constexpr Class _class = EXPRESSIONCLASS;
@@ -29,8 +49,29 @@ public:
 		return EXPRESSIONCLASS;
 	}
 
+	SPtr<String> const& getText() const {
+		return _text;
+	}
+
+	/** @return syntax tree, or nullptr if not parsed yet */
+	SPtr<const ast::Node> getNode() const {
+		return std::atomic_load(&_node);
+	}
+
+	/**
+	 * @return compiled program, compiled now if it was not yet
+	 * @throws EvaluationException on syntax errors
+	 */
+	SPtr<const Program> getProgram() const;
+
 	/** @throws EvaluationException */
 	std::shared_ptr<Value> evaluate(Resolver const& resolver);
+
+	/**
+	 * Same as evaluate(), with the result returned by value (not boxed if numeric)
+	 * @throws EvaluationException
+	 */
+	Value execute(Resolver const& resolver);
 };
 
 } // namespace expr
@@ -0,0 +1,37 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "slib/util/expr/ExpressionCache.h"
+
+namespace slib {
+namespace expr {
+
+ExpressionCache& ExpressionCache::global() {
+	static ExpressionCache cache;
+	return cache;
+}
+
+SPtr<CompiledExpression> ExpressionCache::compile(String const& text) {
+	return CompiledExpression::compile(std::make_shared<String>(text));
+}
+
+/** Compiles from a private copy of the text, as the caller's string may be mutable */
+static SPtr<CompiledExpression> compileCopy(BasicString const& text) {
+	return CompiledExpression::compile(std::make_shared<String>(text.c_str(), text.length()));
+}
+
+SPtr<CompiledExpression> ExpressionCache::get(SPtr<BasicString> const& text) {
+	return SourceCache::get(*text, [&text]() {
+		return compileCopy(*text);
+	});
+}
+
+SPtr<CompiledExpression> ExpressionCache::getRepeated(SPtr<BasicString> const& text) {
+	return SourceCache::getRepeated(*text, [&text]() {
+		return compileCopy(*text);
+	});
+}
+
+} // namespace expr
+} // namespace slib
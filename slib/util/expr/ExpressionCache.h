@@ -0,0 +1,50 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_UTIL_EXPR_EXPRESSIONCACHE_H
+#define H_SLIB_UTIL_EXPR_EXPRESSIONCACHE_H
+
+#include "slib/util/expr/CompiledExpression.h"
+#include "slib/util/expr/SourceCache.h"
+
+namespace slib {
+namespace expr {
+
+/**
+ * Bounded, thread-safe cache of compiled expressions, keyed by source text (see SourceCache).
+ * Compiled expressions are immutable, so a cached instance is evaluated concurrently against
+ * different resolvers.
+ */
+class ExpressionCache : public SourceCache<CompiledExpression> {
+private:
+	static SPtr<CompiledExpression> compile(String const& text);
+public:
+	/** @param capacity  maximum number of cached expressions (rounded up to a multiple of the shard count) */
+	ExpressionCache(size_t capacity = DEFAULT_CAPACITY)
+	:SourceCache(&ExpressionCache::compile, capacity) {}
+
+	/** Shared cache used by ExpressionEvaluator::expressionValue() */
+	static ExpressionCache& global();
+
+	using SourceCache::get;
+
+	/**
+	 * Returns the compiled form of an expression, compiling and caching it if necessary
+	 * @throws EvaluationException on syntax errors (failed compilations are not cached)
+	 */
+	SPtr<CompiledExpression> get(SPtr<BasicString> const& text);
+
+	/**
+	 * Same as get(), except that an expression is only compiled the second time it is looked up
+	 * (see SourceCache::getRepeated())
+	 * @return compiled expression, or <code>nullptr</code> the first time it is seen
+	 * @throws EvaluationException on syntax errors
+	 */
+	SPtr<CompiledExpression> getRepeated(SPtr<BasicString> const& text);
+};
+
+} // namespace expr
+} // namespace slib
+
+#endif // H_SLIB_UTIL_EXPR_EXPRESSIONCACHE_H
@@ -3,7 +3,11 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "slib/util/expr/ExpressionEvaluator.h"
+#include "slib/util/expr/ExpressionCache.h"
 #include "slib/util/expr/Function.h"
+#include "slib/util/expr/Ast.h"
+#include "slib/util/expr/Profiler.h"
+#include "slib/lang/StringPool.h"
 
 namespace slib {
 namespace expr {
@@ -11,14 +15,11 @@ namespace expr {
 SPtr<Object> ExpressionEvaluator::InternalResolver::getVar(const String &key) const {
 	SPtr<Object> value = _externalResolver.getVar(key);
 
-	/*HashMap<String, Object> *b = (HashMap<String, Object>*)_builtins.get();
-	b->forEach([](String const& key1, SPtr<Object> const& val) {
-		fmt::print("b[{}, {}] = {}\n", key1, key1.hashCode(), val ? val->getClass().getName().c_str() : "null");
-		return true;
-	});*/
-
-	if (!value)
-		value = _builtins->get(key);
+	if (!value) {
+		FrozenMap<String, Object>::Entry const* builtin = _builtins->find(key);
+		if (builtin)
+			value = builtin->value();
+	}
 
 	//fmt::print("{}, {} -> {}\n", key, key.hashCode(), value ? value->getClass().getName().c_str() : "null");
 
@@ -27,49 +28,89 @@ SPtr<Object> ExpressionEvaluator::InternalResolver::getVar(const String &key) co
 
 ExpressionEvaluator::LoopResolver::~LoopResolver() {}
 
+namespace {
+
+/** sub-expressions being evaluated by the interpreter on this thread */
+thread_local uint32_t nesting = 0;
+
+/** Bounds the recursion of the interpreter, as CompiledExpression bounds the depth of its trees */
+class NestingScope {
+public:
+	/** @throws SyntaxErrorException */
+	NestingScope() {
+		if (nesting >= CompiledExpression::MAX_DEPTH)
+			throw SyntaxErrorException(_HERE_, fmt::format("Expression nested deeper than {} levels", CompiledExpression::MAX_DEPTH).c_str());
+		nesting++;
+	}
+
+	~NestingScope() {
+		nesting--;
+	}
+};
+
+} // namespace
+
 UPtr<String> ExpressionEvaluator::strExpressionValue(SPtr<BasicString> const& input, Resolver const& resolver) {
-	return strExpressionValue(std::make_shared<ExpressionInputStream>(input), InternalResolver(resolver));
+	SPtr<CompiledExpression> compiled;
+	try {
+		// compiling only pays off for expressions evaluated more than once
+		compiled = ExpressionCache::global().getRepeated(input);
+	} catch (EvaluationException const&) {
+		// the interpreter reports the error exactly where it finds it
+	}
+	if (!compiled) {
+		Profiler::EvaluationScope scope(*input);
+		return strExpressionValue(std::make_shared<ExpressionInputStream>(input), InternalResolver(resolver));
+	}
+	return compiled->strValue(resolver);
 }
 
 SPtr<Object> ExpressionEvaluator::expressionValue(const SPtr<BasicString> &input, Resolver const& resolver) {
-	SPtr<Value> val = expressionValue(std::make_shared<ExpressionInputStream>(input), InternalResolver(resolver));
-	if (val->_value) {
-		if (instanceof<Double>(val->_value)) {
-			double d = Class::cast<Double>(val->_value)->doubleValue();
-			if (Number::isMathematicalInteger(d)) {
-				int32_t i = (int32_t)d;
-				if (i == d)
-					return std::make_shared<Integer>(i);
-				return std::make_shared<Long>((uint64_t)d);
-			}
-		}
+	SPtr<CompiledExpression> compiled;
+	try {
+		// compiling only pays off for expressions evaluated more than once
+		compiled = ExpressionCache::global().getRepeated(input);
+	} catch (EvaluationException const&) {
+		// the interpreter reports the error exactly where it finds it
+	}
+	if (!compiled) {
+		Profiler::EvaluationScope scope(*input);
+		return normalize(evaluate(std::make_shared<ExpressionInputStream>(input), InternalResolver(resolver)));
 	}
-	return val->_value;
+	return compiled->value(resolver);
 }
 
-// surrogate values for multi-char operators
-static const int OP_LTE = 500;
-static const int OP_GTE = 501;
-static const int OP_EQ = 502;
-static const int OP_NEQ = 503;
+SPtr<Object> ExpressionEvaluator::normalize(Value const& val) {
+	if (val._type == Value::Type::DOUBLE) {
+		double d = val._double;
+		if (Number::isMathematicalInteger(d)) {
+			int32_t i = (int32_t)d;
+			if (i == d)
+				return std::make_shared<Integer>(i);
+			return std::make_shared<Long>((uint64_t)d);
+		}
+	}
+	return val.getValue();
+}
 
 UPtr<String> ExpressionEvaluator::strExpressionValue(const SPtr<ExpressionInputStream> &input, Resolver const& resolver) {
-	SPtr<Value> val = expressionValue(input, resolver);
-	Value::checkNil(*val);
-	if (instanceof<Number>(val->_value)) {
-		double d = Class::cast<Number>(val->_value)->doubleValue();
-		if (Number::isMathematicalInteger(d))
-			return Long::toString((long)d);
-		else
-			return Double::toString(d);
-	} else
-		return val->_value->toString();
+	return toString(evaluate(input, resolver));
+}
+
+UPtr<String> ExpressionEvaluator::toString(Value const& val) {
+	Value::checkNil(val);
+	return val.asString();
 }
 
 SPtr<Value> ExpressionEvaluator::expressionValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver) {
+	return std::make_shared<Value>(evaluate(input, resolver));
+}
+
+Value ExpressionEvaluator::evaluate(SPtr<ExpressionInputStream> const& input, Resolver const& resolver) {
+	NestingScope scope;
 	input->skipBlanks();
 
-	SPtr<Value> val = prefixTermValue(input, resolver);
+	Value val = prefixTermValue(input, resolver);
 	input->skipBlanks();
 	while (input->peek() == '+' || input->peek() == '-' ||
 		   input->peek() == '&' || input->peek() == '|' ||
@@ -79,61 +120,33 @@ SPtr<Value> ExpressionEvaluator::expressionValue(SPtr<ExpressionInputStream> con
 		if (op == '<') {
 			if (input->peek() == '=') {
 				input->readChar();
-				op = OP_LTE;
+				op = ast::Binary::OP_LTE;
 			}
 		} else if (op == '>') {
 			if (input->peek() == '=') {
 				input->readChar();
-				op = OP_GTE;
+				op = ast::Binary::OP_GTE;
 			}
 		} else if (op == '=') {
 			if (input->peek() == '=') {
 				input->readChar();
-				op = OP_EQ;
+				op = ast::Binary::OP_EQ;
 			}
 		} else if (op == '~') {
 			if (input->peek() == '=') {
 				input->readChar();
-				op = OP_NEQ;
+				op = ast::Binary::OP_NEQ;
 			} else
 				throw SyntaxErrorException(_HERE_, fmt::format("Unknown operator '~{}'", input->peek()).c_str());
 		}
 
 		input->skipBlanks();
-		SPtr<Value> nextVal = prefixTermValue(input, resolver);
-		switch (op) {
-			case '+':
-				val = val->add(nextVal);
-				break;
-			case '-':
-				val = val->subtract(nextVal);
-				break;
-			case '&':
-				val = val->logicalAnd(nextVal);
-				break;
-			case '|':
-				val = val->logicalOr(nextVal);
-				break;
-			case '<':
-				val = std::make_shared<Value>(std::make_shared<Integer>(val->lt(nextVal) ? 1 : 0));
-				break;
-			case OP_LTE:
-				val = std::make_shared<Value>(std::make_shared<Integer>(val->lte(nextVal) ? 1 : 0));
-				break;
-			case '>':
-				val = std::make_shared<Value>(std::make_shared<Integer>(val->gt(nextVal) ? 1 : 0));
-				break;
-			case OP_GTE:
-				val = std::make_shared<Value>(std::make_shared<Integer>(val->gte(nextVal) ? 1 : 0));
-				break;
-			case OP_EQ:
-				val = std::make_shared<Value>(std::make_shared<Integer>(val->eq(nextVal) ? 1 : 0));
-				break;
-			case OP_NEQ:
-				val = std::make_shared<Value>(std::make_shared<Integer>(val->eq(nextVal) ? 0 : 1));
-				break;
-			default:
-				throw SyntaxErrorException(_HERE_, fmt::format("Unknown operator '{}'", (char)op).c_str());
+		if (ast::Binary::shortCircuits(op, val)) {
+			// the right operand is only parsed, to get past it
+			CompiledExpression::parsePrefixTerm(*input);
+		} else {
+			Value nextVal = prefixTermValue(input, resolver);
+			val = ast::Binary::apply(op, val, nextVal);
 		}
 
 		input->skipBlanks();
@@ -148,26 +161,32 @@ SPtr<Value> ExpressionEvaluator::expressionValue(SPtr<ExpressionInputStream> con
 enum class InterState { APPEND, DOLLAR, READEXPR, STRING };
 
 /** @throws EvaluationException */
-UPtr<String> ExpressionEvaluator::interpolate(String const& pattern, Resolver const& resolver, bool ignoreMissing) {
-	StringBuilder result;
-
+template <class S>
+void ExpressionEvaluator::interpolateInto(String const& pattern, Resolver const& resolver, bool ignoreMissing, S &result) {
 	InterState state = InterState::APPEND;
+	const char *buffer = pattern.c_str();
+	size_t len = pattern.length();
 	size_t pos = 0;
 
 	size_t dollarBegin = 0;
 	char delim = 0;
 
-	while (pos < pattern.length()) {
-		char c = pattern.charAt(pos);
+	while (pos < len) {
+		char c = buffer[pos];
 		switch (state) {
-			case InterState::APPEND:
-				if (c == '$') {
-					state = InterState::DOLLAR;
-					dollarBegin = pos;
-					break;
-				}
-				result.add(c);
+			case InterState::APPEND: {
+				// copy literal text up to the next '$' in one go
+				const char *dollar = (const char *)memchr(buffer + pos, '$', len - pos);
+				size_t end = dollar ? (size_t)(dollar - buffer) : len;
+				if (end > pos)
+					result.add(buffer + pos, (std::ptrdiff_t)(end - pos));
+				if (!dollar)
+					return;
+				state = InterState::DOLLAR;
+				dollarBegin = end;
+				pos = end;
 				break;
+			}
 			case InterState::DOLLAR:
 				if (c == '$') {
 					state = InterState::APPEND;
@@ -184,7 +203,9 @@ UPtr<String> ExpressionEvaluator::interpolate(String const& pattern, Resolver co
 				if (c == '}') {
 					SPtr<String> expr = pattern.substring(dollarBegin + 2, pos);
 					try {
+						Profiler::EvaluationScope scope(*expr);
 						UPtr<String> exprValue = strExpressionValue(std::make_shared<ExpressionInputStream>(expr), resolver);
+						EvaluationContext::checkStringLength(result.length() + exprValue->length());
 						result.add(*exprValue);
 					} catch (MissingSymbolException const& e) {
 						if (ignoreMissing) {
@@ -208,10 +229,20 @@ UPtr<String> ExpressionEvaluator::interpolate(String const& pattern, Resolver co
 		}
 		pos++;
 	}
+}
 
+/** @throws EvaluationException */
+UPtr<String> ExpressionEvaluator::interpolate(String const& pattern, Resolver const& resolver, bool ignoreMissing) {
+	StringBuilder result;
+	interpolateInto(pattern, resolver, ignoreMissing, result);
 	return result.toString();
 }
 
+/** @throws EvaluationException */
+void ExpressionEvaluator::interpolate(String const& pattern, Resolver const& resolver, bool ignoreMissing, ChunkedStringBuilder &result) {
+	interpolateInto(pattern, resolver, ignoreMissing, result);
+}
+
 class ResultHolder {
 private:
 	SPtr<Value> _result;
@@ -231,9 +262,12 @@ public:
 		if (_result)
 			convertToString();
 
-		if (_strResult)
-			_strResult->add(ExpressionEvaluator::strExpressionValue(std::make_shared<ExpressionInputStream>(expr), resolver));
-		else
+		Profiler::EvaluationScope scope(*expr);
+		if (_strResult) {
+			UPtr<String> exprValue = ExpressionEvaluator::strExpressionValue(std::make_shared<ExpressionInputStream>(expr), resolver);
+			EvaluationContext::checkStringLength(_strResult->length() + exprValue->length());
+			_strResult->add(*exprValue);
+		} else
 			_result = ExpressionEvaluator::expressionValue(std::make_shared<ExpressionInputStream>(expr), ExpressionEvaluator::InternalResolver(resolver));
 	}
 
@@ -265,7 +299,7 @@ public:
 		if (!_strResult) {
 			if (!_result)
 				return std::make_shared<String>("");
-			return _result->_value;
+			return _result->getValue();
 		} else
 			return _strResult->toString();
 	}
@@ -334,7 +368,8 @@ SPtr<Object> ExpressionEvaluator::smartInterpolate(String const& pattern, Resolv
 		return result.toObject();
 	}
 
-SPtr<Value> ExpressionEvaluator::prefixTermValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver) {
+Value ExpressionEvaluator::prefixTermValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver) {
+	EvaluationContext::step();
 	bool negative = false;
 	bool negate = false;
 
@@ -346,36 +381,31 @@ SPtr<Value> ExpressionEvaluator::prefixTermValue(SPtr<ExpressionInputStream> con
 		negate = true;
 	}
 
-	SPtr<Value> val = termValue(input, resolver);
+	Value val = termValue(input, resolver);
 	if (negative)
-		val = val->inverse();
+		val = Value::inverse(val);
 	else if (negate)
-		val = val->logicalNegate();
+		val = Value::logicalNegate(val);
 
 	return val;
 }
 
-SPtr<Value> ExpressionEvaluator::termValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver) {
+Value ExpressionEvaluator::termValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver) {
 	input->skipBlanks();
-	SPtr<Value> val = factorValue(input, resolver);
+	Value val = factorValue(input, resolver);
 	input->skipBlanks();
 	while (input->peek() == '*' || input->peek() == '/' || input->peek() == '%') {
 		char op = input->readChar();
-		SPtr<Value> nextVal = factorValue(input, resolver);
-		if (op == '*')
-			val = val->multiply(nextVal);
-		else if (op == '/')
-			val = val->divide(nextVal);
-		else
-			val = val->remainder(nextVal);
+		Value nextVal = factorValue(input, resolver);
+		val = ast::Binary::apply(op, val, nextVal);
 		input->skipBlanks();
 	}
 	return val;
 }
 
-SPtr<Value> ExpressionEvaluator::factorValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver) {
+Value ExpressionEvaluator::factorValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver) {
 	input->skipBlanks();
-	SPtr<Value> val = primaryValue(input, resolver);
+	Value val = primaryValue(input, resolver);
 
 	bool inFactor = true;
 	while (inFactor) {
@@ -385,52 +415,41 @@ SPtr<Value> ExpressionEvaluator::factorValue(SPtr<ExpressionInputStream> const&
 			case '[':
 				{
 					input->readChar();
-					SPtr<Value> arg = expressionValue(input, resolver);
+					Value arg = evaluate(input, resolver);
 					input->skipBlanks();
 					if (input->peek() != ']')
 						throw SyntaxErrorException(_HERE_, "Missing right bracket after array argument");
 					input->readChar();
-					val = val->index(arg);
+					val = Value::index(val, arg);
 				}
 				break;
 			case '(':
 				{
-					if (!instanceof<Function>(val->_value))
+					if (!instanceof<Function>(val._value))
 						throw EvaluationException(_HERE_, "Not a function");
 
 					input->readChar();
 
 					// evaluate function
-					SPtr<Function> func = Class::cast<Function>(val->_value);
-					SPtr<String> symbolName = val->getName();
+					SPtr<Function> func = Class::cast<Function>(val._value);
+					SPtr<const String> symbolName = val.getName();
 					if (!symbolName)
-						symbolName = std::make_shared<String>("<unknown>");
-					FunctionArgs params(func, symbolName);
-
-					// check for 0 parameters
-					input->skipBlanks();
-					if (input->peek() == ')')
-						input->readChar();
-					else {
-						do {
-							Class const& argClass = params.peek();
-							if (argClass == EXPRESSIONCLASS)
-								params.add(input->readArg());
-							else
-								params.add(expressionValue(input, resolver)->_value);
-							input->skipBlanks();
-							if (input->peek() == ',') {
-								input->readChar();
-								continue;
-							} else if (input->peek() == ')') {
-								input->readChar();
-								break;
-							} else
-								throw SyntaxErrorException(_HERE_, fmt::format("Missing right paranthesis after function arguments ({})", *symbolName).c_str());
-						} while (true);
+						symbolName = StringPool::global().intern("<unknown>"_SV);
+					if (func->isDirect()) {
+						DirectArgs params(*func, symbolName);
+						readArgs(input, resolver, symbolName, params);
+						try {
+							val = params.call(resolver);
+						} catch (ClassCastException const& e) {
+							throw CastException(_HERE_, fmt::format("Cast exception in function {}()", *symbolName).c_str(), e);
+						}
+						break;
 					}
+
+					FunctionArgs params(func, symbolName);
+					readArgs(input, resolver, symbolName, params);
 					try {
-						val = func->evaluate(resolver, params);
+						val = *func->evaluate(resolver, params);
 					} catch (ClassCastException const& e) {
 						throw CastException(_HERE_, fmt::format("Cast exception in function {}()", *symbolName).c_str(), e);
 					}
@@ -439,8 +458,8 @@ SPtr<Value> ExpressionEvaluator::factorValue(SPtr<ExpressionInputStream> const&
 			case '.':
 				{
 					input->readChar();
-					SPtr<String> name = input->readName();
-					val = val->member(name, resolver);
+					SPtr<const String> name = input->readName();
+					val = Value::member(val, name, resolver);
 				}
 				break;
 			default:
@@ -452,24 +471,58 @@ SPtr<Value> ExpressionEvaluator::factorValue(SPtr<ExpressionInputStream> const&
 	return val;
 }
 
-SPtr<Value> ExpressionEvaluator::primaryValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver) {
+void ExpressionEvaluator::readArg(SPtr<ExpressionInputStream> const& input, Resolver const& resolver, FunctionArgs &params) {
+	Class const& argClass = params.peek();
+	if (argClass == EXPRESSIONCLASS)
+		params.add(input->readArg());
+	else
+		params.add(evaluate(input, resolver).getValue());
+}
+
+void ExpressionEvaluator::readArg(SPtr<ExpressionInputStream> const& input, Resolver const& resolver, DirectArgs &params) {
+	params.add(evaluate(input, resolver));
+}
+
+template <class A>
+void ExpressionEvaluator::readArgs(SPtr<ExpressionInputStream> const& input, Resolver const& resolver, SPtr<const String> const& symbolName, A &params) {
+	// check for 0 parameters
+	input->skipBlanks();
+	if (input->peek() == ')') {
+		input->readChar();
+		return;
+	}
+	do {
+		readArg(input, resolver, params);
+		input->skipBlanks();
+		if (input->peek() == ',') {
+			input->readChar();
+			continue;
+		} else if (input->peek() == ')') {
+			input->readChar();
+			break;
+		} else
+			throw SyntaxErrorException(_HERE_, fmt::format("Missing right paranthesis after function arguments ({})", *symbolName).c_str());
+	} while (true);
+}
+
+Value ExpressionEvaluator::primaryValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver) {
 	input->skipBlanks();
 	char ch = input->peek();
-	if (std::isdigit(ch))
-		return input->readNumber();
+	if (ASCII::isDigit(ch))
+		return *input->readNumber();
 	else if (ExpressionInputStream::isIdentifierStart(ch)) {
 		// symbol
 		return evaluateSymbol(input, resolver);
 	} else if (ch == '(') {
 		input->readChar();
-		SPtr<Value> val = expressionValue(input, resolver);
+		Value val = evaluate(input, resolver);
 		input->skipBlanks();
 		if (input->peek() != ')')
 			throw SyntaxErrorException(_HERE_, "Missing right paranthesis");
 		input->readChar();
 		return val;
 	} else if (ch == '\'' || ch == '\"') {
-		return input->readString();
+		return *input->readString();
 	} else if (ch == CharacterIterator::DONE)
 		throw SyntaxErrorException(_HERE_, "Unexpected end of line");
 	else if (ch == ')')
@@ -480,12 +533,10 @@ SPtr<Value> ExpressionEvaluator::primaryValue(SPtr<ExpressionInputStream> const&
 		throw SyntaxErrorException(_HERE_, fmt::format("Unexpected character '{}' encountered", ch).c_str());
 }
 
-SPtr<Value> ExpressionEvaluator::evaluateSymbol(SPtr<ExpressionInputStream> const& input, Resolver const& resolver) {
-	UPtr<String> symbolName = input->readName();
-	SPtr<Object> value = resolver.getVar(*symbolName);
-	if (value)
-		return std::make_shared<Value>(value, std::move(symbolName));
-	return Value::Nil(std::move(symbolName));
+Value ExpressionEvaluator::evaluateSymbol(SPtr<ExpressionInputStream> const& input, Resolver const& resolver) {
+	SPtr<const String> symbolName = input->readName();
+	Profiler::lookup();
+	return Value(resolver.getVar(*symbolName), symbolName);
 }
 
 } // namespace expr
@@ -8,16 +8,27 @@
 #include "slib/util/expr/ExpressionInputStream.h"
 #include "slib/util/expr/Resolver.h"
 #include "slib/lang/String.h"
+#include "slib/lang/ChunkedStringBuilder.h"
 #include "slib/collections/HashMap.h"
+#include "slib/collections/FrozenMap.h"
 
 namespace slib {
 namespace expr {
 
+class FunctionArgs;
+class DirectArgs;
+
 class ExpressionEvaluator {
 friend class Expression;
 friend class ResultHolder;
+friend class CompiledExpression;
+friend class Program;
+friend class ConstantFolder;
+friend class Template;
+friend class Batch;
 private:
-	static UPtr<Map<String, Object>> _builtins;
+	/** perfect hash table, built once at startup and shared read-only */
+	static UPtr<const FrozenMap<String, Object>> _builtins;
 
 	class InternalResolver : public Resolver {
 	private:
@@ -55,10 +66,17 @@ public:
 		}
 	};
 public:
-	/** @throws EvaluationException */
+	/**
+	 * Same as expressionValue(SPtr<BasicString> const&, Resolver const&), converted to a string
+	 * @throws EvaluationException
+	 */
 	static UPtr<String> strExpressionValue(SPtr<BasicString> const& input, Resolver const& resolver);
 
-	/** @throws EvaluationException */
+	/**
+	 * Evaluates an expression. The first time a text is seen it is interpreted; from the second
+	 * time on it is compiled once and taken from ExpressionCache::global().
+	 * @throws EvaluationException
+	 */
 	static SPtr<Object> expressionValue(SPtr<BasicString> const& input, Resolver const& resolver);
 
 	/** @throws EvaluationException */
@@ -67,26 +85,64 @@ public:
 	/** @throws EvaluationException */
 	static UPtr<String> interpolate(String const& pattern, Resolver const& resolver, bool ignoreMissing);
 
+	/**
+	 * Interpolates into a chunked builder, for very large outputs
+	 * @throws EvaluationException
+	 */
+	static void interpolate(String const& pattern, Resolver const& resolver, bool ignoreMissing, ChunkedStringBuilder &result);
+
 	/** @throws EvaluationException */
 	static SPtr<Object> smartInterpolate(String const& pattern, Resolver const& resolver, bool ignoreMissing);
 protected:
+	/**
+	 * Converts an evaluation result to the object returned to callers (integral doubles
+	 * become Integer or Long)
+	 */
+	static SPtr<Object> normalize(Value const& val);
+
+	/** @throws EvaluationException */
+	static UPtr<String> toString(Value const& val);
+
+	/** @throws EvaluationException */
+	template <class S>
+	static void interpolateInto(String const& pattern, Resolver const& resolver, bool ignoreMissing, S &result);
+
 	/** @throws EvaluationException */
 	static UPtr<String> strExpressionValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver);
 
+	/**
+	 * Same as expressionValue(), with the result returned by value (not boxed if numeric)
+	 * @throws EvaluationException
+	 */
+	static Value evaluate(SPtr<ExpressionInputStream> const& input, Resolver const& resolver);
+
+	/** @throws EvaluationException */
+	static Value prefixTermValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver);
+
+	/** @throws EvaluationException */
+	static Value termValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver);
+
 	/** @throws EvaluationException */
-	static SPtr<Value> prefixTermValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver);
+	static Value factorValue(std::shared_ptr<ExpressionInputStream> const& input, Resolver const& resolver);
 
 	/** @throws EvaluationException */
-	static SPtr<Value> termValue(SPtr<ExpressionInputStream> const& input, Resolver const& resolver);
+	static Value primaryValue(std::shared_ptr<ExpressionInputStream> const& input, Resolver const& resolver);
 
 	/** @throws EvaluationException */
-	static std::shared_ptr<Value> factorValue(std::shared_ptr<ExpressionInputStream> const& input, Resolver const& resolver);
+	static Value evaluateSymbol(std::shared_ptr<ExpressionInputStream> const& input, Resolver const& resolver);
 
 	/** @throws EvaluationException */
-	static std::shared_ptr<Value> primaryValue(std::shared_ptr<ExpressionInputStream> const& input, Resolver const& resolver);
+	static void readArg(SPtr<ExpressionInputStream> const& input, Resolver const& resolver, FunctionArgs &params);
 
 	/** @throws EvaluationException */
-	static std::shared_ptr<Value> evaluateSymbol(std::shared_ptr<ExpressionInputStream> const& input, Resolver const& resolver);
+	static void readArg(SPtr<ExpressionInputStream> const& input, Resolver const& resolver, DirectArgs &params);
+
+	/**
+	 * Reads the arguments of a function call, up to the closing parenthesis
+	 * @throws EvaluationException
+	 */
+	template <class A>
+	static void readArgs(SPtr<ExpressionInputStream> const& input, Resolver const& resolver, SPtr<const String> const& symbolName, A &params);
 };
 
 } // namespace expr
@@ -15,6 +15,7 @@
  */
 
 #include "slib/util/expr/ExpressionFormatter.h"
+#include "slib/util/expr/EvaluationContext.h"
 #include "slib/lang/Character.h"
 #include "slib/lang/Numeric.h"
 
@@ -247,33 +248,33 @@ int32_t ParserStateMachine::parseInt(const SPtr<CharBuffer> &buffer) {
 	}
 }
 
-static SPtr<Object> getArgument(ArgList const& args, int32_t index, SPtr<FormatToken> const& token, SPtr<Object> const& lastArgument, bool hasLastArgumentSet, bool allowNil) {
+static SPtr<Object> getArgument(ArgList const& args, size_t first, int32_t index, FormatToken const& token, SPtr<Object> const& lastArgument, bool hasLastArgumentSet, bool allowNil) {
 	if (index == FormatToken::LAST_ARGUMENT_INDEX && !hasLastArgumentSet)
 		throw MissingFormatArgumentException(_HERE_, "<");
 
-	if (index >= (ptrdiff_t)args.size() - 1) {
-		throw MissingFormatArgumentException(_HERE_, *token->getPlainText());
+	if (index >= (ptrdiff_t)args.size() - (ptrdiff_t)first) {
+		throw MissingFormatArgumentException(_HERE_, *token.getPlainText());
 	}
 
 	if (index == FormatToken::LAST_ARGUMENT_INDEX) {
 		return lastArgument;
 	}
 
-	return (allowNil ? args.getNullable((size_t)index + 1) : args.get((size_t)index + 1));
+	return (allowNil ? args.getNullable((size_t)index + first) : args.get((size_t)index + first));
 }
 
-static SPtr<String> padding(SPtr<FormatToken> const& token, StringBuilder &source, int32_t startIndex) {
+static void padding(FormatToken const& token, int32_t flags, StringBuilder &source, int32_t startIndex) {
 	int32_t start = startIndex;
-	bool paddingRight = token->isFlagSet(FormatToken::FLAG_MINUS);
+	bool paddingRight = (0 != (flags & FormatToken::FLAG_MINUS));
 	char paddingChar = ' '; // space as padding char.
-	if (token->isFlagSet(FormatToken::FLAG_ZERO))
+	if (0 != (flags & FormatToken::FLAG_ZERO))
 		paddingChar = '0';
 	else {
 		// if padding char is space, always pad from the head location.
 		start = 0;
 	}
-	int32_t width = token->getWidth();
-	int32_t precision = token->getPrecision();
+	int32_t width = token.getWidth();
+	int32_t precision = token.getPrecision();
 
 	size_t length = source.length();
 	if (precision >= 0) {
@@ -283,7 +284,8 @@ static SPtr<String> padding(SPtr<FormatToken> const& token, StringBuilder &sourc
 	if (width > 0)
 		width = std::max((int32_t)source.length(), width);
 	if ((int32_t)length >= width)
-		return source.toString();
+		return;
+	EvaluationContext::checkStringLength((size_t)width);
 
 	std::string insertString((size_t)width - length, paddingChar);
 
@@ -292,20 +294,18 @@ static SPtr<String> padding(SPtr<FormatToken> const& token, StringBuilder &sourc
 	} else {
 		source.insert((size_t)start, CPtr(insertString));
 	}
-	return source.toString();
 }
 
-static SPtr<String> formatBool(SPtr<FormatToken> const& token, SPtr<Object> const& arg) {
-	StringBuilder result;
+static void formatBool(StringBuilder &result, FormatToken const& token, SPtr<Object> const& arg) {
 	int startIndex = 0;
-	int32_t flags = token->getFlags();
+	int32_t flags = token.getFlags();
 
-	if (token->isFlagSet(FormatToken::FLAG_MINUS) && !token->isWidthSet())
-		throw MissingFormatWidthException(_HERE_, fmt::format("-{}", token->getConversionType()).c_str());
+	if (token.isFlagSet(FormatToken::FLAG_MINUS) && !token.isWidthSet())
+		throw MissingFormatWidthException(_HERE_, fmt::format("-{}", token.getConversionType()).c_str());
 
 	// only '-' is valid for flags
 	if (FormatToken::FLAGS_UNSET != flags && FormatToken::FLAG_MINUS != flags)
-		throw FormatFlagsConversionMismatchException(_HERE_, token->getStrFlags(), token->getConversionType());
+		throw FormatFlagsConversionMismatchException(_HERE_, token.getStrFlags(), token.getConversionType());
 
 	if (!arg) {
 		result.add("false");
@@ -314,40 +314,37 @@ static SPtr<String> formatBool(SPtr<FormatToken> const& token, SPtr<Object> cons
 	} else {
 		result.add("true");
 	}
-	return padding(token, result, startIndex);
+	padding(token, flags, result, startIndex);
 }
 
-static SPtr<String> formatString(SPtr<FormatToken> const& token, SPtr<Object> const& arg) {
-	StringBuilder result;
+static void formatString(StringBuilder &result, FormatToken const& token, SPtr<Object> const& arg) {
 	int startIndex = 0;
-	int32_t flags = token->getFlags();
+	int32_t flags = token.getFlags();
 
-	if (token->isFlagSet(FormatToken::FLAG_MINUS) && !token->isWidthSet())
-		throw MissingFormatWidthException(_HERE_, fmt::format("-{}", token->getConversionType()).c_str());
+	if (token.isFlagSet(FormatToken::FLAG_MINUS) && !token.isWidthSet())
+		throw MissingFormatWidthException(_HERE_, fmt::format("-{}", token.getConversionType()).c_str());
 
 	// only '-' is valid for flags
 	if (FormatToken::FLAGS_UNSET != flags && FormatToken::FLAG_MINUS != flags)
-		throw FormatFlagsConversionMismatchException(_HERE_, token->getStrFlags(), token->getConversionType());
+		throw FormatFlagsConversionMismatchException(_HERE_, token.getStrFlags(), token.getConversionType());
 
 	result.add(arg);
-	return padding(token, result, startIndex);
+	padding(token, flags, result, startIndex);
 }
 
-static SPtr<String> formatCharacter(SPtr<FormatToken> const& token, SPtr<Object> const& arg) {
-	StringBuilder result;
-
+static void formatCharacter(StringBuilder &result, FormatToken const& token, SPtr<Object> const& arg) {
 	int32_t startIndex = 0;
-	int32_t flags = token->getFlags();
+	int32_t flags = token.getFlags();
 
-	if (token->isFlagSet(FormatToken::FLAG_MINUS) && !token->isWidthSet())
-		throw MissingFormatWidthException(_HERE_, fmt::format("-{}", token->getConversionType()).c_str());
+	if (token.isFlagSet(FormatToken::FLAG_MINUS) && !token.isWidthSet())
+		throw MissingFormatWidthException(_HERE_, fmt::format("-{}", token.getConversionType()).c_str());
 
 	// only '-' is valid for flags
 	if (FormatToken::FLAGS_UNSET != flags && FormatToken::FLAG_MINUS != flags)
-		throw FormatFlagsConversionMismatchException(_HERE_, token->getStrFlags(), token->getConversionType());
+		throw FormatFlagsConversionMismatchException(_HERE_, token.getStrFlags(), token.getConversionType());
 
-	if (token->isPrecisionSet())
-		throw IllegalFormatPrecisionException(_HERE_, token->getPrecision());
+	if (token.isPrecisionSet())
+		throw IllegalFormatPrecisionException(_HERE_, token.getPrecision());
 
 	if (!arg)
 		result.add("null");
@@ -366,39 +363,38 @@ static SPtr<String> formatCharacter(SPtr<FormatToken> const& token, SPtr<Object>
 			result.add((char)codePoint);
 		} else {
 			// argument of other class is not acceptable.
-			throw IllegalFormatConversionException(_HERE_, token->getConversionType(), arg->getClass());
+			throw IllegalFormatConversionException(_HERE_, token.getConversionType(), arg->getClass());
 		}
 	}
-	return padding(token, result, startIndex);
+	padding(token, flags, result, startIndex);
 }
 
-static SPtr<String> formatPercent(SPtr<FormatToken> const& token) {
-	StringBuilder result("%");
+static void formatPercent(StringBuilder &result, FormatToken const& token) {
+	result.add('%');
 
 	int32_t startIndex = 0;
-	int32_t flags = token->getFlags();
+	int32_t flags = token.getFlags();
 
-	if (token->isFlagSet(FormatToken::FLAG_MINUS) && !token->isWidthSet())
-		throw MissingFormatWidthException(_HERE_, fmt::format("-{}", token->getConversionType()).c_str());
+	if (token.isFlagSet(FormatToken::FLAG_MINUS) && !token.isWidthSet())
+		throw MissingFormatWidthException(_HERE_, fmt::format("-{}", token.getConversionType()).c_str());
 
 	if (FormatToken::FLAGS_UNSET != flags && FormatToken::FLAG_MINUS != flags)
-		throw FormatFlagsConversionMismatchException(_HERE_, token->getStrFlags(), token->getConversionType());
+		throw FormatFlagsConversionMismatchException(_HERE_, token.getStrFlags(), token.getConversionType());
 
-	if (token->isPrecisionSet())
-		throw IllegalFormatPrecisionException(_HERE_, token->getPrecision());
+	if (token.isPrecisionSet())
+		throw IllegalFormatPrecisionException(_HERE_, token.getPrecision());
 
-	return padding(token, result, startIndex);
+	padding(token, flags, result, startIndex);
 }
 
-static SPtr<String> formatNull(SPtr<FormatToken> const& token) {
-	token->setFlags(token->getFlags() & (~FormatToken::FLAG_ZERO));
-	StringBuilder result("null");
-	return padding(token, result, 0);
+static void formatNull(StringBuilder &result, FormatToken const& token) {
+	result.add("null");
+	padding(token, token.getFlags() & (~FormatToken::FLAG_ZERO), result, 0);
 }
 
-static SPtr<String> formatInteger(SPtr<FormatToken> const& token, SPtr<Object> const& arg) {
+static void formatInteger(StringBuilder &result, FormatToken const& token, SPtr<Object> const& arg) {
 	if (!arg)
-		return formatNull(token);
+		return formatNull(result, token);
 
 	int64_t value;
 
@@ -415,14 +411,14 @@ static SPtr<String> formatInteger(SPtr<FormatToken> const& token, SPtr<Object> c
 	else if (instanceof<Short>(arg))
 		value = Class::cast<Short>(arg)->longValue();
 	else
-		throw IllegalFormatConversionException(_HERE_, token->getConversionType(), arg->getClass());
+		throw IllegalFormatConversionException(_HERE_, token.getConversionType(), arg->getClass());
 
-	return std::make_shared<String>(fmt::sprintf(token->getFormat()->c_str(), value));
+	result.add(fmt::sprintf(token.getFormat()->c_str(), value));
 }
 
-static SPtr<String> formatFloat(SPtr<FormatToken> const& token, SPtr<Object> const& arg) {
+static void formatFloat(StringBuilder &result, FormatToken const& token, SPtr<Object> const& arg) {
 	if (!arg)
-		return formatNull(token);
+		return formatNull(result, token);
 
 	double value;
 
@@ -439,31 +435,30 @@ static SPtr<String> formatFloat(SPtr<FormatToken> const& token, SPtr<Object> con
 	else if (instanceof<Short>(arg))
 		value = Class::cast<Short>(arg)->doubleValue();
 	else
-		throw IllegalFormatConversionException(_HERE_, token->getConversionType(), arg->getClass());
+		throw IllegalFormatConversionException(_HERE_, token.getConversionType(), arg->getClass());
 
-	return std::make_shared<String>(fmt::sprintf(token->getFormat()->c_str(), value));
+	result.add(fmt::sprintf(token.getFormat()->c_str(), value));
 }
 
-static SPtr<String> formatArg(SPtr<FormatToken> const& token, SPtr<Object> const& arg) {
-	SPtr<String> result;
-	switch (token->getConversionType()) {
+static void formatArg(StringBuilder &result, FormatToken const& token, SPtr<Object> const& arg) {
+	switch (token.getConversionType()) {
 		case 'B':
 		case 'b':
-			result = formatBool(token, arg);
+			formatBool(result, token, arg);
 			break;
 		case 'S':
 		case 's':
-			result = formatString(token, arg);
+			formatString(result, token, arg);
 			break;
 		case 'C':
 		case 'c':
-			result = formatCharacter(token, arg);
+			formatCharacter(result, token, arg);
 			break;
 		case 'd':
 		case 'o':
 		case 'x':
 		case 'X':
-			result = formatInteger(token, arg);
+			formatInteger(result, token, arg);
 			break;
 		case 'e':
 		case 'E':
@@ -472,53 +467,98 @@ static SPtr<String> formatArg(SPtr<FormatToken> const& token, SPtr<Object> const
 		case 'f':
 		case 'a':
 		case 'A':
-			result = formatFloat(token, arg);
+			formatFloat(result, token, arg);
 			break;
 		case '%':
-			result = formatPercent(token);
+			formatPercent(result, token);
 			break;
 		default:
-			throw UnknownFormatConversionException(_HERE_, String::valueOf(token->getConversionType()));
+			throw UnknownFormatConversionException(_HERE_, String::valueOf(token.getConversionType()));
 	}
-	if (Character::isUpperCase(token->getConversionType()))
-		if (result)
-			result = result->toUpperCase();
-	return result;
 }
 
-void ExpressionFormatter::format(StringBuilder &out, ArgList const& args, Resolver const& resolver) {
-	SPtr<String> format = args.get<String>(0);
-	SPtr<CharBuffer> formatBuffer = std::make_shared<CharBuffer>(format);
+//--- CompiledFormat -------------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+
+CompiledFormat::CompiledFormat(String const& format) {
+	SPtr<CharBuffer> formatBuffer = std::make_shared<CharBuffer>(std::make_shared<String>(format));
 	ParserStateMachine parser(formatBuffer);
 
+	try {
+		while (formatBuffer->hasRemaining()) {
+			parser.reset();
+			SPtr<FormatToken> token = parser.getNextFormatToken();
+			Directive directive;
+			SPtr<String> plainText = token->getPlainText();
+			if (token->getConversionType() == FormatToken::UNSET)
+				directive._text = plainText;
+			else {
+				directive._text = plainText->substring(0, (size_t)plainText->indexOf('%'));
+				directive._token = token;
+			}
+			_directives.push_back(std::move(directive));
+		}
+	} catch (IllegalArgumentException const&) {
+		// the rest of the format string is not parsed
+		Directive directive;
+		directive._error = std::current_exception();
+		_directives.push_back(std::move(directive));
+	}
+}
+
+SPtr<const CompiledFormat> CompiledFormat::compile(String const& format) {
+	return std::make_shared<CompiledFormat>(format);
+}
+
+SourceCache<const CompiledFormat>& CompiledFormat::cache() {
+	static SourceCache<const CompiledFormat> cache(&CompiledFormat::compile);
+	return cache;
+}
+
+SPtr<const CompiledFormat> CompiledFormat::cached(String const& format) {
+	return cache().get(format);
+}
+
+void CompiledFormat::format(StringBuilder &out, ArgList const& args, size_t first) const {
 	bool allowNil = false;
 
 	int32_t currentObjectIndex = 0;
 	SPtr<Object> lastArgument;
 	bool hasLastArgumentSet = false;
-	while (formatBuffer->hasRemaining()) {
-		parser.reset();
-		SPtr<FormatToken> token = parser.getNextFormatToken();
-		SPtr<String> result;
-		SPtr<String> plainText = token->getPlainText();
-		if (token->getConversionType() == FormatToken::UNSET)
-			result = plainText;
-		else {
-			plainText = plainText->substring(0, (size_t)plainText->indexOf('%'));
-			SPtr<Object> argument;
-			if (token->requiresArgument()) {
-				int32_t index = (token->getArgIndex() == FormatToken::UNSET) ? currentObjectIndex++ : token->getArgIndex();
-				argument = getArgument(args, index, token, lastArgument, hasLastArgumentSet, allowNil);
-				lastArgument = argument;
-				hasLastArgumentSet = true;
-			}
-			result = formatArg(token, argument);
-			result = result ? ((StringBuilder(*plainText) + (*result)).toString()) : plainText;
+	StringBuilder result;
+	for (Directive const& directive : _directives) {
+		if (directive._error)
+			std::rethrow_exception(directive._error);
+		if (!directive._token) {
+			out.add(*directive._text);
+			continue;
 		}
-		if (result)
-			out.add(*result);
+
+		FormatToken const& token = *directive._token;
+		SPtr<Object> argument;
+		if (token.requiresArgument()) {
+			int32_t index = (token.getArgIndex() == FormatToken::UNSET) ? currentObjectIndex++ : token.getArgIndex();
+			argument = getArgument(args, first, index, token, lastArgument, hasLastArgumentSet, allowNil);
+			lastArgument = argument;
+			hasLastArgumentSet = true;
+		}
+		result.clear();
+		formatArg(result, token, argument);
+		out.add(*directive._text);
+		EvaluationContext::checkStringLength(out.length() + result.length());
+		if (Character::isUpperCase(token.getConversionType()))
+			out.add(*result.toString()->toUpperCase());
+		else
+			out.add(result);
 	}
 }
 
+//--- ExpressionFormatter --------------------------------------------------------------
+//--------------------------------------------------------------------------------------
+
+void ExpressionFormatter::format(StringBuilder &out, ArgList const& args, Resolver const& /* resolver */) {
+	CompiledFormat::cached(*args.get<String>(0))->format(out, args, 1);
+}
+
 } // namespace expr
 } // namespace slib
@@ -19,9 +19,13 @@
 
 #include "slib/lang/StringBuilder.h"
 #include "slib/util/expr/Function.h"
+#include "slib/util/expr/SourceCache.h"
 #include "slib/text/StringCharacterIterator.h"
 #include "slib/lang/Character.h"
 
+#include <exception>
+#include <vector>
+
 namespace slib {
 namespace expr {
 
@@ -190,19 +194,19 @@ public:
 	,_strFlags(nullptr, FLAG_TYPE_COUNT)
 	,_conversionType(UNSET) {}
 
-	bool isPrecisionSet() {
+	bool isPrecisionSet() const {
 		return _precision != UNSET;
 	}
 
-	bool isWidthSet() {
+	bool isWidthSet() const {
 		return _width != UNSET;
 	}
 
-	bool isFlagSet(int flag) {
+	bool isFlagSet(int flag) const {
 		return 0 != (_flags & flag);
 	}
 
-	int32_t getArgIndex() {
+	int32_t getArgIndex() const {
 		return _argIndex;
 	}
 
@@ -226,7 +230,7 @@ public:
 		_format = std::move(format);
 	}
 
-	int32_t getWidth() {
+	int32_t getWidth() const {
 		return _width;
 	}
 
@@ -234,7 +238,7 @@ public:
 		_width = width;
 	}
 
-	int32_t getPrecision() {
+	int32_t getPrecision() const {
 		return _precision;
 	}
 
@@ -242,11 +246,11 @@ public:
 		_precision = precision;
 	}
 
-	UPtr<String> getStrFlags() {
+	UPtr<String> getStrFlags() const {
 		return _strFlags.toString();
 	}
 
-	int32_t getFlags() {
+	int32_t getFlags() const {
 		return _flags;
 	}
 
@@ -260,7 +264,7 @@ public:
 	 */
 	bool setFlag(char c);
 
-	ptrdiff_t getFormatStringStartIndex() {
+	ptrdiff_t getFormatStringStartIndex() const {
 		return _formatStringStartIndex;
 	}
 
@@ -268,7 +272,7 @@ public:
 		_formatStringStartIndex = index;
 	}
 
-	char getConversionType() {
+	char getConversionType() const {
 		return _conversionType;
 	}
 
@@ -276,7 +280,7 @@ public:
 		_conversionType = c;
 	}
 
-	bool requiresArgument() {
+	bool requiresArgument() const {
 		return (_conversionType != '%') && (_conversionType != 'n');
 	}
 };
@@ -353,6 +357,46 @@ private:
 	int32_t parseInt(SPtr<CharBuffer> const& buffer);
 };
 
+/**
+ * Format string parsed once into literal text and conversions, for formatting many argument
+ * lists. Formats exactly as ExpressionFormatter::format(); errors in the format string are
+ * raised when formatting reaches them. Immutable, so a single instance can be shared by
+ * multiple threads.
+ */
+class CompiledFormat {
+private:
+	struct Directive {
+		/** literal text, before the conversion if there is one */
+		SPtr<String> _text;
+		/** nullptr for literal text only */
+		SPtr<const FormatToken> _token;
+		/** error in the format string, raised when formatting reaches it */
+		std::exception_ptr _error;
+	};
+
+	std::vector<Directive> _directives;
+public:
+	/** do NOT use directly, use compile() */
+	CompiledFormat(String const& format);
+
+	static SPtr<const CompiledFormat> compile(String const& format);
+
+	/** Process-wide cache used by cached(), evicting the least recently used format strings */
+	static SourceCache<const CompiledFormat>& cache();
+
+	/** Returns the compiled form of a format string, from the process-wide cache */
+	static SPtr<const CompiledFormat> cached(String const& format);
+
+	/**
+	 * Formats an argument list
+	 * @param out  receives the formatted text
+	 * @param args  arguments
+	 * @param first  index of the argument used by the first conversion
+	 * @throws EvaluationException
+	 */
+	void format(StringBuilder &out, ArgList const& args, size_t first = 0) const;
+};
+
 /**
  * Originally part of the Apache Harmony project. Adapted and modified to integrate with the
  * ExpressionEvaluator.
@@ -360,6 +404,8 @@ private:
 class ExpressionFormatter {
 public:
 	/**
+	 * Formats arguments 1.. of a list according to the format string in argument 0, using
+	 * cached CompiledFormats
 	 * @throws EvaluationException
 	 */
 	static void format(StringBuilder &out, ArgList const& args, Resolver const& resolver);
@@ -4,34 +4,36 @@
 
 #include "slib/util/expr/ExpressionInputStream.h"
 #include "slib/lang/Numeric.h"
+#include "slib/lang/StringPool.h"
 
 namespace slib {
 namespace expr {
 
-UPtr<String> ExpressionInputStream::readName() {
+SPtr<const String> ExpressionInputStream::readName() {
 	skipBlanks();
 	char ch = peek();
 	if (!isIdentifierStart(ch))
 		throw SyntaxErrorException(_HERE_, fmt::format("Identifier start expected, got '{}'", ch).c_str());
-	StringBuilder str;
-	while ((ch != CharacterIterator::DONE) &&
-		   ((std::isalnum(ch) || ch == '_' || isSpecialNameChar(ch)))) {
-		str.add(readChar());
-		ch = peek();
+	const char *start = _pos;
+	const char *pos = _pos;
+	while (true) {
+		pos += ASCII::spanWordChars(pos, (size_t)(_end - pos));
+		if ((pos == _end) || !isSpecialNameChar(*pos))
+			break;
+		pos++;
 	}
-	return str.toString();
+	seek(pos);
+	return StringPool::global().intern(start, (size_t)(pos - start));
 }
 
 UPtr<String> ExpressionInputStream::readDottedNameRemainder() {
 	skipBlanks();
-	char ch = peek();
-	StringBuilder str;
-	while ((ch != CharacterIterator::DONE) &&
-		   ((std::isalnum(ch) || (ch == '_') || ch == '.'))) {
-		str.add(readChar());
-		ch = peek();
-	}
-	return str.toString();
+	const char *start = _pos;
+	const char *pos = _pos;
+	while ((pos < _end) && (ASCII::isWordChar(*pos) || (*pos == '.')))
+		pos++;
+	seek(pos);
+	return std::make_unique<String>(start, (size_t)(pos - start));
 }
 
 enum class SSMODE { SCAN, ESCAPE, ESCAPE2 };
@@ -44,6 +46,16 @@ SPtr<Value> ExpressionInputStream::readString() {
 	bool complete = false;
 	SSMODE mode = SSMODE::SCAN;
 	do {
+		if (mode == SSMODE::SCAN) {
+			// copy the run of plain characters in one go
+			const char *pos = _pos;
+			while ((pos < _end) && (*pos != delimiter) && (*pos != '\\') && (*pos != '`') && (*pos != CharacterIterator::DONE))
+				pos++;
+			if (pos > _pos) {
+				str.add(_pos, pos - _pos);
+				seek(pos);
+			}
+		}
 		char ch = readChar();
 		switch (mode) {
 			case SSMODE::SCAN:
@@ -111,69 +123,23 @@ SPtr<Value> ExpressionInputStream::readString() {
 }
 
 std::shared_ptr<Value> ExpressionInputStream::readNumber() {
-	std::unique_ptr<String> str = readReal();
+	skipBlanks();
 	try {
-		return std::make_shared<Value>(Number::createNumber(str));
+		Number::Literal literal = Number::parse(StringView(_pos, (size_t)(_end - _pos)));
+		seek(_pos + literal.length);
+		return std::make_shared<Value>(Number::createNumber(literal));
 	} catch (NumberFormatException const& e) {
 		throw EvaluationException(_HERE_, "Error parsing numeric value", e);
 	}
 }
 
-std::unique_ptr<String> ExpressionInputStream::readReal() {
-	StringBuilder s;
-	skipBlanks();
-	char ch = peek();
-	if (ch == CharacterIterator::DONE)
-		return std::make_unique<String>("");
-	if ((ch == '-') || (ch == '+')) {
-		s.add(readChar());
-		skipBlanks();
-		ch = peek();
-	}
-	bool hex = false;
-	if (ch == '0') {
-		s.add(readChar());
-		ch = peek();
-		if (ch == 'x') {
-			hex = true;
-			s.add(readChar());
-		}
-	}
-	while ((ch >= '0' && ch <= '9') ||
-		   (hex && ch >= 'a' && ch <= 'f') ||
-		   (hex && ch >= 'A' && ch <= 'F')) {
-		s.add(readChar());
-		ch = peek();
-	}
-	if (ch == '.') {
-		s.add(readChar());
-		ch = peek();
-		while (ch >= '0' && ch <= '9') {
-			s.add(readChar());
-			ch = peek();
-		}
-	}
-	if (ch == 'E' || ch == 'e') {
-		s.add(readChar());
-		ch = peek();
-		if (ch == '-' || ch == '+') {
-			s.add(readChar());
-			ch = peek();
-		}
-		while (ch >= 0 && ch <= '9') {
-			s.add(readChar());
-			ch = peek();
-		}
-	}
-	return s.toString();
-}
-
 enum class ASMODE { SCAN, STRING, ESCAPE };
 
-std::shared_ptr<Expression> ExpressionInputStream::readArg() {
+UPtr<String> ExpressionInputStream::readArgText() {
 	char delimiter = '\1';
 	int argDepth = 0;
-	StringBuilder str;
+	// every character read is part of the argument
+	const char *start = _pos;
 	bool complete = false;
 	ASMODE mode = ASMODE::SCAN;
 	do {
@@ -187,7 +153,6 @@ std::shared_ptr<Expression> ExpressionInputStream::readArg() {
 						readChar();
 						if (ch == CharacterIterator::DONE)
 							throw SyntaxErrorException(_HERE_, "Unexpected EOS reading argument");
-						str.add(ch);
 						if (ch == '"' || ch == '\'') {
 							delimiter = ch;
 							mode = ASMODE::STRING;
@@ -203,7 +168,6 @@ std::shared_ptr<Expression> ExpressionInputStream::readArg() {
 					readChar();
 					if (ch == CharacterIterator::DONE)
 						throw SyntaxErrorException(_HERE_, "Unexpected EOS reading argument string");
-					str.add(ch);
 					if (ch == '\\' || ch == '`') {
 						mode = ASMODE::ESCAPE;
 					} else if (ch == delimiter) {
@@ -217,13 +181,12 @@ std::shared_ptr<Expression> ExpressionInputStream::readArg() {
 					readChar();
 					if (ch == CharacterIterator::DONE)
 						throw SyntaxErrorException(_HERE_, "Unexpected EOS reading string escape sequence");
-					str.add(ch);
 					mode = ASMODE::STRING;
 				}
 				break;
 		}
 	} while (!complete);
-	return std::make_shared<Expression>(str.toString());
+	return std::make_unique<String>(start, (size_t)(_pos - start));
 }
 
 } // namespace expr
@@ -5,40 +5,57 @@
 #ifndef H_SLIB_UTIL_EXPR_EXPRESSIONINPUTSTREAM_H
 #define H_SLIB_UTIL_EXPR_EXPRESSIONINPUTSTREAM_H
 
-#include "slib/text/StringCharacterIterator.h"
+#include "slib/text/CharacterIterator.h"
+#include "slib/lang/ASCII.h"
 #include "slib/lang/StringBuilder.h"
 #include "slib/util/expr/Exceptions.h"
 #include "slib/util/expr/Value.h"
 #include "slib/util/expr/Expression.h"
 
-#include <cctype>
-
 namespace slib {
 namespace expr {
 
+/** Cursor over the source text of an expression, read directly from a contiguous buffer */
 class ExpressionInputStream {
 private:
-	StringCharacterIterator _iter;
+	/** keeps the buffer alive, if read from a string */
+	SPtr<BasicString> _text;
+	const char *_begin;
+	const char *_end;
+	const char *_pos;
+	/** character at _pos, or CharacterIterator::DONE at the end */
 	char _currentChar;
 private:
 	static bool isSpecialNameChar(char ch) {
 		return (ch == '$') || (ch == '#') || (ch == '?') || (ch == '@');
 	}
 
-	std::unique_ptr<String> readReal();
+	void seek(const char *pos) {
+		_pos = pos;
+		_currentChar = (_pos < _end) ? *_pos : (char)CharacterIterator::DONE;
+	}
 public:
 	ExpressionInputStream(SPtr<BasicString> const& s)
-	:_iter(s) {
-		_currentChar = _iter.first();
+	:_text(s)
+	,_begin(s->c_str())
+	,_end(_begin + s->length()) {
+		seek(_begin);
+	}
+
+	/** Reads from a buffer that must outlive the stream */
+	ExpressionInputStream(const char *buffer, size_t length)
+	:_begin(buffer)
+	,_end(buffer + length) {
+		seek(_begin);
 	}
 
 	void skipBlanks() {
-		while ((_currentChar != CharacterIterator::DONE) && (std::isspace(_currentChar)))
-			_currentChar = _iter.next();
+		if (ASCII::isSpace(_currentChar))
+			seek(_pos + ASCII::spanSpaces(_pos, (size_t)(_end - _pos)));
 	}
 
 	void reset() {
-		_currentChar = _iter.first();
+		seek(_begin);
 	}
 
 	char peek() {
@@ -48,32 +65,40 @@ public:
 	char readChar() {
 		char val = _currentChar;
 		if (_currentChar != CharacterIterator::DONE)
-			_currentChar = _iter.next();
+			seek(_pos + 1);
 		return val;
 	}
 
 	ssize_t getIndex() {
-		return _iter.getIndex();
+		return _pos - _begin;
 	}
 
 	static bool isIdentifierStart(char ch) {
-		return (ch == '_') || isSpecialNameChar(ch) || std::isalpha(ch);
+		return (ch == '_') || isSpecialNameChar(ch) || ASCII::isAlpha(ch);
 	}
 
 	/**
 	 * Reads a symbol name
-	 * @return name
+	 * @return interned name
 	 * @throws SyntaxErrorException
 	 */
-	std::unique_ptr<String> readName();
+	SPtr<const String> readName();
 
 	std::unique_ptr<String> readDottedNameRemainder();
 
 	/** @throws SyntaxErrorException */
 	SPtr<Value> readString();
 
+	/**
+	 * Reads the source text of a function argument, up to the next top-level ',' or ')'
+	 * @throws SyntaxErrorException
+	 */
+	UPtr<String> readArgText();
+
 	/** @throws SyntaxErrorException */
-	std::shared_ptr<Expression> readArg();
+	std::shared_ptr<Expression> readArg() {
+		return std::make_shared<Expression>(readArgText());
+	}
 
 	/** @throws EvaluationException */
 	std::shared_ptr<Value> readNumber();
@@ -11,13 +11,22 @@ Function::~Function() {}
 
 constexpr Class Function::_class;
 
+const size_t Function::MAX_DIRECT_ARGS;
+
+Value Function::call(Resolver const& resolver, Value const* args, size_t nArgs, SPtr<const String> const& symbolName) const {
+	FunctionArgs params(*this, symbolName);
+	for (size_t i = 0; i < nArgs; i++)
+		params.add(args[i].getValue());
+	return *_evaluate(resolver, params);
+}
+
 ArgList::~ArgList() {}
 
 FunctionArgs::~FunctionArgs() {}
 
 void FunctionArgs::add(SPtr<Object> const& obj) {
 	size_t np = _args.size();
-	Class const& clazz = _function->getParamType(np);
+	Class const& clazz = _function.getParamType(np);
 	if ((!obj) || (clazz.isAssignableFrom(obj->getClass())))
 		_args.add(obj);
 	else
@@ -25,7 +34,7 @@ void FunctionArgs::add(SPtr<Object> const& obj) {
 }
 
 Class const& FunctionArgs::peek() {
-	return _function->getParamType(_args.size());
+	return _function.getParamType(_args.size());
 }
 
 } // namespace expr
@@ -8,23 +8,30 @@
 #include "slib/lang/Object.h"
 #include "slib/lang/Class.h"
 #include "slib/util/Iterator.h"
+#include "slib/util/expr/Profiler.h"
 #include "slib/util/expr/Value.h"
 #include "slib/collections/ArrayList.h"
 
+#include <algorithm>
 #include <functional>
+#include <type_traits>
 
 namespace slib {
 namespace expr {
 
 class ArgList {
 protected:
-	SPtr<String> _symbolName;
+	SPtr<const String> _symbolName;
 public:
-	ArgList(SPtr<String> const& symbolName)
+	ArgList(SPtr<const String> const& symbolName)
 	:_symbolName(symbolName) {}
 
 	virtual ~ArgList();
 
+	SPtr<const String> const& getSymbolName() const {
+		return _symbolName;
+	}
+
 	virtual size_t size() const = 0;
 
 	virtual std::shared_ptr<Object> getNullable(size_t index) const = 0;
@@ -59,13 +66,18 @@ public:
 };
 
 class Function;
+class Expression;
 
 class FunctionArgs : public ArgList {
 private:
-	SPtr<Function> const& _function;
+	Function const& _function;
 	ArrayList<Object> _args;
 public:
-	FunctionArgs(SPtr<Function> const& function, SPtr<String> const& symbolName)
+	FunctionArgs(SPtr<Function> const& function, SPtr<const String> const& symbolName)
+	:ArgList(symbolName)
+	,_function(*function) {}
+
+	FunctionArgs(Function const& function, SPtr<const String> const& symbolName)
 	:ArgList(symbolName)
 	,_function(function) {}
 
@@ -90,6 +102,102 @@ public:
 /** @throws EvaluationException */
 typedef std::function<SPtr<Value>(Resolver const& resolver, ArgList const& args)> Evaluate;
 
+/**
+ * Unpacks an argument of a direct function (see Function::impl()). Integer, Long, Double
+ * and Boolean arguments are passed as plain C++ values, all others as pointers.
+ */
+template <class T>
+struct DirectArg {
+	typedef SPtr<T> Type;
+
+	static SPtr<T> get(Value const& value) {
+		return Class::cast<T>(value.getValue());
+	}
+};
+
+/** Lazy params are not supported by direct functions */
+template <>
+struct DirectArg<Expression>;
+
+template <>
+struct DirectArg<Integer> {
+	typedef int32_t Type;
+
+	static int32_t get(Value const& value) {
+		return (int32_t)value.getLong();
+	}
+};
+
+template <>
+struct DirectArg<Long> {
+	typedef int64_t Type;
+
+	static int64_t get(Value const& value) {
+		return value.getLong();
+	}
+};
+
+template <>
+struct DirectArg<Double> {
+	typedef double Type;
+
+	static double get(Value const& value) {
+		return value.getDouble();
+	}
+};
+
+template <>
+struct DirectArg<Boolean> {
+	typedef bool Type;
+
+	static bool get(Value const& value) {
+		return value.getBoolean();
+	}
+};
+
+/** Wraps the result of a direct function; numbers stay unboxed */
+struct DirectResult {
+	static Value of(int32_t value) {
+		return Value(value);
+	}
+
+	static Value of(int64_t value) {
+		return Value(value);
+	}
+
+	static Value of(double value) {
+		return Value(value);
+	}
+
+	static Value of(Value value) {
+		return value;
+	}
+
+	template <class T>
+	static Value of(SPtr<T> const& value) {
+		return Value(SPtr<Object>(value));
+	}
+
+	template <class T>
+	static Value of(UPtr<T> value) {
+		return Value(SPtr<Object>(std::move(value)));
+	}
+};
+
+template <size_t ...I>
+struct Indices {};
+
+template <size_t N, size_t ...I>
+struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+
+template <size_t ...I>
+struct MakeIndices<0, I...> {
+	typedef Indices<I...> Type;
+};
+
+template <class F, class ...Args>
+class DirectFunction;
+
 class Function : virtual public Object {
 private:
 	/** Number of fixed params */
@@ -97,12 +205,23 @@ private:
 
 	/** Parameter types for fixed params */
 	UPtr<std::vector<Class>> _paramTypes;
+
+	/** Result depends only on the arguments */
+	bool _pure;
 protected:
 	Evaluate _evaluate;
+
+	/** Takes its fixed params unpacked, see call() */
+	bool _direct;
 public:
+	/** Maximum number of params of a direct function */
+	static const size_t MAX_DIRECT_ARGS = 4;
+
 	/** do NOT use directly, only public for make_shared */
-	Function(bool /* dontUse */, std::initializer_list<Class> argTypes, Evaluate evaluate)
-	:_evaluate(evaluate) {
+	Function(bool /* dontUse */, std::initializer_list<Class> argTypes, Evaluate evaluate, bool pure = false)
+	:_pure(pure)
+	,_evaluate(evaluate)
+	,_direct(false) {
 		auto functionParams = argTypes.size();
 		if (functionParams > 0) {
 			_paramTypes = std::make_unique<std::vector<Class>>();
@@ -122,6 +241,31 @@ public:
 		return std::make_shared<Function>(true, std::initializer_list<Class>({Args::_class...}), evaluate);
 	}
 
+	/**
+	 * Implements a direct function, that takes exactly the given params, unpacked (see DirectArg)
+	 * and not nil. Calls pass their arguments without collecting them into an ArgList.
+	 * Example: <code>impl<Double>([](double d) { return floor(d); })</code>
+	 */
+	template <typename ...Args, typename F>
+	static auto impl(F fn) -> decltype(DirectResult::of(fn(std::declval<typename DirectArg<Args>::Type>()...)), SPtr<Function>()) {
+		return std::make_shared<DirectFunction<F, Args...>>(fn, false);
+	}
+
+	/**
+	 * Implements a pure function: its result depends only on its arguments, it does not use the
+	 * resolver and has no side effects. Calls with constant arguments are evaluated at compile time.
+	 */
+	template <typename ...Args>
+	static SPtr<Function> pureImpl(Evaluate evaluate) {
+		return std::make_shared<Function>(true, std::initializer_list<Class>({Args::_class...}), evaluate, true);
+	}
+
+	/** Implements a pure, direct function (see above) */
+	template <typename ...Args, typename F>
+	static auto pureImpl(F fn) -> decltype(DirectResult::of(fn(std::declval<typename DirectArg<Args>::Type>()...)), SPtr<Function>()) {
+		return std::make_shared<DirectFunction<F, Args...>>(fn, true);
+	}
+
 	virtual ~Function() override;
 
 	static constexpr Class _class = FUNCTIONCLASS;
@@ -130,18 +274,120 @@ public:
 		return FUNCTIONCLASS;
 	}
 
-	Class const& getParamType(size_t i) {
+	Class const& getParamType(size_t i) const {
 		return (i < _fixedParams) ? (*_paramTypes)[i] : OBJECTCLASS;
 	}
 
-	size_t getFixedParamsCount() {
+	size_t getFixedParamsCount() const {
 		return _fixedParams;
 	}
 
+	bool isPure() const {
+		return _pure;
+	}
+
+	bool isDirect() const {
+		return _direct;
+	}
+
+	/**
+	 * Checks an argument against the type of a param, as FunctionArgs::add() does
+	 * @throws CastException
+	 */
+	void checkArg(size_t index, Value const& arg, SPtr<const String> const& symbolName) const {
+		if (arg.isNil())
+			return;
+		Class const& clazz = getParamType(index);
+		if (!clazz.isAssignableFrom(arg.getClass()))
+			throw CastException(_HERE_, fmt::format("Function {}(): invalid parameter type: expected {}, got {}", *symbolName, clazz.getName(), arg.getClass().getName()).c_str());
+	}
+
 	/** @throws EvaluationException; */
 	SPtr<Value> evaluate(Resolver const& resolver, ArgList const& args) {
+		Profiler::CallScope scope(args.getSymbolName());
 		return _evaluate(resolver, args);
 	}
+
+	/**
+	 * Calls the function with arguments already checked by checkArg(); direct functions
+	 * read them in place, others get them collected into an ArgList
+	 * @throws EvaluationException
+	 */
+	virtual Value call(Resolver const& resolver, Value const* args, size_t nArgs, SPtr<const String> const& symbolName) const;
+};
+
+/** Function that takes its params unpacked, see Function::impl() */
+template <class F, class ...Args>
+class DirectFunction : public Function {
+private:
+	static const size_t ARITY = sizeof...(Args);
+	static_assert(ARITY <= MAX_DIRECT_ARGS, "Too many params for a direct function");
+
+	F _fn;
+
+	template <size_t ...I>
+	Value invoke(Value const* args, Indices<I...>) const {
+		return DirectResult::of(_fn(DirectArg<Args>::get(args[I])...));
+	}
+public:
+	/** do NOT use directly, use Function::impl() */
+	DirectFunction(F fn, bool pure)
+	:Function(true, std::initializer_list<Class>({Args::_class...}), nullptr, pure)
+	,_fn(fn) {
+		_direct = true;
+		// callers that collect arguments into an ArgList (constant folding) still work
+		_evaluate = [this](Resolver const& resolver, ArgList const& args) {
+			Value values[ARITY > 0 ? ARITY : 1];
+			size_t nArgs = std::min(args.size(), ARITY);
+			for (size_t i = 0; i < nArgs; i++)
+				values[i] = Value(args.getNullable(i));
+			return std::make_shared<Value>(call(resolver, values, nArgs, args.getSymbolName()));
+		};
+	}
+
+	virtual ~DirectFunction() override {}
+
+	virtual Value call(Resolver const& /* resolver */, Value const* args, size_t nArgs, SPtr<const String> const& symbolName) const override {
+		for (size_t i = 0; i < ARITY; i++) {
+			if (i >= nArgs)
+				throw EvaluationException(_HERE_, fmt::format("Function {}(): invalid argument index: {}", *symbolName, i).c_str());
+			if (args[i].isNil())
+				throw EvaluationException(_HERE_, fmt::format("Function {}(): expected non-nil argument: {}", *symbolName, i).c_str());
+		}
+		return invoke(args, typename MakeIndices<ARITY>::Type());
+	}
+};
+
+template <class F, class ...Args>
+const size_t DirectFunction<F, Args...>::ARITY;
+
+/** Arguments of a call to a direct function, held on the caller's stack */
+class DirectArgs {
+private:
+	Function const& _function;
+	SPtr<const String> const& _symbolName;
+	Value _args[Function::MAX_DIRECT_ARGS];
+	size_t _size;
+public:
+	DirectArgs(Function const& function, SPtr<const String> const& symbolName)
+	:_function(function)
+	,_symbolName(symbolName)
+	,_size(0) {}
+
+	/** @throws CastException */
+	void add(Value const& arg) {
+		_function.checkArg(_size, arg, _symbolName);
+		// arguments past the fixed params are evaluated, but not passed
+		if (_size < Function::MAX_DIRECT_ARGS)
+			_args[_size] = arg;
+		_size++;
+	}
+
+	/** @throws EvaluationException */
+	Value call(Resolver const& resolver) const {
+		Profiler::CallScope scope(_symbolName);
+		return _function.call(resolver, _args, std::min(_size, Function::MAX_DIRECT_ARGS), _symbolName);
+	}
 };
 
 } // namespace expr
@@ -0,0 +1,109 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "slib/util/expr/Profiler.h"
+
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace slib {
+namespace expr {
+
+std::atomic<bool> Profiler::_enabled(false);
+thread_local uint64_t Profiler::_lookups = 0;
+thread_local uint64_t Profiler::_allocations = 0;
+
+namespace {
+
+struct ProfilerState {
+	std::mutex _lock;
+	std::unordered_map<String, Profiler::ExpressionStats> _expressions;
+	std::unordered_map<String, Profiler::FunctionStats> _functions;
+};
+
+ProfilerState& state() {
+	static ProfilerState state;
+	return state;
+}
+
+template <class S>
+std::vector<std::pair<String, S>> sorted(std::unordered_map<String, S> const& stats, uint64_t S::*nanos) {
+	std::vector<std::pair<String, S>> result(stats.begin(), stats.end());
+	std::sort(result.begin(), result.end(), [nanos](std::pair<String, S> const& a, std::pair<String, S> const& b) {
+		return a.second.*nanos > b.second.*nanos;
+	});
+	return result;
+}
+
+} // namespace
+
+void Profiler::recordCompilation(BasicString const& text, uint64_t nanos) {
+	ProfilerState &s = state();
+	std::lock_guard<std::mutex> lock(s._lock);
+	ExpressionStats &stats = s._expressions[String(text.c_str(), text.length())];
+	stats._compilations++;
+	stats._parseNanos += nanos;
+}
+
+void Profiler::recordEvaluation(BasicString const& text, uint64_t nanos, uint64_t lookups, uint64_t allocations) {
+	ProfilerState &s = state();
+	std::lock_guard<std::mutex> lock(s._lock);
+	ExpressionStats &stats = s._expressions[String(text.c_str(), text.length())];
+	stats._evaluations++;
+	stats._evalNanos += nanos;
+	stats._lookups += lookups;
+	stats._allocations += allocations;
+}
+
+void Profiler::recordCall(String const& name, uint64_t nanos) {
+	ProfilerState &s = state();
+	std::lock_guard<std::mutex> lock(s._lock);
+	FunctionStats &stats = s._functions[name];
+	stats._calls++;
+	stats._nanos += nanos;
+}
+
+void Profiler::reset() {
+	ProfilerState &s = state();
+	std::lock_guard<std::mutex> lock(s._lock);
+	s._expressions.clear();
+	s._functions.clear();
+}
+
+std::vector<std::pair<String, Profiler::ExpressionStats>> Profiler::expressions() {
+	ProfilerState &s = state();
+	std::lock_guard<std::mutex> lock(s._lock);
+	return sorted(s._expressions, &ExpressionStats::_evalNanos);
+}
+
+std::vector<std::pair<String, Profiler::FunctionStats>> Profiler::functions() {
+	ProfilerState &s = state();
+	std::lock_guard<std::mutex> lock(s._lock);
+	return sorted(s._functions, &FunctionStats::_nanos);
+}
+
+void Profiler::dump(StringBuilder &out) {
+	out.add(fmt::format("{:>10} {:>8} {:>12} {:>12} {:>10} {:>8} {:>8}  {}\n",
+						"evals", "compiles", "parse ns", "eval ns", "ns/eval", "lookups", "allocs", "expression"));
+	for (std::pair<String, ExpressionStats> const& entry : expressions()) {
+		ExpressionStats const& stats = entry.second;
+		out.add(fmt::format("{:>10} {:>8} {:>12} {:>12} {:>10} {:>8} {:>8}  {}\n",
+							stats._evaluations, stats._compilations, stats._parseNanos, stats._evalNanos,
+							stats._evaluations ? stats._evalNanos / stats._evaluations : 0,
+							stats._lookups, stats._allocations, entry.first.c_str()));
+	}
+
+	out.add(fmt::format("\n{:>10} {:>12} {:>10}  {}\n", "calls", "ns", "ns/call", "function"));
+	for (std::pair<String, FunctionStats> const& entry : functions()) {
+		FunctionStats const& stats = entry.second;
+		out.add(fmt::format("{:>10} {:>12} {:>10}  {}\n",
+							stats._calls, stats._nanos, stats._calls ? stats._nanos / stats._calls : 0, entry.first.c_str()));
+	}
+}
+
+} // namespace expr
+} // namespace slib
@@ -0,0 +1,188 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_UTIL_EXPR_PROFILER_H
+#define H_SLIB_UTIL_EXPR_PROFILER_H
+
+#include "slib/lang/String.h"
+#include "slib/lang/StringBuilder.h"
+
+#include <atomic>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#if !defined(SLIB_EXPR_NO_PROFILER)
+#define SLIB_EXPR_PROFILER
+#endif
+
+namespace slib {
+namespace expr {
+
+/**
+ * Process-wide statistics on expression evaluation, for finding the expressions and functions
+ * worth optimizing. Disabled by default; while disabled, each instrumented point costs one
+ * test of a flag. Building with SLIB_EXPR_NO_PROFILER defined removes the instrumentation
+ * entirely.
+ *
+ * Expressions are identified by their source text, functions by the name they were called by.
+ * Statistics are kept for compiled expressions (including those compiled by
+ * ExpressionEvaluator::expressionValue() and strExpressionValue()), for the expressions in
+ * Templates and for those evaluated by the interpreter (interpolate(), smartInterpolate());
+ * resolver lookups and allocations made by nested evaluations are counted in the enclosing one.
+ */
+class Profiler {
+public:
+	struct ExpressionStats {
+		uint64_t _compilations;
+		/** time spent parsing, folding and compiling */
+		uint64_t _parseNanos;
+		uint64_t _evaluations;
+		uint64_t _evalNanos;
+		/** variable lookups by name, during evaluations */
+		uint64_t _lookups;
+		/** allocations during evaluations, if reported (see allocated()) */
+		uint64_t _allocations;
+
+		ExpressionStats()
+		:_compilations(0)
+		,_parseNanos(0)
+		,_evaluations(0)
+		,_evalNanos(0)
+		,_lookups(0)
+		,_allocations(0) {}
+	};
+
+	struct FunctionStats {
+		uint64_t _calls;
+		uint64_t _nanos;
+
+		FunctionStats()
+		:_calls(0)
+		,_nanos(0) {}
+	};
+
+	typedef std::chrono::steady_clock Clock;
+private:
+	static std::atomic<bool> _enabled;
+	static thread_local uint64_t _lookups;
+	static thread_local uint64_t _allocations;
+
+	static uint64_t nanosSince(Clock::time_point start) {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+	}
+
+	static void recordCompilation(BasicString const& text, uint64_t nanos);
+	static void recordEvaluation(BasicString const& text, uint64_t nanos, uint64_t lookups, uint64_t allocations);
+	static void recordCall(String const& name, uint64_t nanos);
+public:
+	static bool enabled() {
+#ifdef SLIB_EXPR_PROFILER
+		return _enabled.load(std::memory_order_relaxed);
+#else
+		return false;
+#endif
+	}
+
+	/** Starts or stops collecting statistics; collected statistics are kept until reset() */
+	static void enable(bool enabled) {
+		_enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	/** Discards all collected statistics */
+	static void reset();
+
+	/** Counts a variable lookup by name */
+	static void lookup() {
+		if (enabled())
+			_lookups++;
+	}
+
+	/**
+	 * Counts an allocation. The library cannot see allocations by itself: an application that
+	 * wants them counted calls this from its replacement of the global operator new.
+	 */
+	static void allocated() {
+		if (enabled())
+			_allocations++;
+	}
+
+	/** @return statistics per expression, by decreasing total evaluation time */
+	static std::vector<std::pair<String, ExpressionStats>> expressions();
+
+	/** @return statistics per function, by decreasing total time */
+	static std::vector<std::pair<String, FunctionStats>> functions();
+
+	/** Appends the collected statistics as a table, one line per expression or function */
+	static void dump(StringBuilder &out);
+
+	/** Times the compilation of an expression */
+	class CompileScope {
+	private:
+		BasicString const* _text;
+		Clock::time_point _start;
+	public:
+		CompileScope(BasicString const& text)
+		:_text(nullptr) {
+			if (enabled()) {
+				_text = &text;
+				_start = Clock::now();
+			}
+		}
+
+		~CompileScope() {
+			if (_text)
+				recordCompilation(*_text, nanosSince(_start));
+		}
+	};
+
+	/** Times one evaluation of an expression */
+	class EvaluationScope {
+	private:
+		BasicString const* _text;
+		Clock::time_point _start;
+		uint64_t _lookups;
+		uint64_t _allocations;
+	public:
+		EvaluationScope(BasicString const& text)
+		:_text(nullptr) {
+			if (enabled()) {
+				_text = &text;
+				_lookups = Profiler::_lookups;
+				_allocations = Profiler::_allocations;
+				_start = Clock::now();
+			}
+		}
+
+		~EvaluationScope() {
+			if (_text)
+				recordEvaluation(*_text, nanosSince(_start), Profiler::_lookups - _lookups, Profiler::_allocations - _allocations);
+		}
+	};
+
+	/** Times one function call */
+	class CallScope {
+	private:
+		String const* _name;
+		Clock::time_point _start;
+	public:
+		CallScope(SPtr<const String> const& name)
+		:_name(nullptr) {
+			if (enabled() && name) {
+				_name = name.get();
+				_start = Clock::now();
+			}
+		}
+
+		~CallScope() {
+			if (_name)
+				recordCall(*_name, nanosSince(_start));
+		}
+	};
+};
+
+} // namespace expr
+} // namespace slib
+
+#endif // H_SLIB_UTIL_EXPR_PROFILER_H
@@ -0,0 +1,80 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_UTIL_EXPR_PROFILERJSON_H
+#define H_SLIB_UTIL_EXPR_PROFILERJSON_H
+
+#include "slib/util/expr/Profiler.h"
+#include "slib/util/JsonUtils.h"
+
+#include <rapidjson/writer.h>
+
+#include <string>
+
+namespace slib {
+namespace expr {
+
+/**
+ * Writes the statistics collected by the Profiler as a JSON object, with an "expressions"
+ * and a "functions" array ordered as Profiler::expressions() and Profiler::functions().
+ * Only available with the JSON utilities (WITH_JSON).
+ * @param writer  RapidJSON writer (or PrettyWriter)
+ */
+template <class W>
+void writeProfile(W &writer) {
+	writer.StartObject();
+
+	writer.Key("expressions");
+	writer.StartArray();
+	for (std::pair<String, Profiler::ExpressionStats> const& entry : Profiler::expressions()) {
+		Profiler::ExpressionStats const& stats = entry.second;
+		writer.StartObject();
+		writer.Key("expression");
+		writer.String(entry.first.c_str(), (rapidjson::SizeType)entry.first.length());
+		writer.Key("evaluations");
+		writer.Uint64(stats._evaluations);
+		writer.Key("compilations");
+		writer.Uint64(stats._compilations);
+		writer.Key("parseNanos");
+		writer.Uint64(stats._parseNanos);
+		writer.Key("evalNanos");
+		writer.Uint64(stats._evalNanos);
+		writer.Key("lookups");
+		writer.Uint64(stats._lookups);
+		writer.Key("allocations");
+		writer.Uint64(stats._allocations);
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	writer.Key("functions");
+	writer.StartArray();
+	for (std::pair<String, Profiler::FunctionStats> const& entry : Profiler::functions()) {
+		writer.StartObject();
+		writer.Key("function");
+		writer.String(entry.first.c_str(), (rapidjson::SizeType)entry.first.length());
+		writer.Key("calls");
+		writer.Uint64(entry.second._calls);
+		writer.Key("nanos");
+		writer.Uint64(entry.second._nanos);
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	writer.EndObject();
+}
+
+/** @return the statistics collected by the Profiler, as compact JSON (see writeProfile()) */
+inline std::string profileToJson() {
+	std::string json;
+	json::JsonStringAdapter adapter(json);
+	rapidjson::Writer<json::JsonStringAdapter> writer(adapter);
+	writeProfile(writer);
+	return json;
+}
+
+} // namespace expr
+} // namespace slib
+
+#endif // H_SLIB_UTIL_EXPR_PROFILERJSON_H
@@ -4,6 +4,8 @@
 
 #include "slib/util/expr/Resolver.h"
 
+#include <atomic>
+
 namespace slib {
 namespace expr {
 
@@ -11,6 +13,17 @@ Resolver::~Resolver() {}
 
 constexpr Class Resolver::_class;
 
+const uint32_t SlotResolver::NO_SLOT;
+
+SlotResolver::~SlotResolver() {}
+
+uint64_t SlotResolver::newLayout() {
+	static std::atomic<uint64_t> lastLayout(0);
+	return ++lastLayout;
+}
+
+IndexedResolver::~IndexedResolver() {}
+
 MapResolver::~MapResolver() {}
 
 } // namespace expr
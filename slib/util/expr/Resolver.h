@@ -9,6 +9,9 @@
 #include "slib/lang/String.h"
 #include "slib/collections/Map.h"
 
+#include <unordered_map>
+#include <vector>
+
 namespace slib {
 namespace expr {
 
@@ -31,6 +34,99 @@ public:
 	virtual SPtr<Object> getVar(String const& key) const = 0;
 };
 
+/**
+ * Resolver that can also look variables up by position. An expression bound to the resolver
+ * (see CompiledExpression::bind()) maps each variable name to a slot once, and then fetches
+ * variables by slot on every evaluation, without hashing names.
+ */
+class SlotResolver : public Resolver {
+public:
+	/** Slot of a variable that is not part of the layout; such variables are looked up by name */
+	static const uint32_t NO_SLOT = UINT32_MAX;
+
+	virtual ~SlotResolver() override;
+
+	/** @return new layout identifier, distinct from any other returned before */
+	static uint64_t newLayout();
+
+	/**
+	 * Identifies the mapping from names to slots. Resolvers that map names the same way (for
+	 * example one per record, over the same fields) return the same identifier, so that one
+	 * binding serves all of them. A different mapping must return a different identifier
+	 * (see newLayout()).
+	 */
+	virtual uint64_t getLayout() const = 0;
+
+	/** @return slot of a variable, or NO_SLOT */
+	virtual uint32_t getSlot(String const& key) const = 0;
+
+	/**
+	 * Resolves a variable by slot; must return the same as getVar() for the name of the slot
+	 * @return variable value or nullptr if not set
+	 */
+	virtual SPtr<Object> getSlotVar(uint32_t slot) const = 0;
+};
+
+/** Resolver over a fixed set of variables, stored by slot */
+class IndexedResolver : public SlotResolver {
+public:
+	/** Variable names and their slots; immutable, shared by resolvers over the same names */
+	class Layout {
+	private:
+		uint64_t _id;
+		std::unordered_map<String, uint32_t> _slots;
+	public:
+		Layout(std::vector<String> const& names)
+		:_id(newLayout()) {
+			for (String const& name : names)
+				_slots.emplace(name, (uint32_t)_slots.size());
+		}
+
+		uint64_t getId() const {
+			return _id;
+		}
+
+		size_t size() const {
+			return _slots.size();
+		}
+
+		uint32_t getSlot(String const& name) const {
+			auto i = _slots.find(name);
+			return (i == _slots.end()) ? NO_SLOT : i->second;
+		}
+	};
+private:
+	SPtr<const Layout> _layout;
+	std::vector<SPtr<Object>> _values;
+public:
+	IndexedResolver(SPtr<const Layout> const& layout)
+	:_layout(layout)
+	,_values(layout->size()) {}
+
+	virtual ~IndexedResolver() override;
+
+	void set(uint32_t slot, SPtr<Object> const& value) {
+		_values[slot] = value;
+	}
+
+	virtual SPtr<Object> getVar(String const& key) const override {
+		uint32_t slot = _layout->getSlot(key);
+		return (slot == NO_SLOT) ? nullptr : _values[slot];
+	}
+
+	virtual uint64_t getLayout() const override {
+		return _layout->getId();
+	}
+
+	virtual uint32_t getSlot(String const& key) const override {
+		return _layout->getSlot(key);
+	}
+
+	virtual SPtr<Object> getSlotVar(uint32_t slot) const override {
+		return _values[slot];
+	}
+};
+
 class MapResolver : public Resolver {
 private:
 	SPtr<Map<String, Object>> _map;
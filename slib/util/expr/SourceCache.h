@@ -0,0 +1,254 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_UTIL_EXPR_SOURCECACHE_H
+#define H_SLIB_UTIL_EXPR_SOURCECACHE_H
+
+#include "slib/lang/String.h"
+
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace slib {
+namespace expr {
+
+/**
+ * Bounded, thread-safe cache of immutable objects compiled from source text (expressions,
+ * templates, format strings), keyed by the text. When full, the least recently used entry is
+ * evicted. The cache is split into independently locked shards, so threads looking up
+ * different texts rarely contend.
+ * @tparam T  type of the cached objects, <code>const</code>-qualified if they are returned as such
+ */
+template <class T>
+class SourceCache {
+public:
+	typedef SPtr<T> (*Compiler)(String const& source);
+
+	struct Stats {
+		uint64_t _hits;
+		uint64_t _misses;
+		uint64_t _evictions;
+		size_t _size;
+
+		/** @return fraction of lookups that found a compiled entry, 0 if none were made */
+		double hitRate() const {
+			uint64_t lookups = _hits + _misses;
+			return (lookups == 0) ? 0.0 : (double)_hits / (double)lookups;
+		}
+	};
+private:
+	/** Lookup key; for cached entries it points into the entry source */
+	struct Key {
+		const char *_str;
+		size_t _len;
+		int32_t _hash;
+	};
+
+	struct KeyHash {
+		size_t operator()(Key const& key) const {
+			return (size_t)key._hash;
+		}
+	};
+
+	struct KeyEquals {
+		bool operator()(Key const& a, Key const& b) const {
+			return (a._len == b._len) && (memcmp(a._str, b._str, a._len) == 0);
+		}
+	};
+
+	struct Entry {
+		/** private copy of the source, as the caller's string may be mutable */
+		std::string _source;
+		SPtr<T> _compiled;
+	};
+
+	typedef std::list<Entry> LRUList;
+
+	struct Shard {
+		std::mutex _lock;
+		/** most recently used first */
+		LRUList _lru;
+		std::unordered_map<Key, typename LRUList::iterator, KeyHash, KeyEquals> _index;
+		uint64_t _hits = 0;
+		uint64_t _misses = 0;
+		uint64_t _evictions = 0;
+		/** hashes of texts looked up once by getRepeated(), by hash (allocated on first use) */
+		std::vector<int32_t> _seen;
+	};
+
+	static const size_t SHARDS = 8;
+
+	Compiler _compiler;
+	Shard _shards[SHARDS];
+	size_t _shardCapacity;
+
+	static Key makeKey(const char *str, size_t len) {
+		// same as String::hashCode(), computed without signed overflow
+		uint32_t h = 0;
+		for (size_t i = 0; i < len; i++)
+			h = 31 * h + (uint32_t)str[i];
+		return {str, len, (int32_t)h};
+	}
+
+	Shard& shardOf(Key const& key) {
+		return _shards[(uint32_t)key._hash % SHARDS];
+	}
+
+	/**
+	 * Remembers the hash of a text not in the cache. A text with the same hash as the one
+	 * remembered in its slot counts as seen, so a collision only compiles a text early.
+	 * @return true if the text was seen before; must be called with the shard lock held
+	 */
+	bool seenBefore(Shard &shard, Key const& key) {
+		if (shard._seen.empty())
+			shard._seen.resize(_shardCapacity);
+		int32_t &seen = shard._seen[((uint32_t)key._hash / SHARDS) % shard._seen.size()];
+		if (seen == key._hash)
+			return true;
+		seen = key._hash;
+		return false;
+	}
+
+	/** @param repeatedOnly  only compile a text not in the cache if seenBefore() */
+	template <class F>
+	SPtr<T> lookup(BasicString const& source, F compile, bool repeatedOnly) {
+		Key key = makeKey(source.c_str(), source.length());
+		Shard &shard = shardOf(key);
+
+		{
+			std::lock_guard<std::mutex> lock(shard._lock);
+			auto i = shard._index.find(key);
+			if (i != shard._index.end()) {
+				shard._hits++;
+				shard._lru.splice(shard._lru.begin(), shard._lru, i->second);
+				return i->second->_compiled;
+			}
+			shard._misses++;
+			if (repeatedOnly && !seenBefore(shard, key))
+				return nullptr;
+		}
+
+		// compiled outside the lock; if another thread compiles the same text meanwhile,
+		// the first one inserted wins
+		SPtr<T> compiled = compile();
+
+		std::lock_guard<std::mutex> lock(shard._lock);
+		auto i = shard._index.find(key);
+		if (i != shard._index.end())
+			return i->second->_compiled;
+
+		if (shard._lru.size() >= _shardCapacity) {
+			std::string const& lruSource = shard._lru.back()._source;
+			shard._index.erase(makeKey(lruSource.c_str(), lruSource.length()));
+			shard._lru.pop_back();
+			shard._evictions++;
+		}
+
+		shard._lru.push_front({std::string(source.c_str(), source.length()), compiled});
+		key._str = shard._lru.front()._source.c_str();
+		shard._index.emplace(key, shard._lru.begin());
+		return compiled;
+	}
+public:
+	static const size_t DEFAULT_CAPACITY = 1024;
+
+	/**
+	 * @param compiler  compiles the source text of entries not found in the cache
+	 * @param capacity  maximum number of cached entries (rounded up to a multiple of the shard count)
+	 */
+	SourceCache(Compiler compiler, size_t capacity = DEFAULT_CAPACITY)
+	:_compiler(compiler)
+	,_shardCapacity(capacity == 0 ? 1 : (capacity + SHARDS - 1) / SHARDS) {}
+
+	SourceCache(SourceCache const&) = delete;
+	SourceCache& operator=(SourceCache const&) = delete;
+
+	/**
+	 * Returns the compiled form of a source text, compiling and caching it if necessary
+	 * @throws  whatever the compiler throws (failed compilations are not cached)
+	 */
+	SPtr<T> get(String const& source) {
+		return get(source, [this, &source]() {
+			return _compiler(source);
+		});
+	}
+
+	/**
+	 * Same as get(String const&), compiling with <i>compile</i> instead of the compiler of the cache
+	 * @param compile  called without arguments, returns the compiled form of <i>source</i>
+	 */
+	template <class F>
+	SPtr<T> get(BasicString const& source, F compile) {
+		return lookup(source, compile, false);
+	}
+
+	/**
+	 * Same as get(BasicString const&, F), except that a text not in the cache is only compiled
+	 * (and cached) the second time it is looked up. Texts used once are then neither compiled
+	 * nor evict anything.
+	 * @return compiled form of the text, or <code>nullptr</code> the first time it is seen
+	 */
+	template <class F>
+	SPtr<T> getRepeated(BasicString const& source, F compile) {
+		return lookup(source, compile, true);
+	}
+
+	/**
+	 * Looks up a source text without compiling it; does not count as a use
+	 * @return compiled form of the text, or <code>nullptr</code> if not cached
+	 */
+	SPtr<T> find(BasicString const& source) {
+		Key key = makeKey(source.c_str(), source.length());
+		Shard &shard = shardOf(key);
+
+		std::lock_guard<std::mutex> lock(shard._lock);
+		auto i = shard._index.find(key);
+		if (i == shard._index.end())
+			return nullptr;
+		return i->second->_compiled;
+	}
+
+	void clear() {
+		for (Shard &shard : _shards) {
+			std::lock_guard<std::mutex> lock(shard._lock);
+			shard._index.clear();
+			shard._lru.clear();
+		}
+	}
+
+	size_t size() {
+		size_t size = 0;
+		for (Shard &shard : _shards) {
+			std::lock_guard<std::mutex> lock(shard._lock);
+			size += shard._lru.size();
+		}
+		return size;
+	}
+
+	size_t capacity() const {
+		return _shardCapacity * SHARDS;
+	}
+
+	/** @return statistics accumulated since construction */
+	Stats getStats() {
+		Stats stats {0, 0, 0, 0};
+		for (Shard &shard : _shards) {
+			std::lock_guard<std::mutex> lock(shard._lock);
+			stats._hits += shard._hits;
+			stats._misses += shard._misses;
+			stats._evictions += shard._evictions;
+			stats._size += shard._lru.size();
+		}
+		return stats;
+	}
+};
+
+} // namespace expr
+} // namespace slib
+
+#endif // H_SLIB_UTIL_EXPR_SOURCECACHE_H
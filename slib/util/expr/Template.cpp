@@ -0,0 +1,184 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "slib/util/expr/Template.h"
+#include "slib/util/expr/ExpressionEvaluator.h"
+#include "slib/util/expr/Profiler.h"
+
+#include <cstring>
+
+namespace slib {
+namespace expr {
+
+namespace {
+
+/** States of the pattern scanner, as in ExpressionEvaluator */
+enum class ScanState { APPEND, DOLLAR, READEXPR, STRING };
+
+} // namespace
+
+Template::Template(String const& pattern) {
+	const char *buffer = pattern.c_str();
+	size_t len = pattern.length();
+
+	// consecutive literal text is merged into a single segment
+	auto addText = [this](const char *text, size_t n) {
+		if (!_segments.empty() && !_segments.back()._expr && !_segments.back()._error)
+			_segments.back()._length += n;
+		else
+			_segments.push_back({_text.length(), n, nullptr, nullptr});
+		_text.append(text, n);
+	};
+
+	ScanState state = ScanState::APPEND;
+	size_t pos = 0;
+	size_t dollarBegin = 0;
+	char delim = 0;
+
+	while (pos < len) {
+		char c = buffer[pos];
+		switch (state) {
+			case ScanState::APPEND: {
+				const char *dollar = (const char *)memchr(buffer + pos, '$', len - pos);
+				size_t end = dollar ? (size_t)(dollar - buffer) : len;
+				if (end > pos)
+					addText(buffer + pos, end - pos);
+				if (!dollar)
+					return;
+				state = ScanState::DOLLAR;
+				dollarBegin = end;
+				pos = end;
+				break;
+			}
+			case ScanState::DOLLAR:
+				if (c == '$')
+					addText("$", 1);
+				else if (c == '{') {
+					state = ScanState::READEXPR;
+					break;
+				} else
+					addText(buffer + pos - 1, 2);
+				state = ScanState::APPEND;
+				break;
+			case ScanState::READEXPR:
+				if (c == '}') {
+					size_t exprBegin = dollarBegin + 2;
+					Segment segment {_text.length(), pos - exprBegin, nullptr, nullptr};
+					_text.append(buffer + exprBegin, segment._length);
+					try {
+						segment._expr = CompiledExpression::compile(std::make_shared<String>(buffer + exprBegin, segment._length));
+					} catch (EvaluationException const&) {
+						segment._error = std::current_exception();
+					}
+					_segments.push_back(std::move(segment));
+					state = ScanState::APPEND;
+				} else if (c == '"' || c == '\'') {
+					delim = c;
+					state = ScanState::STRING;
+				}
+				break;
+			case ScanState::STRING:
+				if (c == delim) {
+					delim = 0;
+					state = ScanState::READEXPR;
+				}
+				break;
+		}
+		pos++;
+	}
+}
+
+SPtr<const Template> Template::compile(String const& pattern) {
+	return std::make_shared<Template>(pattern);
+}
+
+SourceCache<const Template>& Template::cache() {
+	static SourceCache<const Template> cache(&Template::compile);
+	return cache;
+}
+
+SPtr<const Template> Template::cached(String const& pattern) {
+	return cache().get(pattern);
+}
+
+Value Template::evaluate(Segment const& segment, Resolver const& resolver) const {
+	if (segment._error)
+		std::rethrow_exception(segment._error);
+	Profiler::EvaluationScope scope(*segment._expr->getText());
+	return segment._expr->getProgram()->execute(resolver);
+}
+
+template <class S>
+void Template::renderSegment(S &out, Segment const& segment, Resolver const& resolver, bool ignoreMissing) const {
+	if (!segment._expr && !segment._error) {
+		out.add(_text.data() + segment._offset, (std::ptrdiff_t)segment._length);
+		return;
+	}
+	try {
+		evaluate(segment, resolver).appendTo(out);
+		EvaluationContext::checkStringLength(out.length());
+	} catch (MissingSymbolException const&) {
+		if (!ignoreMissing)
+			throw;
+		out.add("${", 2).add(_text.data() + segment._offset, (std::ptrdiff_t)segment._length).add('}');
+	}
+}
+
+void Template::render(StringBuilder &out, Resolver const& resolver, bool ignoreMissing) const {
+	for (Segment const& segment : _segments)
+		renderSegment(out, segment, resolver, ignoreMissing);
+}
+
+void Template::render(ChunkedStringBuilder &out, Resolver const& resolver, bool ignoreMissing) const {
+	for (Segment const& segment : _segments)
+		renderSegment(out, segment, resolver, ignoreMissing);
+}
+
+UPtr<String> Template::render(Resolver const& resolver, bool ignoreMissing) const {
+	StringBuilder out;
+	render(out, resolver, ignoreMissing);
+	return out.toString();
+}
+
+SPtr<Object> Template::renderObject(Resolver const& resolver, bool ignoreMissing) const {
+	if (_segments.empty())
+		return std::make_shared<String>("");
+
+	// as in smartInterpolate(), builtins are only available to a leading expression
+	Segment const& first = _segments[0];
+	if (_segments.size() == 1 && (first._expr || first._error)) {
+		try {
+			return evaluate(first, ExpressionEvaluator::InternalResolver(resolver)).getValue();
+		} catch (MissingSymbolException const&) {
+			if (!ignoreMissing)
+				throw;
+			StringBuilder out;
+			out.add("${", 2).add(_text.data() + first._offset, (std::ptrdiff_t)first._length).add('}');
+			return out.toString();
+		}
+	}
+
+	StringBuilder out;
+	renderSegment(out, first, ExpressionEvaluator::InternalResolver(resolver), ignoreMissing);
+	for (size_t i = 1; i < _segments.size(); i++)
+		renderSegment(out, _segments[i], resolver, ignoreMissing);
+	return out.toString();
+}
+
+bool Template::collectVariables(std::vector<SPtr<const String>> &names) const {
+	size_t first = names.size();
+	for (Segment const& segment : _segments) {
+		if (segment._expr)
+			segment._expr->getProgram()->collectVariables(names);
+	}
+	for (size_t i = first; i < names.size(); i++) {
+		String const& name = *names[i];
+		if ((name.length() == 1) && ((name.charAt(0) == '$') || (name.charAt(0) == '#')))
+			return false;
+	}
+	return true;
+}
+
+} // namespace expr
+} // namespace slib
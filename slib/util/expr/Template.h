@@ -0,0 +1,96 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef H_SLIB_UTIL_EXPR_TEMPLATE_H
+#define H_SLIB_UTIL_EXPR_TEMPLATE_H
+
+#include "slib/util/expr/CompiledExpression.h"
+#include "slib/util/expr/SourceCache.h"
+#include "slib/lang/ChunkedStringBuilder.h"
+
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace slib {
+namespace expr {
+
+/**
+ * Interpolation pattern (text with embedded <code>${expression}</code>s), split once into
+ * literal text and compiled expressions. Renders exactly as ExpressionEvaluator::interpolate()
+ * and ExpressionEvaluator::smartInterpolate() would render the same pattern. Immutable, so a
+ * single instance can be shared and rendered concurrently by multiple threads.
+ */
+class Template {
+private:
+	struct Segment {
+		/** literal text, or the source of the expression, in _text */
+		size_t _offset;
+		size_t _length;
+		/** nullptr for literal text */
+		SPtr<CompiledExpression> _expr;
+		/** syntax error in the expression, raised when rendered */
+		std::exception_ptr _error;
+	};
+
+	std::string _text;
+	std::vector<Segment> _segments;
+
+	/** @throws EvaluationException */
+	Value evaluate(Segment const& segment, Resolver const& resolver) const;
+
+	/** @throws EvaluationException */
+	template <class S>
+	void renderSegment(S &out, Segment const& segment, Resolver const& resolver, bool ignoreMissing) const;
+public:
+	/** do NOT use directly, use compile() */
+	Template(String const& pattern);
+
+	/** Compiles a pattern; syntax errors in expressions are only reported when rendering */
+	static SPtr<const Template> compile(String const& pattern);
+
+	/** Process-wide cache used by cached(), evicting the least recently used patterns */
+	static SourceCache<const Template>& cache();
+
+	/** Returns the compiled form of a pattern, from the process-wide cache */
+	static SPtr<const Template> cached(String const& pattern);
+
+	/**
+	 * Same as ExpressionEvaluator::interpolate(), appending to a builder
+	 * @throws EvaluationException
+	 */
+	void render(StringBuilder &out, Resolver const& resolver, bool ignoreMissing) const;
+
+	/**
+	 * Same as ExpressionEvaluator::interpolate(), appending to a chunked builder
+	 * @throws EvaluationException
+	 */
+	void render(ChunkedStringBuilder &out, Resolver const& resolver, bool ignoreMissing) const;
+
+	/**
+	 * Same as ExpressionEvaluator::interpolate()
+	 * @throws EvaluationException
+	 */
+	UPtr<String> render(Resolver const& resolver, bool ignoreMissing) const;
+
+	/**
+	 * Same as ExpressionEvaluator::smartInterpolate(): a pattern made of a single expression
+	 * renders to the value of the expression, anything else to a string
+	 * @throws EvaluationException
+	 */
+	SPtr<Object> renderObject(Resolver const& resolver, bool ignoreMissing) const;
+
+	/**
+	 * Adds the names of the variables rendering may look up to a list. Dotted names
+	 * (<code>a.b</code>) are listed by their first component, see Value::member().
+	 * @return <i>false</i> if rendering may also look up variables by computed names,
+	 *		with the <code>$()</code> or <code>#()</code> builtins
+	 */
+	bool collectVariables(std::vector<SPtr<const String>> &names) const;
+};
+
+} // namespace expr
+} // namespace slib
+
+#endif // H_SLIB_UTIL_EXPR_TEMPLATE_H
@@ -8,6 +8,7 @@
 #include "slib/lang/Object.h"
 #include "slib/lang/String.h"
 #include "slib/lang/StringBuilder.h"
+#include "slib/util/expr/EvaluationContext.h"
 #include "slib/util/expr/Exceptions.h"
 #include "slib/util/expr/Resolver.h"
 #include "slib/collections/Map.h"
@@ -17,22 +18,87 @@
 namespace slib {
 namespace expr {
 
+/**
+ * Result of evaluating (part of) an expression. Integer, Long, Double and Boolean values are
+ * held inline and only boxed on demand, so arithmetic and comparisons do not allocate; all
+ * other objects are held by reference. Observably the same as the boxed object: getValue()
+ * returns an instance of the same class.
+ */
 class Value {
 friend class ExpressionEvaluator;
 friend class ResultHolder;
+friend class Program;
+public:
+	/** How the value is held */
+	enum class Type : uint8_t {
+		NIL,		///< no value
+		OBJECT,		///< object in _value
+		INTEGER,	///< Integer, inline in _long
+		LONG,		///< Long, inline in _long
+		DOUBLE,		///< Double, inline in _double
+		BOOLEAN		///< Boolean, inline in _bool
+	};
 private:
+	Type _type;
+	union {
+		int64_t _long;
+		double _double;
+		bool _bool;
+	};
+	/** Always set for OBJECT; for inline types, only if the value came boxed */
 	SPtr<Object> _value;
-	SPtr<String> _name;
+	SPtr<const String> _name;
 public:
-	Value(SPtr<Object> const& value, SPtr<String> const& name = nullptr)
-	:_value(value)
-	,_name(name) {}
+	Value(SPtr<Object> const& value, SPtr<const String> const& name = nullptr)
+	:_type(Type::OBJECT)
+	,_long(0)
+	,_value(value)
+	,_name(name) {
+		if (!value) {
+			_type = Type::NIL;
+			return;
+		}
+		Class const& cls = value->getClass();
+		if (cls == INTEGERCLASS) {
+			_type = Type::INTEGER;
+			_long = Class::castPtr<Integer>(value)->intValue();
+		} else if (cls == LONGCLASS) {
+			_type = Type::LONG;
+			_long = Class::castPtr<Long>(value)->longValue();
+		} else if (cls == DOUBLECLASS) {
+			_type = Type::DOUBLE;
+			_double = Class::castPtr<Double>(value)->doubleValue();
+		} else if (cls == BOOLEANCLASS) {
+			_type = Type::BOOLEAN;
+			_bool = Class::castPtr<Boolean>(value)->booleanValue();
+		}
+	}
+
+	/** Nil value */
+	Value()
+	:_type(Type::NIL)
+	,_long(0) {}
+
+	/** Unboxed Integer */
+	explicit Value(int32_t value)
+	:_type(Type::INTEGER)
+	,_long(value) {}
+
+	/** Unboxed Long */
+	explicit Value(int64_t value)
+	:_type(Type::LONG)
+	,_long(value) {}
+
+	/** Unboxed Double */
+	explicit Value(double value)
+	:_type(Type::DOUBLE)
+	,_double(value) {}
 
 	static SPtr<Value> of(SPtr<Object> const& value) {
 		return std::make_shared<Value>(value);
 	}
 
-	static SPtr<Value> of(SPtr<Object> const& value, SPtr<String> const& varName) {
+	static SPtr<Value> of(SPtr<Object> const& value, SPtr<const String> const& varName) {
 		return std::make_shared<Value>(value, varName);
 	}
 
@@ -40,28 +106,102 @@ public:
 		return std::make_shared<Value>(nullptr, nullptr);
 	}
 
-	static SPtr<Value> Nil(SPtr<String> const& varName) {
+	static SPtr<Value> Nil(SPtr<const String> const& varName) {
 		return std::make_shared<Value>(nullptr, varName);
 	}
 
+	Type getType() const {
+		return _type;
+	}
+
+	/** Inline value of an INTEGER or LONG */
+	int64_t getLong() const {
+		return _long;
+	}
+
+	/** Inline value of a DOUBLE */
+	double getDouble() const {
+		return _double;
+	}
+
+	/** Inline value of a BOOLEAN */
+	bool getBoolean() const {
+		return _bool;
+	}
+
+	/** Returns the value as an object, boxing it if it is held inline */
 	SPtr<Object> getValue() const {
-		return _value;
+		if (_value)
+			return _value;
+		switch (_type) {
+			case Type::INTEGER:
+				return std::make_shared<Integer>((int32_t)_long);
+			case Type::LONG:
+				return std::make_shared<Long>(_long);
+			case Type::DOUBLE:
+				return std::make_shared<Double>(_double);
+			case Type::BOOLEAN:
+				return std::make_shared<Boolean>(_bool);
+			default:
+				return nullptr;
+		}
 	}
 
-	SPtr<String> getName() const {
+	SPtr<const String> getName() const {
 		return _name;
 	}
 
 	SPtr<Value> clone() {
-		return std::make_shared<Value>(_value, _name);
+		return std::make_shared<Value>(*this);
 	}
 
 	bool isNil() const {
-		return !_value;
+		return _type == Type::NIL;
+	}
+
+	/** Class of the (possibly boxed) value; must not be nil */
+	Class const& getClass() const {
+		switch (_type) {
+			case Type::INTEGER:
+				return INTEGERCLASS;
+			case Type::LONG:
+				return LONGCLASS;
+			case Type::DOUBLE:
+				return DOUBLECLASS;
+			case Type::BOOLEAN:
+				return BOOLEANCLASS;
+			default:
+				return _value->getClass();
+		}
+	}
+
+	/**
+	 * Gets the numeric value, as Number::doubleValue()
+	 * @param d  receives the value
+	 * @return <code>false</code> if this is not a Number
+	 */
+	bool numberValue(double &d) const {
+		switch (_type) {
+			case Type::INTEGER:
+			case Type::LONG:
+				d = (double)_long;
+				return true;
+			case Type::DOUBLE:
+				d = _double;
+				return true;
+			case Type::OBJECT:
+				if (instanceof<Number>(_value)) {
+					d = Class::castPtr<Number>(_value)->doubleValue();
+					return true;
+				}
+				return false;
+			default:
+				return false;
+		}
 	}
 
 	/** @throws EvaluationException */
-	static void checkNil(SPtr<Object> const& value, SPtr<String> const& name) {
+	static void checkNil(SPtr<Object> const& value, SPtr<const String> const& name) {
 		if (!value) {
 			if (!name)
 				throw MissingSymbolException(_HERE_, name);
@@ -72,37 +212,75 @@ public:
 
 	/** @throws EvaluationException */
 	static void checkNil(Value const& v) {
-		checkNil(v._value, v._name);
+		if (v._type == Type::NIL)
+			checkNil(nullptr, v._name);
+	}
+
+private:
+	static UPtr<String> numberToString(double d) {
+		if (Number::isMathematicalInteger(d))
+			return Long::toString((long) d);
+		else
+			return Double::toString(d);
 	}
 
+	bool isString() const {
+		return (_type == Type::OBJECT) && instanceof<BasicString>(_value);
+	}
+public:
+	/** @throws EvaluationException */
+	static UPtr<String> asString(SPtr<Object> const& value, SPtr<const String> const& name = nullptr) {
+		if (instanceof<Number>(value))
+			return numberToString((Class::castPtr<Number>(value))->doubleValue());
+		else {
+			checkNil(value, name);
+			return value->toString();
+		}
+	}
 
 	/** @throws EvaluationException */
-	static UPtr<String> asString(SPtr<Object> const& value, SPtr<String> const& name = nullptr) {
-		if (instanceof<Number>(value)) {
-			double d = (Class::castPtr<Number>(value))->doubleValue();
+	UPtr<String> asString() const {
+		double d;
+		if (numberValue(d))
+			return numberToString(d);
+		checkNil(*this);
+		return getValue()->toString();
+	}
+
+	/**
+	 * Appends the same text as asString() to a builder, without an intermediate string
+	 * for numbers and strings
+	 * @throws EvaluationException
+	 */
+	template <class S>
+	void appendTo(S &out) const {
+		double d;
+		if (numberValue(d)) {
 			if (Number::isMathematicalInteger(d))
-				return Long::toString((long) d);
+				out.add((int64_t)d);
 			else
-				return Double::toString(d);
-		} else {
-			checkNil(value, name);
-			return value->toString();
+				out.add(d);
+			return;
 		}
+		checkNil(*this);
+		if (isString())
+			out.add(*Class::castPtr<BasicString>(_value));
+		else
+			out.add(*getValue()->toString());
 	}
 
 	/** @throws EvaluationException */
-	UPtr<String> asString() {
-		return asString(_value, _name);
+	static Value inverse(Value const& v) {
+		checkNil(v);
+		double d;
+		if (v.numberValue(d))
+			return Value(-d);
+		throw EvaluationException(_HERE_, "-", v.getClass());
 	}
 
 	/** @throws EvaluationException */
-	SPtr<Value> inverse() {
-		checkNil(*this);
-		if (instanceof<Number>(_value)) {
-			Number *n = Class::castPtr<Number>(_value);
-			return std::make_shared<Value>(std::make_shared<Double>(-n->doubleValue()));
-		}
-		throw EvaluationException(_HERE_, "-", _value->getClass());
+	SPtr<Value> inverse() const {
+		return std::make_shared<Value>(inverse(*this));
 	}
 
 	/**
@@ -120,270 +298,302 @@ public:
 		return true;
 	}
 
+	static bool isTrue(Value const& v) {
+		switch (v._type) {
+			case Type::NIL:
+				return false;
+			case Type::INTEGER:
+			case Type::LONG:
+				return v._long != 0;
+			case Type::DOUBLE:
+				return v._double != 0;
+			case Type::BOOLEAN:
+				return v._bool;
+			default:
+				return isTrue(v._value);
+		}
+	}
+
 	static bool isTrue(SPtr<Value> const& v) {
-		return isTrue(v->_value);
+		return isTrue(*v);
+	}
+
+	static Value logicalNegate(Value const& v) {
+		return Value((int32_t)(isTrue(v) ? 0 : 1));
+	}
+
+	SPtr<Value> logicalNegate() const {
+		return std::make_shared<Value>(logicalNegate(*this));
 	}
 
 	/** @throws EvaluationException */
-	SPtr<Value> logicalNegate() {
-		return std::make_shared<Value>(std::make_shared<Integer>(isTrue(_value) ? 0 : 1));
+	static Value add(Value const& v1, Value const& v2) {
+		checkNil(v1);
+		checkNil(v2);
+		double d1, d2;
+		if (v1.numberValue(d1)) {
+			if (v2.numberValue(d2))
+				return Value(d1 + d2);
+		} else if (v1.isString()) {
+			if (v2.isString()) {
+				BasicString const* s1 = Class::castPtr<BasicString>(v1._value);
+				BasicString const* s2 = Class::castPtr<BasicString>(v2._value);
+				EvaluationContext::checkStringLength(s1->length() + s2->length());
+				StringBuilder result(*s1);
+				result += *s2;
+				return Value(result.toString());
+			}
+		}
+		throw EvaluationException(_HERE_, "+", v1.getClass(), v2.getClass());
 	}
 
 	/** @throws EvaluationException */
-	SPtr<Value> add(SPtr<Value> const& other) {
-		checkNil(*this);
-		checkNil(*other);
-		if (instanceof<Number>(_value)) {
-			Number *v1 = Class::castPtr<Number>(_value);
-			if (instanceof<Number>(other->_value)) {
-				Number *v2 = Class::castPtr<Number>(other->_value);
-				return std::make_shared<Value>(std::make_shared<Double>(v1->doubleValue() + v2->doubleValue()));
-			} else
-				throw EvaluationException(_HERE_, "+", _value->getClass(), other->_value->getClass());
-		} else if (instanceof<BasicString>(_value)) {
-			BasicString *v1 = Class::castPtr<BasicString>(_value);
-			if (instanceof<BasicString>(other->_value)) {
-				BasicString *v2 = Class::castPtr<BasicString>(other->_value);
-				StringBuilder result(*v1);
-				result += *v2;
-				return std::make_shared<Value>(result.toString());
-			} else
-				throw EvaluationException(_HERE_, "+", _value->getClass(), other->_value->getClass());
-		} else
-			throw EvaluationException(_HERE_, "+", _value->getClass(), other->_value->getClass());
+	SPtr<Value> add(SPtr<Value> const& other) const {
+		return std::make_shared<Value>(add(*this, *other));
 	}
 
 	/** @throws EvaluationException */
-	SPtr<Value> subtract(SPtr<Value> const& other) {
-		checkNil(*this);
-		checkNil(*other);
-		if (instanceof<Number>(_value)) {
-			Number *v1 = Class::castPtr<Number>(_value);
-			if (instanceof<Number>(other->_value)) {
-				Number *v2 = Class::castPtr<Number>(other->_value);
-				return std::make_shared<Value>(std::make_shared<Double>(v1->doubleValue() - v2->doubleValue()));
-			} else
-				throw EvaluationException(_HERE_, "-", _value->getClass(), other->_value->getClass());
-		} else
-			throw EvaluationException(_HERE_, "-", _value->getClass(), other->_value->getClass());
+	static Value subtract(Value const& v1, Value const& v2) {
+		checkNil(v1);
+		checkNil(v2);
+		double d1, d2;
+		if (v1.numberValue(d1) && v2.numberValue(d2))
+			return Value(d1 - d2);
+		throw EvaluationException(_HERE_, "-", v1.getClass(), v2.getClass());
+	}
+
+	/** @throws EvaluationException */
+	SPtr<Value> subtract(SPtr<Value> const& other) const {
+		return std::make_shared<Value>(subtract(*this, *other));
 	}
 
 	SPtr<Value> logicalAnd(SPtr<Value> const& other) {
-		return (isTrue(_value) ? other : clone());
+		return (isTrue(*this) ? other : clone());
 	}
 
 	SPtr<Value> logicalOr(SPtr<Value> const& other) {
-		return (isTrue(_value) ? clone() : other);
+		return (isTrue(*this) ? clone() : other);
 	}
 
 	/** @throws EvaluationException */
-	SPtr<Value> multiply(SPtr<Value> const& other) {
-		checkNil(*this);
-		checkNil(*other);
-		if (instanceof<Number>(_value)) {
-			Number *v1 = Class::castPtr<Number>(_value);
-			if (instanceof<Number>(other->_value)) {
-				Number *v2 = Class::castPtr<Number>(other->_value);
-				return std::make_shared<Value>(std::make_shared<Double>(v1->doubleValue() * v2->doubleValue()));
-			} else
-				throw EvaluationException(_HERE_, "*", _value->getClass(), other->_value->getClass());
-		} else
-			throw EvaluationException(_HERE_, "*", _value->getClass(), other->_value->getClass());
+	static Value multiply(Value const& v1, Value const& v2) {
+		checkNil(v1);
+		checkNil(v2);
+		double d1, d2;
+		if (v1.numberValue(d1) && v2.numberValue(d2))
+			return Value(d1 * d2);
+		throw EvaluationException(_HERE_, "*", v1.getClass(), v2.getClass());
 	}
 
 	/** @throws EvaluationException */
-	SPtr<Value> divide(SPtr<Value> const& other) {
-		checkNil(*this);
-		checkNil(*other);
-		if (instanceof<Number>(_value)) {
-			Number *v1 = Class::castPtr<Number>(_value);
-			if (instanceof<Number>(other->_value)) {
-				Number *v2 = Class::castPtr<Number>(other->_value);
-				return std::make_shared<Value>(std::make_shared<Double>(v1->doubleValue() / v2->doubleValue()));
-			} else
-				throw EvaluationException(_HERE_, "/", _value->getClass(), other->_value->getClass());
-		} else
-			throw EvaluationException(_HERE_, "/", _value->getClass(), other->_value->getClass());
+	SPtr<Value> multiply(SPtr<Value> const& other) const {
+		return std::make_shared<Value>(multiply(*this, *other));
 	}
 
 	/** @throws EvaluationException */
-	SPtr<Value> remainder(SPtr<Value> const& other) {
-		checkNil(*this);
-		checkNil(*other);
-		if (instanceof<Number>(_value)) {
-			Number *v1 = Class::castPtr<Number>(_value);
-			if (instanceof<Number>(other->_value)) {
-				Number *v2 = Class::castPtr<Number>(other->_value);
-				return std::make_shared<Value>(std::make_shared<Double>(std::fmod(v1->doubleValue(), v2->doubleValue())));
-			} else
-				throw EvaluationException(_HERE_, "%", _value->getClass(), other->_value->getClass());
-		} else
-			throw EvaluationException(_HERE_, "%", _value->getClass(), other->_value->getClass());
+	static Value divide(Value const& v1, Value const& v2) {
+		checkNil(v1);
+		checkNil(v2);
+		double d1, d2;
+		if (v1.numberValue(d1) && v2.numberValue(d2))
+			return Value(d1 / d2);
+		throw EvaluationException(_HERE_, "/", v1.getClass(), v2.getClass());
 	}
 
 	/** @throws EvaluationException */
-	bool gt(SPtr<Value> const& other) {
-		checkNil(*this);
-		checkNil(*other);
-		if (instanceof<Number>(_value)) {
-			Number *v1 = Class::castPtr<Number>(_value);
-			if (instanceof<Number>(other->_value)) {
-				Number *v2 = Class::castPtr<Number>(other->_value);
-				return (v1->doubleValue() > v2->doubleValue());
-			} else
-				throw EvaluationException(_HERE_, ">", _value->getClass(), other->_value->getClass());
-		} else if (instanceof<BasicString>(_value)) {
-			BasicString *v1 = Class::castPtr<BasicString>(_value);
-			if (instanceof<BasicString>(other->_value)) {
-				BasicString *v2 = Class::castPtr<BasicString>(other->_value);
-				return v1->compareTo(*v2) > 0;
-			} else
-				throw EvaluationException(_HERE_, ">", _value->getClass(), other->_value->getClass());
-		} else
-			throw EvaluationException(_HERE_, ">", _value->getClass(), other->_value->getClass());
+	SPtr<Value> divide(SPtr<Value> const& other) const {
+		return std::make_shared<Value>(divide(*this, *other));
 	}
 
 	/** @throws EvaluationException */
-	bool gte(SPtr<Value> const& other) {
-		checkNil(*this);
-		checkNil(*other);
-		if (instanceof<Number>(_value)) {
-			Number *v1 = Class::castPtr<Number>(_value);
-			if (instanceof<Number>(other->_value)) {
-				Number *v2 = Class::castPtr<Number>(other->_value);
-				return (v1->doubleValue() >= v2->doubleValue());
-			} else
-				throw EvaluationException(_HERE_, ">=", _value->getClass(), other->_value->getClass());
-		} else if (instanceof<BasicString>(_value)) {
-			BasicString *v1 = Class::castPtr<BasicString>(_value);
-			if (instanceof<BasicString>(other->_value)) {
-				BasicString *v2 = Class::castPtr<BasicString>(other->_value);
-				return v1->compareTo(*v2) >= 0;
-			} else
-				throw EvaluationException(_HERE_, ">=", _value->getClass(), other->_value->getClass());
-		} else
-			throw EvaluationException(_HERE_, ">=", _value->getClass(), other->_value->getClass());
+	static Value remainder(Value const& v1, Value const& v2) {
+		checkNil(v1);
+		checkNil(v2);
+		double d1, d2;
+		if (v1.numberValue(d1) && v2.numberValue(d2))
+			return Value(std::fmod(d1, d2));
+		throw EvaluationException(_HERE_, "%", v1.getClass(), v2.getClass());
 	}
 
 	/** @throws EvaluationException */
-	bool lt(SPtr<Value> const& other) {
-		checkNil(*this);
-		checkNil(*other);
-		if (instanceof<Number>(_value)) {
-			Number *v1 = Class::castPtr<Number>(_value);
-			if (instanceof<Number>(other->_value)) {
-				Number *v2 = Class::castPtr<Number>(other->_value);
-				return (v1->doubleValue() < v2->doubleValue());
-			} else
-				throw EvaluationException(_HERE_, "<", _value->getClass(), other->_value->getClass());
-		} else if (instanceof<BasicString>(_value)) {
-			BasicString *v1 = Class::castPtr<BasicString>(_value);
-			if (instanceof<BasicString>(other->_value)) {
-				BasicString *v2 = Class::castPtr<BasicString>(other->_value);
-				return v1->compareTo(*v2) < 0;
-			} else
-				throw EvaluationException(_HERE_, "<", _value->getClass(), other->_value->getClass());
-		} else
-			throw EvaluationException(_HERE_, "<", _value->getClass(), other->_value->getClass());
+	SPtr<Value> remainder(SPtr<Value> const& other) const {
+		return std::make_shared<Value>(remainder(*this, *other));
 	}
 
 	/** @throws EvaluationException */
-	bool lte(SPtr<Value> const& other) {
-		checkNil(*this);
-		checkNil(*other);
-		if (instanceof<Number>(_value)) {
-			Number *v1 = Class::castPtr<Number>(_value);
-			if (instanceof<Number>(other->_value)) {
-				Number *v2 = Class::castPtr<Number>(other->_value);
-				return (v1->doubleValue() <= v2->doubleValue());
-			} else
-				throw EvaluationException(_HERE_, "<=", _value->getClass(), other->_value->getClass());
-		} else if (instanceof<BasicString>(_value)) {
-			BasicString *v1 = Class::castPtr<BasicString>(_value);
-			if (instanceof<BasicString>(other->_value)) {
-				BasicString *v2 = Class::castPtr<BasicString>(other->_value);
-				return v1->compareTo(*v2) <= 0;
-			} else
-				throw EvaluationException(_HERE_, "<=", _value->getClass(), other->_value->getClass());
-		} else
-			throw EvaluationException(_HERE_, "<=", _value->getClass(), other->_value->getClass());
+	static bool gt(Value const& v1, Value const& v2) {
+		checkNil(v1);
+		checkNil(v2);
+		double d1, d2;
+		if (v1.numberValue(d1)) {
+			if (v2.numberValue(d2))
+				return d1 > d2;
+		} else if (v1.isString()) {
+			if (v2.isString())
+				return Class::castPtr<BasicString>(v1._value)->compareTo(*Class::castPtr<BasicString>(v2._value)) > 0;
+		}
+		throw EvaluationException(_HERE_, ">", v1.getClass(), v2.getClass());
+	}
+
+	/** @throws EvaluationException */
+	bool gt(SPtr<Value> const& other) const {
+		return gt(*this, *other);
+	}
+
+	/** @throws EvaluationException */
+	static bool gte(Value const& v1, Value const& v2) {
+		checkNil(v1);
+		checkNil(v2);
+		double d1, d2;
+		if (v1.numberValue(d1)) {
+			if (v2.numberValue(d2))
+				return d1 >= d2;
+		} else if (v1.isString()) {
+			if (v2.isString())
+				return Class::castPtr<BasicString>(v1._value)->compareTo(*Class::castPtr<BasicString>(v2._value)) >= 0;
+		}
+		throw EvaluationException(_HERE_, ">=", v1.getClass(), v2.getClass());
+	}
+
+	/** @throws EvaluationException */
+	bool gte(SPtr<Value> const& other) const {
+		return gte(*this, *other);
+	}
+
+	/** @throws EvaluationException */
+	static bool lt(Value const& v1, Value const& v2) {
+		checkNil(v1);
+		checkNil(v2);
+		double d1, d2;
+		if (v1.numberValue(d1)) {
+			if (v2.numberValue(d2))
+				return d1 < d2;
+		} else if (v1.isString()) {
+			if (v2.isString())
+				return Class::castPtr<BasicString>(v1._value)->compareTo(*Class::castPtr<BasicString>(v2._value)) < 0;
+		}
+		throw EvaluationException(_HERE_, "<", v1.getClass(), v2.getClass());
+	}
+
+	/** @throws EvaluationException */
+	bool lt(SPtr<Value> const& other) const {
+		return lt(*this, *other);
+	}
+
+	/** @throws EvaluationException */
+	static bool lte(Value const& v1, Value const& v2) {
+		checkNil(v1);
+		checkNil(v2);
+		double d1, d2;
+		if (v1.numberValue(d1)) {
+			if (v2.numberValue(d2))
+				return d1 <= d2;
+		} else if (v1.isString()) {
+			if (v2.isString())
+				return Class::castPtr<BasicString>(v1._value)->compareTo(*Class::castPtr<BasicString>(v2._value)) <= 0;
+		}
+		throw EvaluationException(_HERE_, "<=", v1.getClass(), v2.getClass());
 	}
 
 	/** @throws EvaluationException */
-	bool eq(SPtr<Value> const& other) {
-		if ((!this->_value) || (!other->_value))
-			return ((!this->_value) && (!other->_value));
-		if (instanceof<Number>(_value)) {
-			Number *v1 = Class::castPtr<Number>(_value);
-			if (instanceof<Number>(other->_value)) {
-				Number *v2 = Class::castPtr<Number>(other->_value);
-				return (v1->doubleValue() == v2->doubleValue());
-			} else
-				throw EvaluationException(_HERE_, "==", _value->getClass(), other->_value->getClass());
-		} else if (instanceof<BasicString>(_value)) {
-			BasicString *v1 = Class::castPtr<BasicString>(_value);
-			if (instanceof<BasicString>(other->_value)) {
-				BasicString *v2 = Class::castPtr<BasicString>(other->_value);
-				return v1->equals(*v2);
-			} else
-				throw EvaluationException(_HERE_, "==", _value->getClass(), other->_value->getClass());
-		} else
-			throw EvaluationException(_HERE_, "==", _value->getClass(), other->_value->getClass());
+	bool lte(SPtr<Value> const& other) const {
+		return lte(*this, *other);
+	}
+
+	/** @throws EvaluationException */
+	static bool eq(Value const& v1, Value const& v2) {
+		if (v1.isNil() || v2.isNil())
+			return (v1.isNil() && v2.isNil());
+		double d1, d2;
+		if (v1.numberValue(d1)) {
+			if (v2.numberValue(d2))
+				return d1 == d2;
+		} else if (v1.isString()) {
+			if (v2.isString())
+				return Class::castPtr<BasicString>(v1._value)->equals(*Class::castPtr<BasicString>(v2._value));
+		}
+		throw EvaluationException(_HERE_, "==", v1.getClass(), v2.getClass());
+	}
+
+	/** @throws EvaluationException */
+	bool eq(SPtr<Value> const& other) const {
+		return eq(*this, *other);
 	}
 
 private:
 	/** @throws EvaluationException */
-	int64_t getIndex(SPtr<Value> const& arg) {
-		if (!instanceof<Number>(arg->_value))
-			throw EvaluationException(_HERE_, fmt::format("Operator '[]': expected numeric index, got '{}'", arg->_value->getClass().getName()).c_str());
-		Number *index = Class::castPtr<Number>(arg->_value);
-		if (!Number::isMathematicalInteger(index->doubleValue()))
-			throw EvaluationException(_HERE_, fmt::format("Operator '[]': expected integer index, got {}", index->doubleValue()).c_str());
-		return index->longValue();
+	static int64_t getIndex(Value const& arg) {
+		double d;
+		if (!arg.numberValue(d))
+			throw EvaluationException(_HERE_, fmt::format("Operator '[]': expected numeric index, got '{}'", arg.getClass().getName()).c_str());
+		if (!Number::isMathematicalInteger(d))
+			throw EvaluationException(_HERE_, fmt::format("Operator '[]': expected integer index, got {}", d).c_str());
+		switch (arg._type) {
+			case Type::INTEGER:
+			case Type::LONG:
+				return arg._long;
+			case Type::DOUBLE:
+				return (int64_t)d;
+			default:
+				return Class::castPtr<Number>(arg._value)->longValue();
+		}
 	}
 
 public:
 	/** @throws EvaluationException */
-	SPtr<Value> index(SPtr<Value> const& arg) {
-		checkNil(*this);
-		checkNil(*arg);
-		if (instanceof<Map<String, Object>>(_value)) {
-			return std::make_shared<Value>(
-				(Class::castPtr<Map<String, Object>>(_value))->get(*Class::castPtr<String>(arg->_value))
-			);
-		// TODO: Array
-		} else if (instanceof<List<Object>>(_value)) {
-			List<Object> *list = Class::castPtr<List<Object>>(_value);
-			int64_t i = getIndex(arg);
-			if ((i < 0) || (i >= (int64_t)list->size()))
-				throw EvaluationException(_HERE_, "Array index out of bounds");
-			return std::make_shared<Value>(list->get((int)i));
-		} else
-			throw EvaluationException(_HERE_, "[]", _value->getClass());
+	static Value index(Value const& v, Value const& arg) {
+		checkNil(v);
+		checkNil(arg);
+		if (v._type == Type::OBJECT) {
+			if (instanceof<Map<String, Object>>(v._value)) {
+				return Value(
+					(Class::castPtr<Map<String, Object>>(v._value))->get(*Class::castPtr<String>(arg.getValue()))
+				);
+			// TODO: Array
+			} else if (instanceof<List<Object>>(v._value)) {
+				List<Object> *list = Class::castPtr<List<Object>>(v._value);
+				int64_t i = getIndex(arg);
+				if ((i < 0) || (i >= (int64_t)list->size()))
+					throw EvaluationException(_HERE_, "Array index out of bounds");
+				return Value(list->get((int)i));
+			}
+		}
+		throw EvaluationException(_HERE_, "[]", v.getClass());
 	}
 
 	/** @throws EvaluationException */
-	SPtr<Value> member(SPtr<String> const& memberName, Resolver const& resolver) {
-		if (isNil()) {
+	SPtr<Value> index(SPtr<Value> const& arg) const {
+		return std::make_shared<Value>(index(*this, *arg));
+	}
+
+	/** @throws EvaluationException */
+	static Value member(Value const& v, SPtr<const String> const& memberName, Resolver const& resolver) {
+		if (v.isNil()) {
 			// maybe it is a dotted variable name
-			if (!_name) {
+			if (!v._name) {
 				// this is not a named variable, no dotted expression possible
-				checkNil(*this);
+				checkNil(v);
 			}
-			SPtr<String> dottedName = std::make_shared<String>(fmt::format("{}.{}", *_name, *memberName));
+			SPtr<const String> dottedName = std::make_shared<const String>(fmt::format("{}.{}", *v._name, *memberName));
 			SPtr<Object> val = resolver.getVar(*dottedName);
 			if (val)
-				return std::make_shared<Value>(val);
-			return Nil(dottedName);
+				return Value(val);
+			return Value(nullptr, dottedName);
 		} else {
-			if (instanceof<Resolver>(_value))
-				return std::make_shared<Value>((Class::cast<Resolver>(_value))->getVar(*memberName), memberName);
-			else if (instanceof<Map<String, Object>>(_value)) {
-				return std::make_shared<Value>((Class::cast<Map<String, Object>>(_value))->get(*memberName), memberName);
-			} else
-				throw EvaluationException(_HERE_, ".", _value->getClass());
+			if (v._type == Type::OBJECT) {
+				if (instanceof<Resolver>(v._value))
+					return Value((Class::cast<Resolver>(v._value))->getVar(*memberName), memberName);
+				else if (instanceof<Map<String, Object>>(v._value))
+					return Value((Class::cast<Map<String, Object>>(v._value))->get(*memberName), memberName);
+			}
+			throw EvaluationException(_HERE_, ".", v.getClass());
 		}
 	}
+
+	/** @throws EvaluationException */
+	SPtr<Value> member(SPtr<const String> const& memberName, Resolver const& resolver) const {
+		return std::make_shared<Value>(member(*this, memberName, resolver));
+	}
 };
 
 } // namespace expr
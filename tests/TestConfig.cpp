@@ -2,6 +2,8 @@
 
 #include "slib/util/Config.h"
 #include "slib/util/SystemInfo.h"
+#include "slib/util/expr/Exceptions.h"
+#include "slib/util/expr/Value.h"
 
 using namespace slib;
 
@@ -43,3 +45,53 @@ TEST(ConfigTests, BasicTests)
 	STRCMP_EQUAL("str123", config->getProperty("testName")->c_str());
 	fmt::print("hostname: {}", *config->getProperty("hostname"));
 }
+
+TEST(ConfigTests, ParallelLoad)
+{
+	std::vector<ConfigProcessor::Line> lines;
+	auto add = [&lines](std::string const& name, std::string const& value) {
+		lines.push_back({name, std::make_shared<String>(value)});
+	};
+	add("r", "1");
+	for (int i = 0; i < 100; i++) {
+		add(fmt::format("@v{}", i), fmt::format("${{{}}}", i));
+		add(fmt::format("p{}", i), fmt::format("${{v{} * 2}}", i));
+		add(fmt::format("db.q{}", i), i ? fmt::format("${{p{}}}-${{db.q{}}}", i, i - 1) : "${p0}");
+	}
+	add("r", "${r}2");
+	add("ref", "${$('p99')}/${db.q2}/${r}");
+	add("mid", "${p2}");
+	add("ref2", "${$('ref') + ':' + $('mid')}");
+	add("sink[name]", "${p1}");
+
+	int sunk = 0;
+	std::vector<UPtr<Properties>> props;
+	for (unsigned threads : { 1, 4 }) {
+		props.push_back(std::make_unique<Properties>());
+		ConfigProcessor proc(*props.back());
+		proc.registerSink("sink", [&sunk](String const& name, SPtr<Object> const& value) {
+			STRCMP_EQUAL("name", name.c_str());
+			STRCMP_EQUAL("2", expr::Value::asString(value)->c_str());
+			sunk++;
+		});
+		proc.processLines(*props.back(), lines, threads);
+	}
+
+	// same results as processing the lines in turn
+	LONGS_EQUAL(2, sunk);
+	LONGS_EQUAL(props[0]->size(), props[1]->size());
+	STRCMP_EQUAL("198/4-2-0/12", props[1]->get("ref")->c_str());
+	STRCMP_EQUAL("198/4-2-0/12:4", props[1]->get("ref2")->c_str());
+	ConstIterator<Map<String, String>::Entry> i = props[0]->constIterator();
+	while (i.hasNext()) {
+		Map<String, String>::Entry const& entry = i.next();
+		STRCMP_EQUAL(entry.getValue()->c_str(), props[1]->get(entry.getKey())->c_str());
+	}
+
+	// the first error in file order is reported
+	add("bad1", "${p3 +}");
+	add("bad2", "${nosuchvar}");
+	Properties failed;
+	ConfigProcessor proc(failed);
+	CHECK_THROWS(expr::SyntaxErrorException, proc.processLines(failed, lines, 4));
+}
@@ -2,7 +2,23 @@
 
 #include "slib/collections/HashMap.h"
 #include "slib/collections/ArrayList.h"
+#include "slib/collections/FrozenMap.h"
 #include "slib/util/expr/ExpressionEvaluator.h"
+#include "slib/util/expr/CompiledExpression.h"
+#include "slib/util/expr/EvaluationContext.h"
+#include "slib/util/expr/ExpressionCache.h"
+#include "slib/util/expr/Batch.h"
+#include "slib/util/expr/Template.h"
+#include "slib/util/expr/Function.h"
+#include "slib/util/expr/ExpressionFormatter.h"
+#include "slib/util/expr/Profiler.h"
+#ifdef WITH_JSON
+#include "slib/util/expr/ProfilerJson.h"
+#include <rapidjson/document.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
 
 using namespace slib;
 using namespace slib::expr;
@@ -39,8 +55,619 @@ std::unique_ptr<String> strEval(const char *expr) {
 TEST(ExprTests, BasicTests) {
 	STRCMP_EQUAL("0", strEval("1 + (-1)")->c_str());
 	STRCMP_EQUAL("5", strEval("math.ceil(2.3) + math.floor(2.5)")->c_str());
+	STRCMP_EQUAL("1.5", strEval("1e-1*5 + 0x1")->c_str());
 }
 
 TEST(ExprTests, FormatTests) {
 	STRCMP_EQUAL("xxx:true:yyy:42.00", strEval("format('xxx:%b:%s:%.2f', true, 'yyy', 42)")->c_str());
 }
+
+TEST(ExprTests, InterpolationTests) {
+	String pattern("a=${var1}, b=${var2 + 1}, $$, ${'}'} end$");
+	STRCMP_EQUAL("a=val1, b=3, $, } end",
+				 ExpressionEvaluator::interpolate(pattern, *resolver, true)->c_str());
+
+	ChunkedStringBuilder out(8);
+	ExpressionEvaluator::interpolate(pattern, *resolver, true, out);
+	STRCMP_EQUAL("a=val1, b=3, $, } end", out.toString()->c_str());
+}
+
+TEST(ExprTests, CompiledTests) {
+	const char *exprs[] = {
+		"1 + (-1)", "math.ceil(2.3) + math.floor(2.5)", "1e-1*5 + 0x1", "var1 + '/' + var3",
+		"-var2 * 3 + 1", "!var2", "var2 < 3 & var2 >= 2", "var1 == 'val1' | nil", "varr[1] % 2 ~= 0",
+		"if(var2 > 1, 'big', 'small')", "for('i', 0, i < 4, i + 1, varr[i % 3])", "for('x', varr, x * x)",
+		"format('%s-%d', var1, var2)", "$('var1')", "#('var2 * 2')", "if(0, 1 +, 'lazy')"
+	};
+	for (const char *expr : exprs) {
+		SPtr<CompiledExpression> compiled = CompiledExpression::compile(std::make_shared<String>(expr));
+		STRCMP_EQUAL(strEval(expr)->c_str(), compiled->strValue(*resolver)->c_str());
+	}
+
+	SPtr<CompiledExpression> compiled = CompiledExpression::compile(std::make_shared<String>("var2 * 10 + 1"));
+	LONGS_EQUAL(21, Class::cast<Integer>(compiled->value(*resolver))->intValue());
+	vars->emplace<Integer>("var2", 4);
+	LONGS_EQUAL(41, Class::cast<Integer>(compiled->value(*resolver))->intValue());
+
+	CHECK_THROWS(SyntaxErrorException, CompiledExpression::compile(std::make_shared<String>("1 +")));
+	compiled = CompiledExpression::compile(std::make_shared<String>("if(1, 1 +, 2)"));
+	CHECK_THROWS(SyntaxErrorException, compiled->value(*resolver));
+}
+
+TEST(ExprTests, BytecodeTests) {
+	SPtr<CompiledExpression> compiled = CompiledExpression::compile(std::make_shared<String>("1 | var1"));
+	STRCMP_EQUAL("1", compiled->strValue(*resolver)->c_str());
+	compiled = CompiledExpression::compile(std::make_shared<String>("if(var2 < 3, var2 * 10, varr[5])"));
+	STRCMP_EQUAL("20", compiled->strValue(*resolver)->c_str());
+	compiled = CompiledExpression::compile(std::make_shared<String>("if(var2 > 3, 1)"));
+	STRCMP_EQUAL("", compiled->strValue(*resolver)->c_str());
+
+	// a variable named 'if' hides the builtin
+	vars->emplace<Integer>("if", 1);
+	compiled = CompiledExpression::compile(std::make_shared<String>("if(1, 2, 3)"));
+	CHECK_THROWS(EvaluationException, compiled->value(*resolver));
+}
+
+TEST(ExprTests, NestedCalls) {
+	// each argument is compiled once, so compile time grows linearly with the nesting
+	const int depth = 30;
+	std::string abs, cond;
+	for (int i = 0; i < depth; i++) {
+		abs += "math.abs(";
+		cond += "if(var2, ";
+	}
+	abs += "-var2" + std::string(depth, ')');
+	cond += "var2";
+	for (int i = 0; i < depth; i++)
+		cond += ", 0)";
+
+	auto start = std::chrono::steady_clock::now();
+	SPtr<CompiledExpression> absExpr = CompiledExpression::compile(std::make_shared<String>(abs.c_str()));
+	SPtr<CompiledExpression> condExpr = CompiledExpression::compile(std::make_shared<String>(cond.c_str()));
+	std::vector<SPtr<const String>> names;
+	condExpr->getProgram()->collectVariables(names);
+	CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+	STRCMP_EQUAL("2", absExpr->strValue(*resolver)->c_str());
+	STRCMP_EQUAL("2", condExpr->strValue(*resolver)->c_str());
+
+	// a function named 'if' gets the evaluated arguments, at each level
+	vars->put("if", Function::impl<Integer, Integer, Integer>([](int32_t a, int32_t b, int32_t c) {
+		return a + b + c;
+	}));
+	LONGS_EQUAL(2 * depth + 2, Class::cast<Integer>(condExpr->value(*resolver))->intValue());
+}
+
+TEST(ExprTests, UnboxedValues) {
+	// numbers are kept inline, but box to the same classes as before
+	SPtr<CompiledExpression> compiled = CompiledExpression::compile(std::make_shared<String>("var2 * 3"));
+	SPtr<Value> value = compiled->evaluate(*resolver);
+	CHECK(value->getType() == Value::Type::DOUBLE);
+	CHECK(instanceof<Double>(value->getValue()));
+	compiled = CompiledExpression::compile(std::make_shared<String>("var2 < 3"));
+	CHECK(instanceof<Integer>(compiled->evaluate(*resolver)->getValue()));
+	CHECK(instanceof<Integer>(ExpressionEvaluator::expressionValue(std::make_shared<String>("var2 * 3"), *resolver)));
+	CHECK(instanceof<Long>(ExpressionEvaluator::expressionValue(std::make_shared<String>("var2 * 3000000000"), *resolver)));
+
+	// values read from the resolver keep their original object
+	SPtr<Object> var2 = vars->get("var2");
+	CHECK(ExpressionEvaluator::expressionValue(std::make_shared<String>("var2"), *resolver) == var2);
+
+	vars->emplace<Boolean>("flag", false);
+	STRCMP_EQUAL("no", strEval("if(flag, 'yes', 'no')")->c_str());
+	STRCMP_EQUAL("1", strEval("!flag")->c_str());
+	STRCMP_EQUAL("2", strEval("varr[var2 - 1]")->c_str());
+	CHECK_THROWS(EvaluationException, strEval("flag + 1"));
+}
+
+TEST(ExprTests, ConstantFolding) {
+	SPtr<CompiledExpression> compiled = CompiledExpression::compile(std::make_shared<String>("1024 * 1024 * 16"));
+	LONGS_EQUAL(2, compiled->getProgram()->size());
+	LONGS_EQUAL(16777216, Class::cast<Integer>(compiled->value(*resolver))->intValue());
+
+	compiled = CompiledExpression::compile(std::make_shared<String>("var2 * (2 + 3) + math.ceil(3.7)"));
+	STRCMP_EQUAL("14", compiled->strValue(*resolver)->c_str());
+	LONGS_EQUAL(2, compiled->getVariables().size());
+
+	// errors are still raised at run time, and only if evaluated
+	compiled = CompiledExpression::compile(std::make_shared<String>("if(0, 'a' - 1, 2)"));
+	STRCMP_EQUAL("2", compiled->strValue(*resolver)->c_str());
+	compiled = CompiledExpression::compile(std::make_shared<String>("0 & ('a' - 1)"));
+	STRCMP_EQUAL("0", compiled->strValue(*resolver)->c_str());
+	compiled = CompiledExpression::compile(std::make_shared<String>("1 & ('a' - 1)"));
+	CHECK_THROWS(EvaluationException, compiled->value(*resolver));
+
+	// folded builtins are not used if the resolver hides them
+	compiled = CompiledExpression::compile(std::make_shared<String>("if(true, 'yes', 'no')"));
+	STRCMP_EQUAL("yes", compiled->strValue(*resolver)->c_str());
+	vars->emplace<Integer>("true", 0);
+	STRCMP_EQUAL("no", compiled->strValue(*resolver)->c_str());
+}
+
+TEST(ExprTests, Templates) {
+	const char *patterns[] = {
+		"", "plain", "$", "$$", "a$b", "${var1}", "${var2 * 3}", "${var2 / 4}", "x${var1}y${var2 + 1}z",
+		"${var2}-${'}'}", "${varr[1]}${", "${true}", "${if(true, 'a', 'b')}x", "x${if(var2, 'a', 'b')}", "${ 'a' + 'b' }"
+	};
+	// same results and errors as the interpreter (interpolate() does not provide builtins)
+	auto describe = [](std::function<SPtr<Object>()> render) {
+		try {
+			SPtr<Object> result = render();
+			return fmt::format("{}:{}", result->getClass().getName(), *result->toString());
+		} catch (EvaluationException const& e) {
+			return std::string(e.getName());
+		}
+	};
+	for (const char *pattern : patterns) {
+		String text(pattern);
+		SPtr<const Template> compiled = Template::compile(text);
+		STRCMP_EQUAL(describe([&]() { return SPtr<Object>(ExpressionEvaluator::interpolate(text, *resolver, true)); }).c_str(),
+					 describe([&]() { return SPtr<Object>(compiled->render(*resolver, true)); }).c_str());
+		STRCMP_EQUAL(describe([&]() { return ExpressionEvaluator::smartInterpolate(text, *resolver, true); }).c_str(),
+					 describe([&]() { return compiled->renderObject(*resolver, true); }).c_str());
+	}
+
+	StringBuilder out("> ");
+	Template::cached("${var1} and ${var2}")->render(out, *resolver, false);
+	STRCMP_EQUAL("> val1 and 2", out.c_str());
+	CHECK(Template::cached("${var1} and ${var2}") == Template::cached("${var1} and ${var2}"));
+
+	// least recently used patterns are evicted, one shard at a time
+	SourceCache<const Template> small(&Template::compile, 16);
+	SPtr<const Template> kept = small.get("${var1}");
+	for (int i = 0; i < 100; i++) {
+		small.get(fmt::format("${{{}}}", i).c_str());
+		CHECK(small.get("${var1}") == kept);
+	}
+	CHECK(small.size() <= small.capacity());
+	CHECK(small.getStats()._evictions > 0);
+
+	// syntax errors are raised when rendering
+	SPtr<const Template> broken = Template::compile("${1 +}");
+	CHECK_THROWS(SyntaxErrorException, broken->render(*resolver, true));
+}
+
+TEST(ExprTests, ExpressionCache) {
+	ExpressionCache cache(ExpressionCache::DEFAULT_CAPACITY);
+	SPtr<StringBuilder> text = std::make_shared<StringBuilder>("var2 + 1");
+	SPtr<CompiledExpression> compiled = cache.get(text);
+	CHECK(cache.get(std::make_shared<String>("var2 + 1")) == compiled);
+	LONGS_EQUAL(3, Class::cast<Integer>(compiled->value(*resolver))->intValue());
+
+	// the cache keeps its own copy of the text
+	text->add(" + 1");
+	CHECK(cache.find(String("var2 + 1")) == compiled);
+	CHECK(cache.find(*text) == nullptr);
+
+	ExpressionCache::Stats stats = cache.getStats();
+	LONGS_EQUAL(1, stats._hits);
+	LONGS_EQUAL(1, stats._misses);
+	DOUBLES_EQUAL(0.5, stats.hitRate(), 1e-9);
+
+	// least recently used expressions are evicted first
+	ExpressionCache small(8);
+	for (int i = 0; i < 100; i++) {
+		small.get(std::make_shared<String>("1"));
+		small.get(std::make_shared<String>(fmt::format("{}", i).c_str()));
+	}
+	CHECK(small.size() <= small.capacity());
+	CHECK(small.find(String("1")) != nullptr);
+	CHECK(small.getStats()._evictions > 0);
+
+	CHECK_THROWS(SyntaxErrorException, cache.get(std::make_shared<String>("1 +")));
+	CHECK_THROWS(SyntaxErrorException, ExpressionEvaluator::expressionValue(std::make_shared<String>("1 +"), *resolver));
+	// expressionValue() only compiles and caches texts it sees again
+	SPtr<String> repeated = std::make_shared<String>("var2 * 3 + 0");
+	LONGS_EQUAL(6, Class::cast<Integer>(ExpressionEvaluator::expressionValue(repeated, *resolver))->intValue());
+	CHECK(ExpressionCache::global().find(*repeated) == nullptr);
+	LONGS_EQUAL(6, Class::cast<Integer>(ExpressionEvaluator::expressionValue(repeated, *resolver))->intValue());
+	CHECK(ExpressionCache::global().find(*repeated) != nullptr);
+
+	ExpressionCache once(8);
+	CHECK(once.getRepeated(std::make_shared<String>("1 + 1")) == nullptr);
+	CHECK(once.getRepeated(std::make_shared<String>("1 + 1")) != nullptr);
+	CHECK(once.getRepeated(std::make_shared<String>("1 + 1")) == once.find(String("1 + 1")));
+	CHECK(once.getRepeated(std::make_shared<String>("1 +")) == nullptr);
+	CHECK_THROWS(SyntaxErrorException, once.getRepeated(std::make_shared<String>("1 +")));
+}
+
+TEST(ExprTests, BatchEvaluation) {
+	Batch batch(5);
+	batch.addColumn("price", std::vector<double> { 1.5, 10, 0, 99.9, 7 });
+	batch.addColumn("qty", std::vector<int32_t> { 2, 3, 100, 1, 0 });
+	batch.addColumn("region", std::vector<SPtr<String>> { std::make_shared<String>("eu"), std::make_shared<String>("us"),
+														   nullptr, std::make_shared<String>("eu"), std::make_shared<String>("eu") });
+	vars->emplace<Integer>("limit", 5);
+
+	const char *exprs[] = {
+		"(price * qty > limit) & (region == 'eu')", "price * qty > limit & region == 'eu'", "qty", "-price % 4", "!qty | price", "qty & qty + 1", "region ~= 'us'",
+		"region + '!'", "qty / 2 & region", "price + var1", "region == 1", "math.ceil(price) - qty", "if(qty, price, region)"
+	};
+	auto describe = [](Value const& value) {
+		return value.isNil() ? std::string("nil") : fmt::format("{}:{}", value.getClass().getName(), *value.asString());
+	};
+	// same results and errors as evaluating each row on its own
+	for (const char *text : exprs) {
+		SPtr<CompiledExpression> expr = CompiledExpression::compile(std::make_shared<String>(text));
+		std::string expected, actual, expectedSelection, actualSelection;
+		try {
+			for (size_t i = 0; i < batch.rows(); i++) {
+				SPtr<Map<String, Object>> row = std::make_shared<HashMap<String, Object>>();
+				row->emplace<Integer>("limit", 5);
+				row->emplace<String>("var1", "val1");
+				row->emplace<Double>("price", std::vector<double> { 1.5, 10, 0, 99.9, 7 }[i]);
+				row->emplace<Integer>("qty", std::vector<int32_t> { 2, 3, 100, 1, 0 }[i]);
+				const char *regions[] = { "eu", "us", nullptr, "eu", "eu" };
+				if (regions[i])
+					row->emplace<String>("region", regions[i]);
+				SPtr<Value> value = expr->evaluate(MapResolver(row));
+				expected += describe(*value) + " ";
+				expectedSelection += Value::isTrue(*value) ? '1' : '0';
+			}
+		} catch (EvaluationException const& e) {
+			expected = expectedSelection = e.getName();
+		}
+		try {
+			for (Value const& value : batch.evaluate(*expr, *resolver))
+				actual += describe(value) + " ";
+			for (uint8_t selected : batch.select(*expr, *resolver))
+				actualSelection += selected ? '1' : '0';
+		} catch (EvaluationException const& e) {
+			actual = actualSelection = e.getName();
+		}
+		STRCMP_EQUAL(expected.c_str(), actual.c_str());
+		STRCMP_EQUAL(expectedSelection.c_str(), actualSelection.c_str());
+	}
+
+	// '*' binds tighter than '>', which shares its level with '&' and '=='
+	auto selection = [&batch](const char *text) {
+		std::string result;
+		for (uint8_t selected : batch.select(*CompiledExpression::compile(std::make_shared<String>(text)), *resolver))
+			result += selected ? '1' : '0';
+		return result;
+	};
+	STRCMP_EQUAL("01010", selection("price * qty > limit").c_str());
+	STRCMP_EQUAL("00010", selection("(price * qty > limit) & (region == 'eu')").c_str());
+	// without parentheses, a number is compared to 'eu'
+	CHECK_THROWS(EvaluationException, selection("price * qty > limit & region == 'eu'"));
+
+	CHECK_THROWS(IllegalArgumentException, batch.addColumn("short", std::vector<double> { 1 }));
+
+	// evaluated in chunks
+	std::vector<int64_t> ids;
+	for (int64_t i = 0; i < 2500; i++)
+		ids.push_back(i);
+	Batch large(ids.size());
+	large.addColumn("id", ids);
+	std::vector<uint8_t> selected = large.select(*CompiledExpression::compile(std::make_shared<String>("id % 7 == 0")), *resolver);
+	LONGS_EQUAL(358, std::count(selected.begin(), selected.end(), 1));
+	LONGS_EQUAL(1, selected[2499 - 2499 % 7]);
+}
+
+TEST(ExprTests, SlotResolver) {
+	SPtr<const IndexedResolver::Layout> layout = std::make_shared<IndexedResolver::Layout>(std::vector<String> { "price", "qty", "true" });
+	IndexedResolver record(layout);
+	record.set(layout->getSlot("price"), std::make_shared<Double>(2.5));
+	record.set(layout->getSlot("qty"), std::make_shared<Integer>(4));
+
+	// 'true' is in the layout but not set, so the builtin applies; 'math' is not in the layout
+	SPtr<CompiledExpression> expr = CompiledExpression::compile(std::make_shared<String>("if(true, math.ceil(price) * qty, 0)"));
+	LONGS_EQUAL(12, Class::cast<Integer>(expr->value(record))->intValue());
+	SPtr<const Binding> binding = expr->bind(record);
+
+	// same layout, same binding
+	IndexedResolver other(layout);
+	other.set(layout->getSlot("price"), std::make_shared<Double>(1));
+	other.set(layout->getSlot("qty"), std::make_shared<Integer>(3));
+	STRCMP_EQUAL("3", expr->strValue(other)->c_str());
+	LONGS_EQUAL(binding->getLayout(), other.getLayout());
+
+	// a variable in a slot hides the builtin
+	other.set(layout->getSlot("true"), std::make_shared<Integer>(0));
+	LONGS_EQUAL(0, Class::cast<Integer>(expr->value(other))->intValue());
+
+	// a binding to another layout falls back to lookups by name
+	IndexedResolver reordered(std::make_shared<IndexedResolver::Layout>(std::vector<String> { "qty", "price" }));
+	reordered.set(0, std::make_shared<Integer>(2));
+	reordered.set(1, std::make_shared<Double>(7));
+	LONGS_EQUAL(14, Class::cast<Integer>(expr->value(reordered))->intValue());
+}
+
+TEST(ExprTests, FrozenMap) {
+	HashMap<String, Object> source;
+	for (int i = 0; i < 100; i++)
+		source.emplace<Integer>(fmt::format("key{}", i), i);
+	// "Aa" and "BB" have the same hash code
+	source.emplace<String>("Aa", "first");
+	source.emplace<String>("BB", "second");
+
+	FrozenMap<String, Object> frozen(source);
+	LONGS_EQUAL(102, frozen.size());
+	for (int i = 0; i < 100; i++)
+		LONGS_EQUAL(i, Class::cast<Integer>(frozen.get(fmt::format("key{}", i)))->intValue());
+	STRCMP_EQUAL("first", Class::cast<String>(frozen.get("Aa"))->c_str());
+	STRCMP_EQUAL("second", Class::cast<String>(frozen.get("BB"))->c_str());
+	CHECK_FALSE(frozen.containsKey("key100"));
+	CHECK(frozen.get("missing") == nullptr);
+	// hashed literals are looked up without a temporary String, in both map types
+	STRCMP_EQUAL("second", Class::cast<String>(frozen.get("BB"_HS))->c_str());
+	STRCMP_EQUAL("second", Class::cast<String>(source.get("BB"_HS))->c_str());
+	LONGS_EQUAL(7, Class::cast<Integer>(frozen.get("key7"_HS))->intValue());
+	LONGS_EQUAL(7, Class::cast<Integer>(source.get("key7"_HS))->intValue());
+	CHECK(frozen.find("key100"_HS) == nullptr);
+	CHECK(source.get("key100"_HS) == nullptr);
+	CHECK((instanceof<Map<String, Object>>(frozen)));
+	CHECK_THROWS(UnsupportedOperationException, frozen.put("key0", nullptr));
+
+	size_t entries = 0;
+	ConstIterator<Map<String, Object>::Entry> i = frozen.constIterator();
+	while (i.hasNext()) {
+		i.next();
+		entries++;
+	}
+	LONGS_EQUAL(102, entries);
+
+	// builtins, including the nested math table, are frozen
+	STRCMP_EQUAL("3", strEval("math.ceil(2.5)")->c_str());
+	STRCMP_EQUAL("2", strEval("if(var2 == 2, var2, 0)")->c_str());
+}
+
+TEST(ExprTests, DirectFunctions) {
+	vars->put("scale", Function::impl<Integer, Number>([](int32_t factor, SPtr<Number> value) {
+		return factor * value->doubleValue();
+	}));
+	vars->put("len", Function::impl<String>([](SPtr<String> str) {
+		return (int32_t)str->length();
+	}));
+
+	const char *exprs[] = { "scale(var2, 1.5)", "len(var1) + scale(2, len('abc'))", "scale(2, 3, varr)" };
+	const char *results[] = { "3", "10", "6" };
+	for (size_t i = 0; i < sizeof(exprs) / sizeof(exprs[0]); i++) {
+		// interpreter and compiled form
+		STRCMP_EQUAL(results[i], ExpressionEvaluator::expressionValue(std::make_shared<ExpressionInputStream>(std::make_shared<String>(exprs[i])), *resolver)->asString()->c_str());
+		STRCMP_EQUAL(results[i], strEval(exprs[i])->c_str());
+	}
+	STRCMP_EQUAL("2.5", strEval("math.abs(-2.5)")->c_str());
+	CHECK(instanceof<Double>(ExpressionEvaluator::expressionValue(std::make_shared<String>("scale(3, 0.5)"), *resolver)));
+
+	CHECK_THROWS(CastException, strEval("scale(1.5, 2)"));
+	try {
+		strEval("scale(2)");
+		FAIL("missing argument not reported");
+	} catch (EvaluationException const& e) {
+		STRCMP_CONTAINS("invalid argument index: 1", e.getMessage());
+	}
+	CHECK_THROWS(EvaluationException, strEval("len(nil)"));
+	CHECK_THROWS(CastException, ExpressionEvaluator::expressionValue(std::make_shared<ExpressionInputStream>(std::make_shared<String>("len(1)")), *resolver));
+}
+
+TEST(ExprTests, ForLoops) {
+	// string bodies are appended, not concatenated pairwise
+	UPtr<String> text = strEval("for('i', 0, i < 5000, i + 1, 'ab')");
+	LONGS_EQUAL(10000, text->length());
+	STRCMP_EQUAL("a0,a1,a2,", strEval("for('i', 0, i < 3, i + 1, format('a%d,', i))")->c_str());
+	STRCMP_EQUAL("val1val1", strEval("for('x', varr, if(x < 3, var1, ''))")->c_str());
+	STRCMP_EQUAL("6", strEval("for('i', 1, i < 4, i + 1, i)")->c_str());
+
+	// same errors as adding up the values one by one
+	CHECK_THROWS(EvaluationException, strEval("for('i', 0, i < 3, i + 1, if(i < 2, 'a', 1))"));
+	CHECK_THROWS(EvaluationException, strEval("for('i', 0, i < 3, i + 1, if(i < 2, 'a', nil))"));
+}
+
+TEST(ExprTests, CompiledFormat) {
+	SPtr<const CompiledFormat> format = CompiledFormat::compile("%s=%5.1f%%|%4d|%X|%<d");
+	SPtr<Function> function = Function::impl<>([](Resolver const& /* resolver */, ArgList const& /* args */) {
+		return Value::Nil();
+	});
+	SPtr<const String> name = std::make_shared<String>("test");
+
+	// the same compiled format, applied to several argument lists
+	const char *expected[] = { "a=  2.2%|   7|FF|255", "bb=-10.0%|1234|A|10" };
+	for (int i = 0; i < 2; i++) {
+		FunctionArgs args(function, name);
+		args.add(std::make_shared<String>(i == 0 ? "a" : "bb"));
+		args.add(std::make_shared<Double>(i == 0 ? 2.24 : -10));
+		args.add(std::make_shared<Integer>(i == 0 ? 7 : 1234));
+		args.add(std::make_shared<Integer>(i == 0 ? 255 : 10));
+		StringBuilder out;
+		format->format(out, args);
+		STRCMP_EQUAL(expected[i], out.c_str());
+	}
+
+	// errors in the format string are raised when reached, as before
+	FunctionArgs args(function, name);
+	args.add(std::make_shared<Integer>(1));
+	StringBuilder out;
+	CHECK_THROWS(UnknownFormatConversionException, CompiledFormat::compile("%d%")->format(out, args));
+	STRCMP_EQUAL("1", out.c_str());
+	CHECK_THROWS(MissingFormatArgumentException, CompiledFormat::compile("%d %d")->format(out, args));
+
+	// the format() builtin shares compiled formats
+	STRCMP_EQUAL("x:  3", strEval("format('%s:%3d', 'x', 3)")->c_str());
+	CHECK(CompiledFormat::cached("%s:%3d") == CompiledFormat::cached("%s:%3d"));
+	SourceCache<const CompiledFormat>::Stats stats = CompiledFormat::cache().getStats();
+	CHECK(stats._hits > 0);
+	CHECK(stats._size <= CompiledFormat::cache().capacity());
+}
+
+TEST(ExprTests, Profiler) {
+	Profiler::reset();
+	Profiler::enable(true);
+	SPtr<CompiledExpression> expr = CompiledExpression::compile(std::make_shared<String>("math.ceil(var2 / 4) + var2"));
+	for (int i = 0; i < 3; i++)
+		LONGS_EQUAL(3, Class::cast<Integer>(expr->value(*resolver))->intValue());
+	Profiler::enable(false);
+	expr->value(*resolver);
+
+	std::vector<std::pair<String, Profiler::ExpressionStats>> expressions = Profiler::expressions();
+	LONGS_EQUAL(1, expressions.size());
+	STRCMP_EQUAL("math.ceil(var2 / 4) + var2", expressions[0].first.c_str());
+	LONGS_EQUAL(1, expressions[0].second._compilations);
+	LONGS_EQUAL(3, expressions[0].second._evaluations);
+	// 'math' and 'var2', once per evaluation
+	LONGS_EQUAL(6, expressions[0].second._lookups);
+
+	std::vector<std::pair<String, Profiler::FunctionStats>> functions = Profiler::functions();
+	LONGS_EQUAL(1, functions.size());
+	STRCMP_EQUAL("ceil", functions[0].first.c_str());
+	LONGS_EQUAL(3, functions[0].second._calls);
+
+	StringBuilder out;
+	Profiler::dump(out);
+	CHECK(strstr(out.c_str(), "math.ceil(var2 / 4) + var2") != nullptr);
+	CHECK(strstr(out.c_str(), "ceil\n") != nullptr);
+
+#ifdef WITH_JSON
+	rapidjson::Document json;
+	json.Parse(profileToJson().c_str());
+	CHECK_FALSE(json.HasParseError());
+	LONGS_EQUAL(1, json["expressions"].Size());
+	rapidjson::Value const& expression = json["expressions"][0u];
+	STRCMP_EQUAL("math.ceil(var2 / 4) + var2", expression["expression"].GetString());
+	LONGS_EQUAL(3, expression["evaluations"].GetUint64());
+	LONGS_EQUAL(6, expression["lookups"].GetUint64());
+	LONGS_EQUAL(1, json["functions"].Size());
+	STRCMP_EQUAL("ceil", json["functions"][0u]["function"].GetString());
+	LONGS_EQUAL(3, json["functions"][0u]["calls"].GetUint64());
+#endif
+	Profiler::reset();
+	LONGS_EQUAL(0, Profiler::expressions().size());
+
+	// templates and the interpreter are profiled too
+	Profiler::enable(true);
+	SPtr<const Template> pattern = Template::compile("${7 + 8}");
+	CHECK(Class::cast<Double>(pattern->renderObject(*resolver, false))->doubleValue() == 15);
+	STRCMP_EQUAL("3", ExpressionEvaluator::interpolate("${var2 + 1}", *resolver, false)->c_str());
+	ExpressionEvaluator::smartInterpolate("${var2 + 1}", *resolver, false);
+	Profiler::enable(false);
+
+	expressions = Profiler::expressions();
+	std::sort(expressions.begin(), expressions.end(), [](std::pair<String, Profiler::ExpressionStats> const& a, std::pair<String, Profiler::ExpressionStats> const& b) {
+		return strcmp(a.first.c_str(), b.first.c_str()) < 0;
+	});
+	LONGS_EQUAL(2, expressions.size());
+	STRCMP_EQUAL("7 + 8", expressions[0].first.c_str());
+	LONGS_EQUAL(1, expressions[0].second._compilations);
+	LONGS_EQUAL(1, expressions[0].second._evaluations);
+	STRCMP_EQUAL("var2 + 1", expressions[1].first.c_str());
+	LONGS_EQUAL(2, expressions[1].second._evaluations);
+	LONGS_EQUAL(2, expressions[1].second._lookups);
+	Profiler::reset();
+}
+
+TEST(ExprTests, DeepNesting) {
+	// parentheses alone do not deepen the tree
+	std::string text = std::string(100000, '(') + "var2 * 2" + std::string(100000, ')') + " + 1";
+	SPtr<CompiledExpression> expr = CompiledExpression::compile(std::make_shared<String>(text.c_str()));
+	LONGS_EQUAL(5, Class::cast<Integer>(expr->value(*resolver))->intValue());
+
+	// nested operators are limited to MAX_DEPTH levels, chained ones are not
+	auto nested = [](int depth) {
+		std::string text;
+		for (int i = 0; i < depth; i++)
+			text += "1+(";
+		return text + "1" + std::string(depth, ')');
+	};
+	auto chained = [](int depth) {
+		std::string text = "1";
+		for (int i = 0; i < depth; i++)
+			text += "+1";
+		return text;
+	};
+	const int depth = CompiledExpression::MAX_DEPTH / 2;
+	for (std::string const& text : { nested(depth), chained(depth) }) {
+		SPtr<String> input = std::make_shared<String>(text.c_str());
+		LONGS_EQUAL(depth + 1, Class::cast<Integer>(CompiledExpression::compile(input)->value(*resolver))->intValue());
+		LONGS_EQUAL(depth + 1, Class::cast<Integer>(ExpressionEvaluator::expressionValue(input, *resolver))->intValue());
+	}
+	SPtr<String> input = std::make_shared<String>(nested(40000).c_str());
+	CHECK_THROWS(SyntaxErrorException, CompiledExpression::compile(input));
+	// the interpreter limits its recursion to the same depth
+	CHECK_THROWS(SyntaxErrorException, ExpressionEvaluator::expressionValue(input, *resolver));
+	CHECK_THROWS(SyntaxErrorException, ExpressionEvaluator::interpolate(fmt::format("${{{}}}", *input).c_str(), *resolver, false));
+	input = std::make_shared<String>(chained(40000).c_str());
+	LONGS_EQUAL(40001, Class::cast<Integer>(CompiledExpression::compile(input)->value(*resolver))->intValue());
+	LONGS_EQUAL(40001, Class::cast<Integer>(ExpressionEvaluator::expressionValue(input, *resolver))->intValue());
+	STRCMP_EQUAL("40001", Template::compile(fmt::format("${{{}}}", *input).c_str())->render(*resolver, false)->c_str());
+	std::string vars = "var2";
+	for (int i = 0; i < 40000; i++)
+		vars += " * 1 + var2";
+	input = std::make_shared<String>(vars.c_str());
+	LONGS_EQUAL(80002, Class::cast<Integer>(CompiledExpression::compile(input)->value(*resolver))->intValue());
+	STRCMP_EQUAL("80002", ExpressionEvaluator::interpolate(fmt::format("${{{}}}", *input).c_str(), *resolver, false)->c_str());
+
+	text = std::string(100000, '(') + "1 + 2" + std::string(99999, ')');
+	CHECK_THROWS(SyntaxErrorException, CompiledExpression::compile(std::make_shared<String>(text.c_str())));
+	CHECK_THROWS(SyntaxErrorException, ExpressionEvaluator::expressionValue(std::make_shared<String>(text.c_str()), *resolver));
+}
+
+TEST(ExprTests, ShortCircuit) {
+	int calls = 0;
+	vars->put("check", Function::impl<Integer>([&calls](int32_t value) {
+		calls++;
+		return value;
+	}));
+
+	const char *exprs[] = { "0 & check(1)", "var2 | check(1)", "(var2 > 5) & check(1) + 1", "!var2 & -check(1) * 2 | var2", "1 & check(3)", "0 | check(4)" };
+	const char *results[] = { "0", "2", "1", "2", "3", "4" };
+	const int expectedCalls[] = { 0, 0, 0, 0, 1, 1 };
+	for (size_t i = 0; i < sizeof(exprs) / sizeof(exprs[0]); i++) {
+		// interpreter and compiled form
+		calls = 0;
+		STRCMP_EQUAL(results[i], ExpressionEvaluator::expressionValue(std::make_shared<ExpressionInputStream>(std::make_shared<String>(exprs[i])), *resolver)->asString()->c_str());
+		LONGS_EQUAL(expectedCalls[i], calls);
+		calls = 0;
+		STRCMP_EQUAL(results[i], strEval(exprs[i])->c_str());
+		LONGS_EQUAL(expectedCalls[i], calls);
+	}
+
+	// the skipped operand is not evaluated, so its errors are not raised
+	SPtr<CompiledExpression> compiled = CompiledExpression::compile(std::make_shared<String>("0 & varr[5] | var1"));
+	STRCMP_EQUAL("val1", compiled->strValue(*resolver)->c_str());
+	STRCMP_EQUAL("val1", ExpressionEvaluator::strExpressionValue(std::make_shared<String>("0 & varr[5] | var1"), *resolver)->c_str());
+
+	// the skipped operand is still parsed
+	CHECK_THROWS(SyntaxErrorException, ExpressionEvaluator::expressionValue(std::make_shared<ExpressionInputStream>(std::make_shared<String>("0 & (check(1)")), *resolver));
+}
+
+TEST(ExprTests, EvaluationBudgets) {
+	const char *endless = "for('i', 0, 1, i, i)";
+	{
+		EvaluationContext context;
+		context.setMaxSteps(1000);
+		CHECK_THROWS(BudgetExceededException, strEval(endless));
+		// the budget stays exhausted
+		CHECK_THROWS(BudgetExceededException, strEval("var2 + 1"));
+	}
+	{
+		EvaluationContext context;
+		context.setMaxSteps(3);
+		CHECK_THROWS(BudgetExceededException, ExpressionEvaluator::expressionValue(std::make_shared<ExpressionInputStream>(std::make_shared<String>("1 + 2 + 3 + 4")), *resolver));
+	}
+	{
+		EvaluationContext context;
+		context.setTimeout(std::chrono::milliseconds(20));
+		CHECK_THROWS(BudgetExceededException, strEval(endless));
+	}
+	{
+		EvaluationContext context;
+		context.setMaxStringLength(8);
+		STRCMP_EQUAL("val1val1", strEval("var1 + var1")->c_str());
+		CHECK_THROWS(BudgetExceededException, strEval("var1 + var1 + var1"));
+		CHECK_THROWS(BudgetExceededException, strEval("for('i', 0, 1, i, 'abc')"));
+		// format() and interpolation results are limited as well
+		STRCMP_EQUAL("    val1", strEval("format('%8s', var1)")->c_str());
+		CHECK_THROWS(BudgetExceededException, strEval("format('%100000000s', var1)"));
+		CHECK_THROWS(BudgetExceededException, strEval("format('%s%s%s', var1, var1, var1)"));
+		String pattern("${var1}${var1}");
+		STRCMP_EQUAL("val1val1", ExpressionEvaluator::interpolate(pattern, *resolver, false)->c_str());
+		STRCMP_EQUAL("val1val1", Template::compile(pattern)->render(*resolver, false)->c_str());
+		pattern = "${var1}${var1}${var1}";
+		CHECK_THROWS(BudgetExceededException, ExpressionEvaluator::interpolate(pattern, *resolver, false));
+		CHECK_THROWS(BudgetExceededException, ExpressionEvaluator::smartInterpolate(pattern, *resolver, false));
+		CHECK_THROWS(BudgetExceededException, Template::compile(pattern)->render(*resolver, false));
+		CHECK_THROWS(BudgetExceededException, Template::compile(pattern)->renderObject(*resolver, false));
+		CHECK(EvaluationContext::current()->getSteps() > 0);
+	}
+	CHECK(EvaluationContext::current() == nullptr);
+	STRCMP_EQUAL("val1val1val1", strEval("var1 + var1 + var1")->c_str());
+}
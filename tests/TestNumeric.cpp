@@ -0,0 +1,120 @@
+#include "CppUTest/TestHarness.h"
+
+#include "slib/lang/Numeric.h"
+#include "slib/lang/StringBuilder.h"
+
+#include <cmath>
+#include <cstring>
+
+using namespace slib;
+
+TEST_GROUP(NumericTests) {
+};
+
+TEST(NumericTests, IntegerToChars) {
+	char buffer[Number::MAX_CHARS];
+
+	LONGS_EQUAL(1, Integer::toChars(0, buffer));
+	STRCMP_EQUAL("0", buffer);
+	LONGS_EQUAL(11, Integer::toChars(Integer::MIN_VALUE, buffer));
+	STRCMP_EQUAL("-2147483648", buffer);
+	STRCMP_EQUAL("2147483647", Integer::toString(Integer::MAX_VALUE)->c_str());
+	STRCMP_EQUAL("-9223372036854775808", Long::toString(INT64_MIN)->c_str());
+	STRCMP_EQUAL("18446744073709551615", ULong::toString(UINT64_MAX)->c_str());
+}
+
+TEST(NumericTests, DoubleToChars) {
+	STRCMP_EQUAL("0.1", Double::toString(0.1)->c_str());
+	STRCMP_EQUAL("0.30000000000000004", Double::toString(0.1 + 0.2)->c_str());
+	STRCMP_EQUAL("-2.5", Double::toString(-2.5)->c_str());
+	STRCMP_EQUAL("1e+21", Double::toString(1e21)->c_str());
+	STRCMP_EQUAL("0.000001", Double::toString(1e-6)->c_str());
+	STRCMP_EQUAL("1.5e-7", Double::toString(1.5e-7)->c_str());
+	STRCMP_EQUAL("5e-324", Double::toString(5e-324)->c_str());
+	STRCMP_EQUAL("1.7976931348623157e+308", Double::toString(1.7976931348623157e308)->c_str());
+	STRCMP_EQUAL("-inf", Double::toString(-HUGE_VAL)->c_str());
+
+	// shortest digits, also where Grisu alone cannot prove them
+	STRCMP_EQUAL("16.24817", Double::toString(16.24817)->c_str());
+	STRCMP_EQUAL("1.983348", Double::toString(1.983348)->c_str());
+	STRCMP_EQUAL("0.001737486", Double::toString(0.001737486)->c_str());
+
+	// integers from 2^53 up are written in scientific notation, so they parse back as doubles
+	STRCMP_EQUAL("9007199254740991", Double::toString(9007199254740991.0)->c_str());
+	STRCMP_EQUAL("9.007199254740992e+15", Double::toString(9007199254740992.0)->c_str());
+	STRCMP_EQUAL("1e+20", Double::toString(1e20)->c_str());
+	char buffer[Number::MAX_CHARS];
+	size_t len = Double::toChars(140729479737114020000.0, buffer);
+	STRCMP_EQUAL("1.4072947973711402e+20", buffer);
+	Number::Literal literal = Number::parse(StringView(buffer, len));
+	CHECK(literal.type == Number::LiteralType::DOUBLE);
+	DOUBLES_EQUAL(140729479737114020000.0, literal.doubleValue, 0);
+
+	// random values parse back, with as many digits as the shortest correctly rounded form
+	uint64_t state = 0x9E3779B97F4A7C15ULL;
+	for (int i = 0; i < 100000; i++) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		double d;
+		memcpy(&d, &state, sizeof(d));
+		if (!std::isfinite(d) || d == 0)
+			continue;
+		len = Double::toChars(d, buffer);
+		CHECK(strtod(buffer, nullptr) == d);
+
+		int digits = 0, trailingZeros = 0;
+		for (const char *p = buffer; *p && *p != 'e'; p++) {
+			if (*p < '0' || *p > '9' || (*p == '0' && digits == 0))
+				continue;
+			trailingZeros = (*p == '0') ? trailingZeros + 1 : 0;
+			digits++;
+		}
+		int shortest = 1;
+		char reference[32];
+		for (; shortest < 17; shortest++) {
+			snprintf(reference, sizeof(reference), "%.*e", shortest - 1, d);
+			if (strtod(reference, nullptr) == d)
+				break;
+		}
+		LONGS_EQUAL(shortest, digits - trailingZeros);
+	}
+
+	StringBuilder sb;
+	sb.add(42).add(' ').add((int64_t)-7).add(' ').add(0.25);
+	STRCMP_EQUAL("42 -7 0.25", sb.c_str());
+}
+
+TEST(NumericTests, Parse) {
+	Number::Literal literal = Number::parse("123456789012 + 1"_SV);
+	CHECK(literal.type == Number::LiteralType::LONG);
+	LONGS_EQUAL(12, literal.length);
+	CHECK(literal.longValue == 123456789012LL);
+
+	literal = Number::parse("-0x7fffffff"_SV);
+	CHECK(literal.type == Number::LiteralType::INTEGER);
+	LONGS_EQUAL(-0x7fffffff, literal.longValue);
+
+	literal = Number::parse("1.25e-3*2"_SV);
+	CHECK(literal.type == Number::LiteralType::DOUBLE);
+	LONGS_EQUAL(7, literal.length);
+	DOUBLES_EQUAL(0.00125, literal.doubleValue, 0);
+
+	DOUBLES_EQUAL(0.1, Number::parse("0.1000000000000000000000000001"_SV).doubleValue, 0);
+	LONGS_EQUAL(8, Number::parse("010"_SV).longValue);
+	CHECK(Number::parse("5L"_SV).type == Number::LiteralType::LONG);
+	CHECK(instanceof<Double>(Number::createNumber("2d"_SV).get()));
+
+	CHECK_THROWS(NumberFormatException, Number::parse("."_SV));
+	CHECK_THROWS(NumberFormatException, Number::parse("1e+"_SV));
+	CHECK_THROWS(NumericOverflowException, Number::parse("9223372036854775808"_SV));
+	CHECK_THROWS(NumericOverflowException, Number::parse("1e400"_SV));
+	// underflow rounds to zero, keeping the sign
+	literal = Number::parse("-1e-400"_SV);
+	CHECK(literal.type == Number::LiteralType::DOUBLE);
+	DOUBLES_EQUAL(0, literal.doubleValue, 0);
+	CHECK(std::signbit(literal.doubleValue));
+	DOUBLES_EQUAL(0, Number::createNumber("1e-400"_SV)->doubleValue(), 0);
+	DOUBLES_EQUAL(5e-324, Number::parse("4.9406564584124654e-324"_SV).doubleValue, 0);
+	CHECK_THROWS(NumberFormatException, Number::createNumber("12a"_SV));
+}
@@ -0,0 +1,218 @@
+#include "CppUTest/TestHarness.h"
+
+#include "slib/lang/StringPool.h"
+#include "slib/lang/ASCII.h"
+#include "slib/lang/ChunkedStringBuilder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace slib;
+
+TEST_GROUP(StringTests) {
+};
+
+TEST(StringTests, Intern) {
+	StringPool pool;
+	String name("hostname");
+
+	SPtr<const String> s1 = pool.intern("hostname"_SV);
+	SPtr<const String> s2 = pool.intern(CPtr(name));
+	POINTERS_EQUAL(s1.get(), s2.get());
+	CHECK(s1->equals(CPtr(name)));
+	LONGS_EQUAL(name.hashCode(), s1->hashCode());
+
+	SPtr<const String> s3 = pool.intern("host", 4);
+	CHECK(s1 != s3);
+	LONGS_EQUAL(2, pool.size());
+	CHECK(!pool.intern((String const*)nullptr));
+
+	// entries go away with the last reference
+	s1.reset();
+	s2.reset();
+	LONGS_EQUAL(1, pool.size());
+	s1 = pool.intern("hostname"_SV);
+	CHECK(s1->equals(CPtr(name)));
+	LONGS_EQUAL(2, pool.size());
+	s1.reset();
+	s3.reset();
+	LONGS_EQUAL(0, pool.size());
+}
+
+TEST(StringTests, InternConcurrent) {
+	StringPool pool;
+	const int THREADS = 8;
+	const int NAMES = 500;
+
+	std::vector<std::string> names;
+	for (int i = 0; i < NAMES; i++)
+		names.push_back("name" + std::to_string(i));
+
+	// every thread interns the shared names plus some of its own, dropping half of them
+	// right away so that entries expire while other threads look them up
+	std::vector<std::vector<SPtr<const String>>> results(THREADS);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < THREADS; t++) {
+		threads.emplace_back([&pool, &names, &results, t]() {
+			for (int round = 0; round < 20; round++) {
+				std::vector<SPtr<const String>> &kept = results[t];
+				kept.clear();
+				for (int i = 0; i < NAMES; i++) {
+					std::string const& name = names[(i + t * 37) % NAMES];
+					SPtr<const String> s = pool.intern(name.c_str(), name.length());
+					if (i % 2 == 0)
+						kept.push_back(s);
+					std::string own = name + "/" + std::to_string(t);
+					pool.intern(own.c_str(), own.length());
+				}
+			}
+		});
+	}
+	for (std::thread &thread : threads)
+		thread.join();
+
+	for (int t = 0; t < THREADS; t++) {
+		LONGS_EQUAL(NAMES / 2, results[t].size());
+		for (int i = 0; i < NAMES; i += 2) {
+			std::string const& name = names[(i + t * 37) % NAMES];
+			SPtr<const String> const& s = results[t][i / 2];
+			STRCMP_EQUAL(name.c_str(), s->c_str());
+			POINTERS_EQUAL(s.get(), pool.intern(name.c_str(), name.length()).get());
+		}
+	}
+
+	results.clear();
+	LONGS_EQUAL(0, pool.size());
+}
+
+TEST(StringTests, HashedLiterals) {
+	constexpr HashedStringView key = "hostname"_HS;
+	static_assert(key.hashCode() != 0, "hash must be computed at compile time");
+
+	LONGS_EQUAL(String("hostname").hashCode(), key.hashCode());
+	LONGS_EQUAL(String("a much longer key that overflows\xe9").hashCode(),
+				"a much longer key that overflows\xe9"_HS.hashCode());
+	LONGS_EQUAL(0, ""_HS.hashCode());
+
+	String s(key);
+	STRCMP_EQUAL("hostname", s.c_str());
+	LONGS_EQUAL(key.hashCode(), s.hashCode());
+}
+
+TEST(StringTests, CaseFolding) {
+	std::string mixed;
+	for (int i = 0; i < 300; i++)
+		mixed += (char)(i % 256);
+	std::string lower(mixed), upper(mixed);
+	for (size_t i = 0; i < mixed.length(); i++) {
+		lower[i] = (char)((mixed[i] >= 'A' && mixed[i] <= 'Z') ? mixed[i] + 32 : mixed[i]);
+		upper[i] = (char)((mixed[i] >= 'a' && mixed[i] <= 'z') ? mixed[i] - 32 : mixed[i]);
+	}
+
+	std::string out(mixed.length(), ' ');
+	ASCII::toLowerCase(&out[0], mixed.c_str(), mixed.length());
+	CHECK(out == lower);
+	ASCII::toUpperCase(&out[0], out.c_str(), out.length());
+	CHECK(out == upper);
+
+	for (size_t len = 0; len <= mixed.length(); len += 7) {
+		CHECK(ASCII::equalsIgnoreCase(lower.c_str(), upper.c_str(), len));
+		uint32_t h = 0;
+		for (size_t i = 0; i < len; i++)
+			h = 31 * h + (unsigned char)lower[i];
+		LONGS_EQUAL((int32_t)h, ASCII::hashCodeIgnoreCase(upper.c_str(), len));
+	}
+	CHECK_FALSE(ASCII::equalsIgnoreCase("Content-Type-Header-X", "content-type-header-y", 21));
+	// a difference anywhere is found, whichever (overlapping) block covers it
+	for (size_t len = 1; len <= 40; len++) {
+		for (size_t i = 0; i < len; i++) {
+			std::string other = upper.substr(0, len);
+			other[i] ^= 1;
+			CHECK_FALSE(ASCII::equalsIgnoreCase(lower.c_str(), other.c_str(), len));
+		}
+	}
+
+	ASCIICaseInsensitiveString key("X-Forwarded-For-Original-Client");
+	CHECK(key.equals(String("x-forwarded-for-original-client")));
+	STRCMP_EQUAL("X-FORWARDED-FOR-ORIGINAL-CLIENT", key.toUpperCase()->c_str());
+}
+
+TEST(StringTests, CharacterClasses) {
+	for (int i = 0; i < 256; i++) {
+		char ch = (char)i;
+		bool ascii = (i < 128);
+		CHECK((ascii && std::isspace(i)) == ASCII::isSpace(ch));
+		CHECK((ascii && std::isdigit(i)) == ASCII::isDigit(ch));
+		CHECK((ascii && std::isalpha(i)) == ASCII::isAlpha(ch));
+		CHECK((ascii && (std::isalnum(i) || ch == '_')) == ASCII::isWordChar(ch));
+	}
+
+	// runs ending at every offset, around the 16 byte blocks
+	std::string blanks(40, ' ');
+	std::string word(40, 'x');
+	for (size_t len = 0; len < 40; len++) {
+		for (char stop : { '-', '\0', '\x80', '\xe1', '{', '`', '@', '/', ':', '[' }) {
+			std::string text = blanks.substr(0, len) + stop + blanks;
+			std::replace(text.begin(), text.begin() + (long)len, ' ', (char)('\t' + len % 5));
+			LONGS_EQUAL(len, ASCII::spanSpaces(text.c_str(), text.length()));
+			text = word.substr(0, len) + stop + word;
+			if (len > 0)
+				text[len / 2] = (len % 3) ? '_' : 'Z';
+			if (len > 3)
+				text[len - 2] = '7';
+			LONGS_EQUAL(len, ASCII::spanWordChars(text.c_str(), text.length()));
+		}
+		LONGS_EQUAL(len, ASCII::spanSpaces(blanks.c_str(), len));
+		LONGS_EQUAL(len, ASCII::spanWordChars(word.c_str(), len));
+	}
+}
+
+class CollectingOutputStream : public OutputStream {
+public:
+	std::string _data;
+	int _writes = 0;
+
+	virtual void write(unsigned char *buffer, size_t length) override {
+		_data.append((const char *)buffer, length);
+		_writes++;
+	}
+
+	virtual void close() override {}
+};
+
+TEST(StringTests, ChunkedStringBuilder) {
+	ChunkedStringBuilder sb(16);
+	std::string expected;
+	for (int i = 0; i < 100; i++) {
+		sb.add("item").add(i).add(',');
+		expected += "item" + std::to_string(i) + ",";
+	}
+	String big(std::string(40, 'x'));
+	sb.add(big);
+	expected += big.c_str();
+
+	LONGS_EQUAL(expected.length(), sb.length());
+	CHECK(sb.numChunks() > 1);
+	STRCMP_EQUAL(expected.c_str(), sb.toString()->c_str());
+
+	ChunkedStringBuilder tail(16);
+	tail.add("<end>");
+	size_t chunks = sb.numChunks();
+	sb.add(std::move(tail));
+	expected += "<end>";
+	CHECK(tail.isEmpty());
+	LONGS_EQUAL(chunks + 1, sb.numChunks());
+	STRCMP_EQUAL(expected.c_str(), sb.toString()->c_str());
+
+	CollectingOutputStream out;
+	sb.writeTo(out);
+	CHECK(out._data == expected);
+	LONGS_EQUAL(sb.numChunks(), out._writes);
+
+	sb.clear();
+	CHECK(sb.isEmpty());
+	STRCMP_EQUAL("", sb.toString()->c_str());
+}